@@ -0,0 +1,52 @@
+#include "cma.hh"
+#include "args.hh"
+#include "utils.hh"
+#include "barrier.hh"
+#include "pipeline.hh"
+#include "fan_in.hh"
+#include "driver.hh"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <iostream>
+#include <unistd.h>
+
+int main(int argc, char *argv[])
+{
+    std::cout << "Launching client" << std::endl;
+    Args args = parse_args(argc, argv, MAX_LARGE_MESSAGE_SIZE);
+    ReadyBarrier barrier(ReadyBarrier::Role::CLIENT);
+    // Wait until the server is listening
+    barrier.wait_until_notify();
+
+    int client_fd;
+    struct sockaddr_un addr;
+
+    if ((client_fd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1)
+    {
+        report_and_exit("socket");
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, CMA_SOCKET_PATH, sizeof(addr.sun_path) - 1);
+
+    if (connect(client_fd, (struct sockaddr *)&addr, sizeof(addr)) == -1)
+    {
+        close(client_fd);
+        report_and_exit("connect");
+    }
+
+    // The server writes up to `window` unanswered messages to a client, but a fan-in client is
+    // only sent one echo or ack at a time
+    CmaSlots slots(args.message_size, is_fan_in(args) ? 1 : args.window);
+    CmaPeer peer(client_fd, slots);
+
+    // Indicate to server client is ready
+    barrier.notify();
+    CmaTransport transport(client_fd, slots, peer);
+    run_client(args, transport);
+
+    close(client_fd);
+    return 0;
+}
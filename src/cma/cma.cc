@@ -0,0 +1,196 @@
+#include "cma.hh"
+#include "payload.hh"
+#include "utils.hh"
+
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+CmaSlots::CmaSlots(size_t slot_size, size_t num_slots) : slots(nullptr), slot_size(slot_size), num_slots(num_slots)
+{
+    void *ptr = mmap(NULL, slot_size * num_slots, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ptr == MAP_FAILED)
+    {
+        report_and_exit("mmap");
+    }
+    slots = static_cast<char *>(ptr);
+    // Fault the slots in up front, the peer's writes would otherwise fault every page in the
+    // timed loop
+    memset(slots, 0, slot_size * num_slots);
+}
+
+CmaSlots::~CmaSlots()
+{
+    if (munmap(slots, slot_size * num_slots) == -1)
+    {
+        std::cerr << "munmap failed" << std::endl;
+    }
+}
+
+CmaHello CmaSlots::hello() const
+{
+    return CmaHello{reinterpret_cast<uint64_t>(slots), slot_size, num_slots};
+}
+
+const char *CmaSlots::frame_data(const CmaFrame &frame) const
+{
+    // The frame comes from the other process, never trust it to stay inside the slots
+    if (frame.slot >= num_slots || frame.length > slot_size)
+    {
+        std::cerr << "Frame of " << frame.length << " bytes in slot " << frame.slot << " is outside the slots"
+                  << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    return slots + frame.slot * slot_size;
+}
+
+CmaPeer::CmaPeer(int socket_fd, const CmaSlots &slots)
+{
+    struct ucred cred;
+    socklen_t length = sizeof(cred);
+    if (getsockopt(socket_fd, SOL_SOCKET, SO_PEERCRED, &cred, &length) == -1)
+    {
+        report_and_exit("getsockopt SO_PEERCRED");
+    }
+    pid = cred.pid;
+    // The launcher's children are siblings, which Yama's `ptrace_scope` 1 forbids to access
+    // each other unless the target names its peer. Without Yama this fails with EINVAL and
+    // the usual same user check applies.
+    if (prctl(PR_SET_PTRACER, pid, 0, 0, 0) == -1 && errno != EINVAL)
+    {
+        report_and_exit("prctl PR_SET_PTRACER");
+    }
+
+    // The peer only writes once it has our slots, which is after it may
+    CmaHello own = slots.hello();
+    write_full(socket_fd, &own, sizeof(own));
+    read_full(socket_fd, &hello, sizeof(hello));
+    if (hello.slot_size != own.slot_size || hello.num_slots == 0)
+    {
+        std::cerr << "Peer receives into " << hello.num_slots << " slots of " << hello.slot_size
+                  << " bytes, expected slots of " << own.slot_size << std::endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
+void CmaPeer::write(size_t slot, const char *message, size_t size) const
+{
+    ASSERT(slot < hello.num_slots && size <= hello.slot_size);
+    size_t written = 0;
+    // A transfer may stop short at a page it cannot access, continue from there
+    while (written < size)
+    {
+        struct iovec local = {const_cast<char *>(message) + written, size - written};
+        struct iovec remote = {reinterpret_cast<char *>(hello.slots + slot * hello.slot_size) + written,
+                               size - written};
+        ssize_t n = process_vm_writev(pid, &local, 1, &remote, 1, 0);
+        if (n <= 0)
+        {
+            report_and_exit("process_vm_writev");
+        }
+        written += n;
+    }
+}
+
+size_t CmaPeer::num_slots() const
+{
+    return hello.num_slots;
+}
+
+// Sends the doorbell of a message in the peer's `slot` over `socket_fd`
+static void send_frame(int socket_fd, size_t slot, size_t size)
+{
+    CmaFrame frame = {slot, size};
+    write_full(socket_fd, &frame, sizeof(frame));
+}
+
+// Receives the next doorbell from `socket_fd`
+static CmaFrame recv_frame(int socket_fd)
+{
+    CmaFrame frame;
+    read_full(socket_fd, &frame, sizeof(frame));
+    return frame;
+}
+
+CmaTransport::CmaTransport(int socket_fd, CmaSlots &slots, const CmaPeer &peer)
+    : socket_fd(socket_fd), slots(slots), peer(peer), sent(0), checksum(0)
+{
+}
+
+void CmaTransport::send(const char *message, size_t size)
+{
+    // A slot is only reused once the message in it was answered, the window bounds how many
+    // are in flight
+    size_t slot = sent++ % peer.num_slots();
+    peer.write(slot, message, size);
+    send_frame(socket_fd, slot, size);
+}
+
+const char *CmaTransport::recv(size_t size)
+{
+    CmaFrame frame = recv_frame(socket_fd);
+    check_frame_length(frame.length, size);
+    const char *data = slots.frame_data(frame);
+    checksum += touch_frame(data, frame.length);
+    return data;
+}
+
+const char *CmaTransport::recv_framed(size_t max_size)
+{
+    CmaFrame frame = recv_frame(socket_fd);
+    const char *data = slots.frame_data(frame);
+    check_whole_frame(data, frame.length, max_size);
+    checksum += touch_frame(data, frame.length);
+    return data;
+}
+
+void CmaTransport::send_ack()
+{
+    char ack = 0;
+    write_full(socket_fd, &ack, ACK_SIZE);
+}
+
+void CmaTransport::recv_ack()
+{
+    char ack;
+    read_full(socket_fd, &ack, ACK_SIZE);
+}
+
+CmaFanIn::CmaFanIn(const std::vector<int> &client_fds, std::vector<std::unique_ptr<CmaSlots>> &slots,
+                   const std::vector<std::unique_ptr<CmaPeer>> &peers)
+    : client_fds(client_fds), slots(slots), peers(peers), poller(client_fds), checksum(0)
+{
+}
+
+const char *CmaFanIn::recv_any(size_t size, size_t &source)
+{
+    source = poller.next_ready();
+    CmaFrame frame = recv_frame(client_fds[source]);
+    check_frame_length(frame.length, size);
+    const char *data = slots[source]->frame_data(frame);
+    checksum += touch_frame(data, frame.length);
+    return data;
+}
+
+void CmaFanIn::reply(size_t source, const char *message, size_t size)
+{
+    // A client has one message answered at a time, its single slot is free again
+    peers[source]->write(0, message, size);
+    send_frame(client_fds[source], 0, size);
+}
+
+void CmaFanIn::reply_ack(size_t source)
+{
+    char ack = 0;
+    write_full(client_fds[source], &ack, ACK_SIZE);
+}
+
+void CmaFanIn::drop(size_t source)
+{
+    poller.remove(source);
+}
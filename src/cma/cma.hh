@@ -0,0 +1,115 @@
+#pragma once
+
+#include "fan_in.hh"
+#include "types.hh"
+
+#include <sys/types.h>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+constexpr const char *CMA_SOCKET_PATH = "/tmp/cpp_ipc_benchmarks_cma";
+
+// Which receive slot of the peer a message was written to and its length. This is the
+// doorbell sent over the socket per message, regardless of the message size.
+struct CmaFrame
+{
+    uint64_t slot;
+    uint64_t length;
+};
+
+// Where a side receives, sent to the peer once when the connection is set up
+struct CmaHello
+{
+    uint64_t slots;
+    uint64_t slot_size;
+    uint64_t num_slots;
+};
+
+// Private memory of one side which the peer writes messages into with `process_vm_writev`
+// (cross memory attach). Nothing is shared: the kernel copies each message once, straight
+// from the sender's buffer into a slot of the receiver's address space.
+//
+// The slots are prefaulted, so the first messages do not pay for faulting them in. Which
+// slot the peer writes is up to the caller, a slot must not be rewritten until it was read.
+class CmaSlots
+{
+    char *slots;
+    size_t slot_size;
+    size_t num_slots;
+
+public:
+    CmaSlots(size_t slot_size, size_t num_slots);
+    ~CmaSlots();
+
+    CmaSlots(const CmaSlots &) = delete;
+    CmaSlots &operator=(const CmaSlots &) = delete;
+
+    // Where the peer has to write, to be sent in the handshake
+    CmaHello hello() const;
+    // Start of the message described by `frame`, exits if it lies outside the slots
+    const char *frame_data(const CmaFrame &frame) const;
+};
+
+// The other side of a connection, the process and the slots messages are written to
+class CmaPeer
+{
+    pid_t pid;
+    CmaHello hello;
+
+public:
+    // Learns the peer's pid from the connected `socket_fd`, allows it to write into this
+    // process and exchanges the slots of both sides. Exits if the peer's slots do not have
+    // the size of `slots`.
+    CmaPeer(int socket_fd, const CmaSlots &slots);
+
+    // Copies the `size` bytes at `message` into the peer's slot `slot` with `process_vm_writev`
+    void write(size_t slot, const char *message, size_t size) const;
+    // Number of slots the peer receives into, which its messages rotate through
+    size_t num_slots() const;
+};
+
+// One side of a connection as a `Transport`. A message is written into the peer's next slot,
+// rotating, and only its frame is sent. A received message is read in place in this side's
+// slots, every cache line of it is touched.
+class CmaTransport
+{
+    int socket_fd;
+    CmaSlots &slots;
+    const CmaPeer &peer;
+    // Messages sent so far, which picks the next slot
+    ull sent;
+    uint8_t checksum;
+
+public:
+    CmaTransport(int socket_fd, CmaSlots &slots, const CmaPeer &peer);
+
+    void send(const char *message, size_t size);
+    // Exits if the frame is not `size` bytes
+    const char *recv(size_t size);
+    const char *recv_framed(size_t max_size);
+    // Acks are a byte on the socket, they carry no payload to write to the peer
+    void send_ack();
+    void recv_ack();
+};
+
+// Fan-in server over every client's connection. The server has a set of slots per client which
+// only that client writes, and answers through the client's slot 0 or with an ack byte.
+class CmaFanIn
+{
+    std::vector<int> client_fds;
+    std::vector<std::unique_ptr<CmaSlots>> &slots;
+    const std::vector<std::unique_ptr<CmaPeer>> &peers;
+    FdPoller poller;
+    uint8_t checksum;
+
+public:
+    CmaFanIn(const std::vector<int> &client_fds, std::vector<std::unique_ptr<CmaSlots>> &slots,
+             const std::vector<std::unique_ptr<CmaPeer>> &peers);
+
+    const char *recv_any(size_t size, size_t &source);
+    void reply(size_t source, const char *message, size_t size);
+    void reply_ack(size_t source);
+    void drop(size_t source);
+};
@@ -0,0 +1,117 @@
+#include "cma.hh"
+#include "args.hh"
+#include "utils.hh"
+#include "barrier.hh"
+#include "bench.hh"
+#include "pipeline.hh"
+#include "fan_in.hh"
+#include "driver.hh"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <iostream>
+#include <memory>
+#include <vector>
+#include <unistd.h>
+
+// Every client has its own connection and set of `window` slots in the server, the server
+// answers through the client's single slot or acks on the socket
+static int serve_fan_in(const Args &args, ReadyBarrier &barrier, int server_fd)
+{
+    FanInServer server(fan_in_name("cma", args), args);
+    if (listen(server_fd, static_cast<int>(args.fan_in)) == -1)
+    {
+        close(server_fd);
+        report_and_exit("listen");
+    }
+    barrier.notify(args.fan_in);
+
+    std::vector<int> client_fds;
+    std::vector<std::unique_ptr<CmaSlots>> slots;
+    std::vector<std::unique_ptr<CmaPeer>> peers;
+    for (ull i = 0; i < args.fan_in; i++)
+    {
+        int client_fd = accept(server_fd, NULL, NULL);
+        if (client_fd == -1)
+        {
+            report_and_exit("accept");
+        }
+        slots.push_back(std::make_unique<CmaSlots>(args.message_size, args.window));
+        peers.push_back(std::make_unique<CmaPeer>(client_fd, *slots.back()));
+        client_fds.push_back(client_fd);
+    }
+    barrier.wait_until_notify(args.fan_in);
+
+    CmaFanIn transport(client_fds, slots, peers);
+    run_fan_in_server(server, args, transport);
+
+    for (int client_fd : client_fds)
+    {
+        close(client_fd);
+    }
+    close(server_fd);
+    unlink(CMA_SOCKET_PATH);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    std::cout << "Launching server" << std::endl;
+    // The payload never goes through the socket, so large messages are allowed
+    Args args = parse_args(argc, argv, MAX_LARGE_MESSAGE_SIZE);
+    ReadyBarrier barrier(ReadyBarrier::Role::SERVER);
+
+    int server_fd, client_fd;
+    struct sockaddr_un addr;
+
+    if ((server_fd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1)
+    {
+        report_and_exit("socket");
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, CMA_SOCKET_PATH, sizeof(addr.sun_path) - 1);
+
+    unlink(CMA_SOCKET_PATH); // Remove any existing socket file
+    if (bind(server_fd, (struct sockaddr *)&addr, sizeof(addr)) == -1)
+    {
+        close(server_fd);
+        report_and_exit("bind");
+    }
+
+    if (is_fan_in(args))
+    {
+        return serve_fan_in(args, barrier, server_fd);
+    }
+    Benchmarks benchmarks(pipelined_name("cma", args), args);
+
+    if (listen(server_fd, 1) == -1)
+    {
+        close(server_fd);
+        report_and_exit("listen");
+    }
+
+    std::cout << "Server listening on " << CMA_SOCKET_PATH << std::endl;
+    barrier.notify();
+
+    if ((client_fd = accept(server_fd, NULL, NULL)) == -1)
+    {
+        close(server_fd);
+        report_and_exit("accept");
+    }
+
+    // The server only receives the client's echoes, one at a time
+    CmaSlots slots(args.message_size, 1);
+    CmaPeer peer(client_fd, slots);
+
+    // Wait until the client has its slots and may be written to
+    barrier.wait_until_notify();
+    CmaTransport transport(client_fd, slots, peer);
+    run_server(benchmarks, args, transport);
+
+    close(client_fd);
+    close(server_fd);
+    unlink(CMA_SOCKET_PATH);
+    return 0;
+}
@@ -0,0 +1,82 @@
+#include "affinity.hh"
+#include "utils.hh"
+
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <sched.h>
+
+void pin_to_cpu(int cpu)
+{
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) == -1)
+    {
+        std::cerr << "Failed to pin to CPU " << cpu << std::endl;
+        report_and_exit("sched_setaffinity");
+    }
+#else
+    // macOS only exposes affinity hints via `thread_policy_set`, which are not binding
+    std::cerr << "CPU pinning is only supported on Linux, ignoring CPU " << cpu << std::endl;
+#endif
+}
+
+std::vector<int> available_cpus()
+{
+    std::vector<int> cpus;
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == -1)
+    {
+        report_and_exit("sched_getaffinity");
+    }
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+    {
+        if (CPU_ISSET(cpu, &set))
+        {
+            cpus.push_back(cpu);
+        }
+    }
+#else
+    for (unsigned int cpu = 0; cpu < std::thread::hardware_concurrency(); cpu++)
+    {
+        cpus.push_back(cpu);
+    }
+#endif
+    return cpus;
+}
+
+std::vector<int> parse_cpu_list(const std::string &list)
+{
+    if (list == "all")
+    {
+        return available_cpus();
+    }
+
+    std::vector<int> cpus;
+    std::stringstream stream(list);
+    std::string range;
+    while (std::getline(stream, range, ','))
+    {
+        char *end = nullptr;
+        long first = std::strtol(range.c_str(), &end, 10);
+        long last = first;
+        if (*end == '-')
+        {
+            last = std::strtol(end + 1, &end, 10);
+        }
+        if (range.empty() || *end != '\0' || first < 0 || last < first)
+        {
+            std::cerr << "Invalid CPU list: " << list << " (expected e.g. 0,2,4-7 or all)" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        for (long cpu = first; cpu <= last; cpu++)
+        {
+            cpus.push_back(static_cast<int>(cpu));
+        }
+    }
+    return cpus;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Pins the calling process to `cpu`. Exits on failure. The affinity mask is
+// inherited across `fork` and `exec`, so the launcher pins children before `exec`.
+void pin_to_cpu(int cpu);
+
+// CPUs the calling process may run on (respects cgroup/taskset restrictions)
+std::vector<int> available_cpus();
+
+// Parses a CPU list such as `0,2,4-7`, or `all` for `available_cpus()`.
+// Exits on malformed input.
+std::vector<int> parse_cpu_list(const std::string &list);
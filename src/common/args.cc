@@ -1,52 +1,328 @@
 #include "args.hh"
+#include "fan_in.hh"
+#include "workload.hh"
 
-Args parse_args(int argc, char *argv[])
+#include <sstream>
+
+// Options shared by `parse_args` and `parse_launcher_args`
+constexpr const char *COMMON_OPTS = "m:i:w:c:s:b:p:o:t:z:e:k:g:q:f:j:u:y:lx:S:C:PW:r:";
+constexpr const char *LAUNCHER_USAGE = " -n <benchmark name> "
+                                       "[-A <cpu list|all>] [-X <matrix file> [-M <sizes>] [-I <iterations>] "
+                                       "[-N <benchmark names>] [-T <socket types>] [-K <pipe modes>] [-Q <mq wait modes>] "
+                                       "[-Z <kernel buffer sizes>] [-F <fan-in client counts>] "
+                                       "[-R <repetitions>]] [-L <offered loads>]";
+constexpr const char *COMMON_USAGE = " -m <message_size> -i <iterations> [-w <wait strategy>] "
+                                     "[-c <monotonic|tsc>] [-s <sample every N>] [-b <batch size>] [-p <window>] "
+                                     "[-o <results file>] [-t <stream|seqpacket|dgram>] [-z <kernel buffer size>] "
+                                     "[-e <syscall|io_uring|io_uring_sqpoll>] [-k <copy|vmsplice|packet>] "
+                                     "[-g <bulk size>] [-q <block|timed|poll|notify>] [-f <clients>] "
+                                     "[-u <shm|thp|hugetlb>] [-y <none|populate|touch>] [-l] "
+                                     "[-x <spsc|shm|pipe|unix_socket|message_queue>] [-S <server cpu>] [-C <client cpu>] [-P] "
+                                     "[-W <fixed|uniform:min:max|bimodal:small:large:percent|zipf:min:max:exponent|trace:path>] "
+                                     "[-r <messages/sec>]";
+
+ull parse_byte_size(const char *text)
 {
-    Args args;
-    int opt;
-    bool message_size_set = false;
-    bool iterations_set = false;
+    char *end;
+    ull size = std::strtoull(text, &end, 10);
+    switch (*end)
+    {
+    case '\0':
+        return size;
+    case 'K':
+    case 'k':
+        size <<= 10;
+        break;
+    case 'M':
+    case 'm':
+        size <<= 20;
+        break;
+    case 'G':
+    case 'g':
+        size <<= 30;
+        break;
+    default:
+        return 0;
+    }
+    return end[1] == '\0' ? size : 0;
+}
 
-    while ((opt = getopt(argc, argv, "m:i:")) != -1)
+// Handles an option common to all benchmarks, returns false if `opt` is not one of them
+static bool parse_common_opt(int opt, Args &args, bool &message_size_set, bool &iterations_set)
+{
+    switch (opt)
     {
-        switch (opt)
+    case 'm':
+        args.message_size = std::strtoul(optarg, nullptr, 10);
+        message_size_set = true;
+        return true;
+    case 'i':
+        args.iterations = std::strtoull(optarg, nullptr, 10);
+        iterations_set = true;
+        return true;
+    case 'w':
+        args.wait_strategy = optarg;
+        return true;
+    case 'c':
+        args.clock = optarg;
+        return true;
+    case 's':
+        args.sample_every = std::strtoull(optarg, nullptr, 10);
+        return true;
+    case 'b':
+        args.batch_size = std::strtoull(optarg, nullptr, 10);
+        return true;
+    case 'p':
+        args.window = std::strtoull(optarg, nullptr, 10);
+        return true;
+    case 'o':
+        args.results_path = optarg;
+        return true;
+    case 't':
+        args.socket_type = optarg;
+        return true;
+    case 'z':
+        args.kernel_buffer_size = std::strtoul(optarg, nullptr, 10);
+        return true;
+    case 'e':
+        args.io_engine = optarg;
+        return true;
+    case 'k':
+        args.pipe_mode = optarg;
+        return true;
+    case 'q':
+        args.mq_wait = optarg;
+        return true;
+    case 'f':
+        args.fan_in = std::strtoull(optarg, nullptr, 10);
+        return true;
+    case 'j':
+        args.client_id = std::strtoull(optarg, nullptr, 10);
+        return true;
+    case 'u':
+        args.shm_backing = optarg;
+        return true;
+    case 'y':
+        args.shm_prefault = optarg;
+        return true;
+    case 'l':
+        args.shm_lock = true;
+        return true;
+    case 'x':
+        args.thread_transport = optarg;
+        return true;
+    case 'S':
+        args.server_cpu = std::atoi(optarg);
+        return true;
+    case 'C':
+        args.client_cpu = std::atoi(optarg);
+        return true;
+    case 'P':
+        args.perf_counters = true;
+        return true;
+    case 'W':
+        args.workload = optarg;
+        return true;
+    case 'r':
+        args.send_rate = std::strtoull(optarg, nullptr, 10);
+        return true;
+    case 'g':
+        args.bulk_size = parse_byte_size(optarg);
+        if (args.bulk_size == 0)
         {
-        case 'm':
-            args.message_size = std::strtoul(optarg, nullptr, 10);
-            message_size_set = true;
-            break;
-        case 'i':
-            args.iterations = std::strtoull(optarg, nullptr, 10);
-            iterations_set = true;
-            break;
-        default:
-            std::cerr << "Usage: " << argv[0] << " -m <message_size> -i <iterations>\n";
+            std::cerr << "Bulk size must be a positive byte count, e.g. 1048576, 64M or 2G" << std::endl;
             exit(EXIT_FAILURE);
         }
+        return true;
+    default:
+        return false;
     }
+}
 
-    // Check if both required parameters are set
-    if (!message_size_set || !iterations_set)
+// Exits if the common options are out of range
+static void validate_common_args(const Args &args, ull max_message_size)
+{
+    if (args.message_size == 0 || args.iterations == 0)
     {
-        std::cerr << "Both -m <message_size> and -i <iterations> options are required.\n";
-        std::cerr << "Usage: " << argv[0] << " -m <message_size> -i <iterations>\n";
+        std::cerr << "Both message_size and iterations must be positive integers" << std::endl;
         exit(EXIT_FAILURE);
     }
 
-    if (args.message_size == 0 || args.iterations == 0)
+    if (args.message_size > max_message_size)
+    {
+        std::cerr << "Message size must be less than " << max_message_size << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    if (args.clock != "monotonic" && args.clock != "tsc")
+    {
+        std::cerr << "Clock must be one of monotonic or tsc" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    if (args.sample_every == 0 || args.batch_size == 0)
+    {
+        std::cerr << "Both sample_every and batch_size must be positive integers" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    if (args.window == 0)
     {
-        std::cerr << "Both message_size and iterations must be positive integers\n";
+        std::cerr << "Window must be a positive integer" << std::endl;
         exit(EXIT_FAILURE);
     }
 
-    if (args.message_size > MAX_MESSAGE_SIZE)
+    if (args.sample_every > 1 && args.batch_size > 1)
     {
-        std::cerr << "Message size must be less than " << MAX_MESSAGE_SIZE << "\n";
+        std::cerr << "Only one of -s <sample every N> and -b <batch size> may be set" << std::endl;
         exit(EXIT_FAILURE);
     }
 
-    std::cout << "Running server/client with args: message_size=" << args.message_size
-              << ", iterations=" << args.iterations << std::endl;
+    if (args.socket_type != "stream" && args.socket_type != "seqpacket" && args.socket_type != "dgram")
+    {
+        std::cerr << "Socket type must be one of stream, seqpacket or dgram" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    if (args.io_engine != "syscall" && args.io_engine != "io_uring" && args.io_engine != "io_uring_sqpoll")
+    {
+        std::cerr << "IO engine must be one of syscall, io_uring or io_uring_sqpoll" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    if (args.pipe_mode != "copy" && args.pipe_mode != "vmsplice" && args.pipe_mode != "packet")
+    {
+        std::cerr << "Pipe mode must be one of copy, vmsplice or packet" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    if (args.mq_wait != "block" && args.mq_wait != "timed" && args.mq_wait != "poll" && args.mq_wait != "notify")
+    {
+        std::cerr << "POSIX queue wait mode must be one of block, timed, poll or notify" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    if (args.shm_backing != "shm" && args.shm_backing != "thp" && args.shm_backing != "hugetlb")
+    {
+        std::cerr << "Shared memory backing must be one of shm, thp or hugetlb" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    if (args.shm_prefault != "none" && args.shm_prefault != "populate" && args.shm_prefault != "touch")
+    {
+        std::cerr << "Shared memory prefault mode must be one of none, populate or touch" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    if (args.thread_transport != "spsc" && args.thread_transport != "shm" && args.thread_transport != "pipe" &&
+        args.thread_transport != "unix_socket" && args.thread_transport != "message_queue")
+    {
+        std::cerr << "Thread transport must be one of spsc, shm, pipe, unix_socket or message_queue" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    if (args.fan_in == 0 || args.client_id >= args.fan_in)
+    {
+        std::cerr << "Fan-in must be a positive number of clients and the client index less than it" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    if (is_fan_in(args))
+    {
+        // Every message carries the sender and its send time (its due time in open-loop mode)
+        if (args.message_size < sizeof(FanInHeader))
+        {
+            std::cerr << "Fan-in messages must be at least " << sizeof(FanInHeader) << " bytes" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        if (args.bulk_size > 0 || args.io_engine != "syscall")
+        {
+            std::cerr << "Fan-in and open-loop mode support neither bulk mode nor the io_uring engines" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (is_variable_size(args))
+    {
+        // Fan-in messages carry a header of their own, bulk chunks and vmsplice pages are fixed
+        // size and never read
+        if (is_fan_in(args) || args.bulk_size > 0 || args.pipe_mode == "vmsplice")
+        {
+            std::cerr << "Variable size workloads support neither fan-in, open-loop, bulk mode nor the vmsplice pipe "
+                      << "mode" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        check_workload(args);
+    }
+
+    // Chunks are fixed size, so the payload must split into whole messages
+    if (args.bulk_size % args.message_size != 0)
+    {
+        std::cerr << "Bulk size must be a multiple of the message size" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
+static void print_common_args(const Args &args)
+{
+    std::cout << "message_size=" << args.message_size
+              << ", iterations=" << args.iterations
+              << ", wait_strategy=" << args.wait_strategy
+              << ", clock=" << args.clock
+              << ", sample_every=" << args.sample_every
+              << ", batch_size=" << args.batch_size
+              << ", window=" << args.window
+              << ", socket_type=" << args.socket_type
+              << ", kernel_buffer_size=" << args.kernel_buffer_size
+              << ", io_engine=" << args.io_engine
+              << ", pipe_mode=" << args.pipe_mode
+              << ", mq_wait=" << args.mq_wait
+              << ", fan_in=" << args.fan_in
+              << ", shm_backing=" << args.shm_backing
+              << ", shm_prefault=" << args.shm_prefault
+              << ", shm_lock=" << args.shm_lock
+              << ", bulk_size=" << args.bulk_size
+              << ", thread_transport=" << args.thread_transport
+              << ", server_cpu=" << args.server_cpu
+              << ", client_cpu=" << args.client_cpu
+              << ", perf_counters=" << args.perf_counters
+              << ", workload=" << args.workload
+              << ", send_rate=" << args.send_rate;
+    if (!args.results_path.empty())
+    {
+        std::cout << ", results_path=" << args.results_path;
+    }
+}
+
+Args parse_args(int argc, char *argv[], ull max_message_size)
+{
+    Args args;
+    int opt;
+    bool message_size_set = false;
+    bool iterations_set = false;
+
+    while ((opt = getopt(argc, argv, COMMON_OPTS)) != -1)
+    {
+        if (!parse_common_opt(opt, args, message_size_set, iterations_set))
+        {
+            std::cerr << "Usage: " << argv[0] << COMMON_USAGE << "\n";
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // Check if both required parameters are set
+    if (!message_size_set || !iterations_set)
+    {
+        std::cerr << "Both -m <message_size> and -i <iterations> options are required.\n";
+        std::cerr << "Usage: " << argv[0] << COMMON_USAGE << "\n";
+        exit(EXIT_FAILURE);
+    }
+
+    validate_common_args(args, max_message_size);
+
+    std::cout << "Running server/client with args: ";
+    print_common_args(args);
+    std::cout << std::endl;
 
     return args;
 }
@@ -58,24 +334,84 @@ LauncherArgs parse_launcher_args(int argc, char *argv[])
     bool message_size_set = false;
     bool iterations_set = false;
     bool benchmark_name_set = false;
-    while ((opt = getopt(argc, argv, "m:i:n:")) != -1)
+    std::string opts = std::string(COMMON_OPTS) + "n:A:X:M:I:N:T:K:Q:Z:F:R:L:";
+    while ((opt = getopt(argc, argv, opts.c_str())) != -1)
     {
+        if (parse_common_opt(opt, args, message_size_set, iterations_set))
+        {
+            continue;
+        }
         switch (opt)
         {
-        case 'm':
-            args.message_size = std::strtoul(optarg, nullptr, 10);
+        case 'n':
+            args.benchmark_name = optarg;
+            benchmark_name_set = true;
+            break;
+        case 'A':
+            args.affinity_sweep = optarg;
+            break;
+        case 'X':
+            args.matrix_path = optarg;
+            break;
+        case 'M':
+            for (const std::string &size : split_list(optarg))
+            {
+                args.sweep_message_sizes.push_back(std::strtoul(size.c_str(), nullptr, 10));
+            }
+            args.message_size = args.sweep_message_sizes.empty() ? 0 : args.sweep_message_sizes.front();
             message_size_set = true;
             break;
-        case 'i':
-            args.iterations = std::strtoull(optarg, nullptr, 10);
+        case 'I':
+            for (const std::string &iterations : split_list(optarg))
+            {
+                args.sweep_iterations.push_back(std::strtoull(iterations.c_str(), nullptr, 10));
+            }
+            args.iterations = args.sweep_iterations.empty() ? 0 : args.sweep_iterations.front();
             iterations_set = true;
             break;
-        case 'n':
-            args.benchmark_name = optarg;
+        case 'N':
+            args.sweep_benchmarks = split_list(optarg);
+            args.benchmark_name = args.sweep_benchmarks.empty() ? "" : args.sweep_benchmarks.front();
             benchmark_name_set = true;
             break;
+        case 'T':
+            args.sweep_socket_types = split_list(optarg);
+            args.socket_type = args.sweep_socket_types.empty() ? "" : args.sweep_socket_types.front();
+            break;
+        case 'K':
+            args.sweep_pipe_modes = split_list(optarg);
+            args.pipe_mode = args.sweep_pipe_modes.empty() ? "" : args.sweep_pipe_modes.front();
+            break;
+        case 'Q':
+            args.sweep_mq_waits = split_list(optarg);
+            args.mq_wait = args.sweep_mq_waits.empty() ? "" : args.sweep_mq_waits.front();
+            break;
+        case 'Z':
+            for (const std::string &size : split_list(optarg))
+            {
+                args.sweep_kernel_buffer_sizes.push_back(std::strtoul(size.c_str(), nullptr, 10));
+            }
+            args.kernel_buffer_size = args.sweep_kernel_buffer_sizes.empty() ? 0 : args.sweep_kernel_buffer_sizes.front();
+            break;
+        case 'F':
+            for (const std::string &fan_in : split_list(optarg))
+            {
+                args.sweep_fan_ins.push_back(std::strtoull(fan_in.c_str(), nullptr, 10));
+            }
+            args.fan_in = args.sweep_fan_ins.empty() ? 0 : args.sweep_fan_ins.front();
+            break;
+        case 'R':
+            args.repetitions = std::strtoull(optarg, nullptr, 10);
+            break;
+        case 'L':
+            for (const std::string &rate : split_list(optarg))
+            {
+                args.sweep_send_rates.push_back(std::strtoull(rate.c_str(), nullptr, 10));
+            }
+            args.send_rate = args.sweep_send_rates.empty() ? 0 : args.sweep_send_rates.front();
+            break;
         default:
-            std::cerr << "Usage: " << argv[0] << " -m <message_size> -i <iterations> -n <benchmark name>" << std::endl;
+            std::cerr << "Usage: " << argv[0] << COMMON_USAGE << LAUNCHER_USAGE << std::endl;
             exit(EXIT_FAILURE);
         }
     }
@@ -83,33 +419,190 @@ LauncherArgs parse_launcher_args(int argc, char *argv[])
     // Check if required parameters are set
     if (!message_size_set || !iterations_set || !benchmark_name_set)
     {
-        std::cerr << "All -m <message_size>, -i <iterations>, and -n <benchmark name> options are required." << std::endl;
-        std::cerr << "Usage: " << argv[0] << " -m <message_size> -i <iterations> -n <benchmark name>" << std::endl;
+        std::cerr << "All -m <message_size>, -i <iterations>, and -n <benchmark name> options (or their -M, -I, -N "
+                  << "sweep lists) are required." << std::endl;
+        std::cerr << "Usage: " << argv[0] << COMMON_USAGE << LAUNCHER_USAGE << std::endl;
         exit(EXIT_FAILURE);
     }
 
-    if (args.message_size == 0 || args.iterations == 0)
+    // Each benchmark enforces its own (possibly smaller) cap when it parses the forwarded options
+    validate_common_args(args, MAX_LARGE_MESSAGE_SIZE);
+
+    if (args.benchmark_name.empty())
     {
-        std::cerr << "Both message_size and iterations must be positive integers" << std::endl;
+        std::cerr << "Benchmark name must be provided to the launcher" << std::endl;
         exit(EXIT_FAILURE);
     }
 
-    if (args.message_size > MAX_MESSAGE_SIZE)
+    // Sweep lists default to the single value, so the sweep always iterates the lists
+    if (args.sweep_message_sizes.empty())
     {
-        std::cerr << "Message size must be less than " << MAX_MESSAGE_SIZE << std::endl;
-        exit(EXIT_FAILURE);
+        args.sweep_message_sizes.push_back(args.message_size);
     }
-
-    if (args.benchmark_name.empty())
+    if (args.sweep_iterations.empty())
     {
-        std::cerr << "Benchmark name must be provided to the launcher" << std::endl;
+        args.sweep_iterations.push_back(args.iterations);
+    }
+    if (args.sweep_benchmarks.empty())
+    {
+        args.sweep_benchmarks.push_back(args.benchmark_name);
+    }
+    if (args.sweep_socket_types.empty())
+    {
+        args.sweep_socket_types.push_back(args.socket_type);
+    }
+    if (args.sweep_pipe_modes.empty())
+    {
+        args.sweep_pipe_modes.push_back(args.pipe_mode);
+    }
+    for (const std::string &pipe_mode : args.sweep_pipe_modes)
+    {
+        if (pipe_mode != "copy" && pipe_mode != "vmsplice" && pipe_mode != "packet")
+        {
+            std::cerr << "Sweep pipe modes must be one of copy, vmsplice or packet" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (args.sweep_mq_waits.empty())
+    {
+        args.sweep_mq_waits.push_back(args.mq_wait);
+    }
+    for (const std::string &mq_wait : args.sweep_mq_waits)
+    {
+        if (mq_wait != "block" && mq_wait != "timed" && mq_wait != "poll" && mq_wait != "notify")
+        {
+            std::cerr << "Sweep POSIX queue wait modes must be one of block, timed, poll or notify" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (args.sweep_kernel_buffer_sizes.empty())
+    {
+        args.sweep_kernel_buffer_sizes.push_back(args.kernel_buffer_size);
+    }
+    for (const std::string &socket_type : args.sweep_socket_types)
+    {
+        if (socket_type != "stream" && socket_type != "seqpacket" && socket_type != "dgram")
+        {
+            std::cerr << "Sweep socket types must be one of stream, seqpacket or dgram" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+    for (size_t message_size : args.sweep_message_sizes)
+    {
+        if (message_size == 0 || message_size > MAX_LARGE_MESSAGE_SIZE)
+        {
+            std::cerr << "Sweep message sizes must be positive and less than " << MAX_LARGE_MESSAGE_SIZE << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (args.sweep_fan_ins.empty())
+    {
+        args.sweep_fan_ins.push_back(args.fan_in);
+    }
+    for (unsigned long long fan_in : args.sweep_fan_ins)
+    {
+        if (fan_in == 0)
+        {
+            std::cerr << "Sweep fan-in client counts must be positive integers" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+    for (unsigned long long iterations : args.sweep_iterations)
+    {
+        if (iterations == 0)
+        {
+            std::cerr << "Sweep iterations must be positive integers" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+    for (unsigned long long send_rate : args.sweep_send_rates)
+    {
+        if (send_rate == 0)
+        {
+            std::cerr << "Offered loads must be positive messages per second" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (args.repetitions == 0)
+    {
+        std::cerr << "Repetitions must be a positive integer" << std::endl;
         exit(EXIT_FAILURE);
     }
 
-    std::cout << "Running the launcher with: message_size=" << args.message_size
-              << ", iterations=" << args.iterations
-              << ", benchmark_name=" << args.benchmark_name
-              << std::endl;
+    std::cout << "Running the launcher with: ";
+    print_common_args(args);
+    std::cout << ", benchmark_name=" << args.benchmark_name;
+    if (!args.affinity_sweep.empty())
+    {
+        std::cout << ", affinity_sweep=" << args.affinity_sweep;
+    }
+    if (!args.matrix_path.empty())
+    {
+        std::cout << ", matrix_path=" << args.matrix_path
+                  << ", repetitions=" << args.repetitions;
+    }
+    std::cout << std::endl;
 
     return args;
-}
\ No newline at end of file
+}
+
+std::vector<std::string> split_list(const std::string &list)
+{
+    std::vector<std::string> items;
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ','))
+    {
+        if (!item.empty())
+        {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+std::vector<std::string> format_args(const Args &args)
+{
+    std::vector<std::string> options = {
+        "-m", std::to_string(args.message_size),
+        "-i", std::to_string(args.iterations),
+        "-w", args.wait_strategy,
+        "-c", args.clock,
+        "-s", std::to_string(args.sample_every),
+        "-b", std::to_string(args.batch_size),
+        "-p", std::to_string(args.window),
+        "-t", args.socket_type,
+        "-z", std::to_string(args.kernel_buffer_size),
+        "-e", args.io_engine,
+        "-k", args.pipe_mode,
+        "-q", args.mq_wait,
+        "-f", std::to_string(args.fan_in),
+        "-j", std::to_string(args.client_id),
+        "-u", args.shm_backing,
+        "-y", args.shm_prefault,
+        "-x", args.thread_transport,
+        "-S", std::to_string(args.server_cpu),
+        "-C", std::to_string(args.client_cpu),
+        "-W", args.workload,
+        "-r", std::to_string(args.send_rate),
+    };
+    if (args.shm_lock)
+    {
+        options.push_back("-l");
+    }
+    if (args.perf_counters)
+    {
+        options.push_back("-P");
+    }
+    if (args.bulk_size != 0)
+    {
+        options.push_back("-g");
+        options.push_back(std::to_string(args.bulk_size));
+    }
+    if (!args.results_path.empty())
+    {
+        options.push_back("-o");
+        options.push_back(args.results_path);
+    }
+    return options;
+}
@@ -4,20 +4,110 @@
 
 #include <getopt.h>
 #include <iostream>
+#include <string>
+#include <vector>
 
 struct Args
 {
     size_t message_size;
     unsigned long long iterations;
+    // How a blocked reader waits for the next message (currently only used by shm)
+    std::string wait_strategy = "spin";
+    // Timing source used by `Benchmarks`, `monotonic` or `tsc`
+    std::string clock = "monotonic";
+    // Only time every `sample_every`-th iteration
+    unsigned long long sample_every = 1;
+    // Take one timestamp pair per `batch_size` iterations instead of per iteration
+    unsigned long long batch_size = 1;
+    // Maximum number of unacknowledged messages in flight, 1 is ping-pong
+    unsigned long long window = 1;
+    // If set, the timed side appends a CSV summary of the run to this file
+    std::string results_path;
+    // Unix socket type, `stream`, `seqpacket` or `dgram` (only used by unix_socket)
+    std::string socket_type = "stream";
+    // How the pipe benchmark moves messages, `copy`, `vmsplice` or `packet`
+    std::string pipe_mode = "copy";
+    // How a posix_mq receiver waits, `block`, `timed`, `poll` or `notify`
+    std::string mq_wait = "block";
+    // Kernel buffer size, `SO_SNDBUF`/`SO_RCVBUF` of unix_socket and `F_SETPIPE_SZ` of pipe.
+    // 0 keeps the system default.
+    size_t kernel_buffer_size = 0;
+    // IO backend of the pipe, named_pipe and unix_socket benchmarks, `syscall`, `io_uring` or `io_uring_sqpoll`
+    std::string io_engine = "syscall";
+    // Number of clients sending to the one server, more than 1 enables fan-in mode
+    unsigned long long fan_in = 1;
+    // Index of this client in fan-in mode, set per client by the launcher
+    unsigned long long client_id = 0;
+    // Messages per second each client sends in open-loop mode, on a fixed schedule whatever
+    // the replies, 0 for the closed loop which sends as soon as the window allows
+    unsigned long long send_rate = 0;
+    // Backing of the shm segments, `shm` (`shm_open` pages), `thp` (`shm_open` with transparent
+    // huge pages) or `hugetlb` (a file on hugetlbfs)
+    std::string shm_backing = "shm";
+    // How shm segments are faulted in before the timed loop, `none`, `populate` (`MAP_POPULATE`)
+    // or `touch` (writing every page)
+    std::string shm_prefault = "none";
+    // Whether shm segments are locked into memory with `mlock`
+    bool shm_lock = false;
+    // Bulk mode payload size, each iteration streams one payload of this many bytes as chunks
+    // of `message_size` bytes. Must be a multiple of `message_size`, 0 disables bulk mode.
+    unsigned long long bulk_size = 0;
+    // Primitive the threads benchmark runs its two threads over, `spsc`, `shm`, `pipe`,
+    // `unix_socket` or `message_queue`
+    std::string thread_transport = "spsc";
+    // CPUs to pin the server and client to, -1 to leave placement to the scheduler. The
+    // launcher pins the processes, the threads benchmark pins its two threads.
+    int server_cpu = -1;
+    int client_cpu = -1;
+    // Whether the server and client count hardware and software events over the timed loop
+    // with `perf_event_open` and report them per message
+    bool perf_counters = false;
+    // Message sizes the server sends, `fixed` for `message_size` bytes each, else a variable
+    // size workload (see `workload.hh`) of frames of at most `message_size` bytes
+    std::string workload = "fixed";
 };
 
-struct LauncherArgs
+struct LauncherArgs : Args
 {
-    size_t message_size;
-    unsigned long long iterations;
     std::string benchmark_name;
+    // If set, runs the benchmark for every (server, client) pair of these CPUs, e.g. `0-3` or `all`
+    std::string affinity_sweep;
+    // Parameter sweep, every combination of these lists is run `repetitions` times and
+    // summarized into `matrix_path`. Each list defaults to the single -m, -i or -n value.
+    std::vector<size_t> sweep_message_sizes;
+    std::vector<unsigned long long> sweep_iterations;
+    std::vector<std::string> sweep_benchmarks;
+    // Socket types are only swept for unix_socket, pipe modes for pipe, wait modes for
+    // posix_mq and kernel buffer sizes for unix_socket and pipe. They default to the
+    // single -t, -k, -q or -z value.
+    std::vector<std::string> sweep_socket_types;
+    std::vector<std::string> sweep_pipe_modes;
+    std::vector<std::string> sweep_mq_waits;
+    std::vector<size_t> sweep_kernel_buffer_sizes;
+    // Fan-in client counts, defaults to the single -f value
+    std::vector<unsigned long long> sweep_fan_ins;
+    // Offered loads (open-loop messages per second per client). Without a matrix the
+    // benchmarks are run at each of them and their latency knee is printed, with one the
+    // loads are a dimension of the matrix. Empty to run at the single -r value.
+    std::vector<unsigned long long> sweep_send_rates;
+    unsigned long long repetitions = 1;
+    // If set, runs the parameter sweep and writes its matrix here (JSON for a `.json` path, else CSV)
+    std::string matrix_path;
 };
 
-Args parse_args(int argc, char *argv[]);
+// Parses the options of a client or server. Transports which support messages larger
+// than `MAX_MESSAGE_SIZE` pass their own cap.
+Args parse_args(int argc, char *argv[], ull max_message_size = MAX_MESSAGE_SIZE);
 
 LauncherArgs parse_launcher_args(int argc, char *argv[]);
+
+// Parses a byte count with an optional binary `K`, `M` or `G` suffix, e.g. `64K` or `4G`.
+// Returns 0 if `text` is malformed.
+ull parse_byte_size(const char *text);
+
+// Splits a comma separated list, e.g. `64,128,1024`
+std::vector<std::string> split_list(const std::string &list);
+
+// Formats `args` as command line options accepted by `parse_args`, used by the launcher
+// to forward its options to the client and server
+std::vector<std::string> format_args(const Args &args);
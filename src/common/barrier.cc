@@ -0,0 +1,137 @@
+#include "barrier.hh"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+
+// Creates a channel in `fds` (read end, write end)
+static void create_channel(int fds[2])
+{
+#ifdef __linux__
+    // In semaphore mode each read takes one notification, so every one of several
+    // clients consumes exactly one of the server's
+    int fd = eventfd(0, EFD_SEMAPHORE);
+    if (fd == -1)
+    {
+        report_and_exit("eventfd");
+    }
+    fds[0] = fd;
+    fds[1] = fd;
+#else
+    if (pipe(fds) == -1)
+    {
+        report_and_exit("pipe");
+    }
+#endif
+}
+
+ReadyBarrier::ReadyBarrier(Role role)
+    : role(role), server_ready_fds{-1, -1}, client_ready_fds{-1, -1}
+{
+    if (role == Role::LAUNCHER)
+    {
+        create_channel(server_ready_fds);
+        create_channel(client_ready_fds);
+        std::string fds = std::to_string(server_ready_fds[0]) + "," + std::to_string(server_ready_fds[1]) + "," +
+                          std::to_string(client_ready_fds[0]) + "," + std::to_string(client_ready_fds[1]);
+        setenv(READY_FDS_ENV, fds.c_str(), 1);
+        return;
+    }
+
+    const char *fds = getenv(READY_FDS_ENV);
+    if (fds == nullptr ||
+        sscanf(fds, "%d,%d,%d,%d", &server_ready_fds[0], &server_ready_fds[1],
+               &client_ready_fds[0], &client_ready_fds[1]) != 4)
+    {
+        std::cerr << "No readiness barrier from the launcher, start the server before the client" << std::endl;
+        server_ready_fds[0] = server_ready_fds[1] = client_ready_fds[0] = client_ready_fds[1] = -1;
+    }
+}
+
+ReadyBarrier::~ReadyBarrier()
+{
+    if (role == Role::LAUNCHER)
+    {
+        // The exported descriptors are about to be closed
+        unsetenv(READY_FDS_ENV);
+    }
+    close_fds();
+}
+
+void ReadyBarrier::close_fds()
+{
+    for (int *fds : {server_ready_fds, client_ready_fds})
+    {
+        if (fds[0] != -1)
+        {
+            close(fds[0]);
+        }
+        if (fds[1] != -1 && fds[1] != fds[0])
+        {
+            close(fds[1]);
+        }
+        fds[0] = fds[1] = -1;
+    }
+}
+
+void ReadyBarrier::assume_role(Role new_role)
+{
+    role = new_role;
+}
+
+void ReadyBarrier::notify(unsigned long long count)
+{
+    int fd = role == Role::SERVER ? server_ready_fds[1] : client_ready_fds[1];
+    if (fd == -1)
+    {
+        return;
+    }
+    // An eventfd adds the 8 byte value to its counter, a pipe only needs one byte per notification
+    bool is_eventfd = server_ready_fds[0] == server_ready_fds[1];
+    for (unsigned long long i = 0; i < (is_eventfd ? 1 : count); i++)
+    {
+        uint64_t value = is_eventfd ? count : 1;
+        size_t size = is_eventfd ? sizeof(value) : 1;
+        ssize_t bytes_written;
+        do
+        {
+            bytes_written = write(fd, &value, size);
+        } while (bytes_written == -1 && errno == EINTR);
+        if (bytes_written != static_cast<ssize_t>(size))
+        {
+            report_and_exit("ReadyBarrier::notify");
+        }
+    }
+}
+
+void ReadyBarrier::wait_until_notify(unsigned long long count)
+{
+    int fd = role == Role::SERVER ? client_ready_fds[0] : server_ready_fds[0];
+    if (fd == -1)
+    {
+        return;
+    }
+    // Both an eventfd in semaphore mode and a pipe hand out one notification per read
+    uint64_t value = 0;
+    size_t size = server_ready_fds[0] == server_ready_fds[1] ? sizeof(value) : 1;
+    for (unsigned long long i = 0; i < count; i++)
+    {
+        ssize_t bytes_read;
+        do
+        {
+            bytes_read = read(fd, &value, size);
+        } while (bytes_read == -1 && errno == EINTR);
+        if (bytes_read != static_cast<ssize_t>(size))
+        {
+            report_and_exit("ReadyBarrier::wait_until_notify");
+        }
+    }
+}
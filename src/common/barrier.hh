@@ -0,0 +1,59 @@
+#pragma once
+
+#include "utils.hh"
+
+// Environment variable the launcher exports the barrier file descriptors in
+constexpr const char *READY_FDS_ENV = "IPC_BENCH_READY_FDS";
+
+// Two way readiness handshake between a benchmark's server and its client (or, in fan-in
+// mode, its clients).
+// The server notifies once its endpoint exists (so the client can connect without the
+// launcher sleeping first) and the client notifies once it is ready to receive, after
+// which the server starts the timed loop. Waiting blocks in `read` on an eventfd (a
+// pipe on platforms without eventfd), so neither side spins and no signals are sent.
+class ReadyBarrier
+{
+public:
+    // Benchmarks are composed of a launcher, which starts the server and client processes
+    enum class Role
+    {
+        LAUNCHER,
+        SERVER,
+        CLIENT,
+    };
+
+private:
+    Role role;
+    // Read and write ends of the "server ready" and "client ready" channels, -1 if unset.
+    // With eventfd both ends are the same descriptor.
+    int server_ready_fds[2];
+    int client_ready_fds[2];
+
+    void close_fds();
+
+public:
+    // A LAUNCHER creates new channels and exports them in `READY_FDS_ENV` for the
+    // processes it execs, which inherit the descriptors. A SERVER or CLIENT attaches to
+    // the exported channels, if there are none (run without the launcher) the barrier
+    // is a no-op.
+    explicit ReadyBarrier(Role role);
+    ~ReadyBarrier();
+
+    ReadyBarrier(const ReadyBarrier &) = delete;
+    ReadyBarrier &operator=(const ReadyBarrier &) = delete;
+
+    // Takes the SERVER or CLIENT side of a LAUNCHER barrier after `fork` without `exec`
+    void assume_role(Role role);
+
+    // Signals the peer that this side is ready. A server with several clients notifies
+    // once for each of them.
+    void notify(unsigned long long count = 1);
+
+    // Blocks until the peer has called `notify` (`count` times, once per client for a
+    // server with several clients). A peer which exits first does not end the wait: every
+    // process (the launcher included) holds both ends of the channels, so the read never sees
+    // end of file. The launcher tears the waiting side down instead, it sends SIGTERM to the
+    // other processes once one fails, and its children get SIGTERM if the launcher itself
+    // exits. Without the launcher there is no barrier to wait on.
+    void wait_until_notify(unsigned long long count = 1);
+};
@@ -1,25 +1,111 @@
 #include "bench.hh"
+#include "workload.hh"
+#include <algorithm>
 #include <iostream>
 #include <string>
 #include <vector>
+#include <fstream>
+#include <iomanip>
+#include <sys/resource.h>
 
 const ull NS_PER_SEC = 1000000000;
 
-// Get the current time of the monotonically increasing clock in nanoseconds
-ull get_time_ns()
+static ull timeval_ns(const struct timeval &time)
 {
-    struct timespec ts;
-    clock_gettime(CLOCK_MONOTONIC, &ts);
-    return ts.tv_sec * 1000000000 + ts.tv_nsec;
+    return time.tv_sec * NS_PER_SEC + time.tv_usec * 1000;
 }
 
-Benchmarks::Benchmarks(const std::string &name, ull message_size) : name(name), start_ns(0), total_duration_ns(0), total_messages(0), message_size(message_size), niterations(0) {}
+ResourceUsage get_resource_usage()
+{
+    struct rusage rusage;
+#ifdef RUSAGE_THREAD
+    // The threads benchmark runs both sides in one process
+    getrusage(RUSAGE_THREAD, &rusage);
+#else
+    getrusage(RUSAGE_SELF, &rusage);
+#endif
+    ResourceUsage usage;
+    usage.user_ns = timeval_ns(rusage.ru_utime);
+    usage.system_ns = timeval_ns(rusage.ru_stime);
+    usage.voluntary_switches = rusage.ru_nvcsw;
+    usage.involuntary_switches = rusage.ru_nivcsw;
+    usage.minor_faults = rusage.ru_minflt;
+    usage.major_faults = rusage.ru_majflt;
+    // "time spent on the cpu, time spent waiting on a runqueue, # of timeslices run on this cpu"
+    // https://docs.kernel.org/scheduler/sched-stats.html
+    std::ifstream schedstat("/proc/thread-self/schedstat");
+    ull run_ns;
+    if (schedstat >> run_ns >> usage.run_queue_wait_ns)
+    {
+        usage.has_schedstat = true;
+    }
+    return usage;
+}
+
+void report_resource_usage(const std::string &prefix, const ResourceUsage &start, const ResourceUsage &end,
+                           ull iterations, ull messages)
+{
+    ull user_ns = end.user_ns - start.user_ns;
+    ull system_ns = end.system_ns - start.system_ns;
+    ull cpu_ns = user_ns + system_ns;
+    std::cout << prefix << "CPU time (ms): " << cpu_ns / 1000000 << std::endl;
+    std::cout << prefix << "CPU time (ns) / it: " << cpu_ns / std::max<ull>(iterations, 1) << std::endl;
+    std::cout << prefix << "CPU time (ns) / msg: " << cpu_ns / std::max<ull>(messages, 1) << std::endl;
+    std::cout << prefix << "User / system CPU time (ms): " << user_ns / 1000000 << " / " << system_ns / 1000000
+              << std::endl;
+    std::cout << prefix << "Context switches (voluntary / involuntary): "
+              << end.voluntary_switches - start.voluntary_switches << " / "
+              << end.involuntary_switches - start.involuntary_switches << std::endl;
+    if (start.has_schedstat && end.has_schedstat)
+    {
+        std::cout << prefix << "Run queue wait (ms): " << (end.run_queue_wait_ns - start.run_queue_wait_ns) / 1000000
+                  << std::endl;
+    }
+    std::cout << prefix << "Page faults (minor / major): " << end.minor_faults - start.minor_faults << " / "
+              << end.major_faults - start.major_faults << std::endl;
+}
+
+Benchmarks::Benchmarks(const std::string &name, const Args &args)
+    : name(workload_name(name, args)), clock(args.clock), sample_every(args.sample_every), batch_size(args.batch_size), start_stamp(0),
+      timing_iteration(true), total_duration_ns(0), total_messages(0),
+      message_size(args.bulk_size > 0 ? args.bulk_size : args.message_size), bulk(args.bulk_size > 0), niterations(0),
+      timed_iterations(0), first_lap_messages(0), start_message(0),
+      size_class_durations(is_variable_size(args) ? NUM_SIZE_CLASSES : 0), results_path(args.results_path),
+      perf_counters(args.perf_counters) {}
+
+void Benchmarks::set_first_lap(ull messages)
+{
+    first_lap_messages = messages;
+}
 
 // Start a new benchmark iteration
 // Returns -1 on error, 0 otherwise.
 int Benchmarks::start_iteration()
 {
-    this->start_ns = get_time_ns();
+    if (!usage_started)
+    {
+        usage_start = get_resource_usage();
+        usage_started = true;
+        perf_counters.start();
+    }
+
+    if (batch_size > 1)
+    {
+        // Only the first iteration of a batch is stamped
+        if (niterations % batch_size == 0)
+        {
+            start_message = total_messages;
+            start_stamp = clock.start_stamp();
+        }
+        return 0;
+    }
+
+    timing_iteration = niterations % sample_every == 0;
+    if (timing_iteration)
+    {
+        start_message = total_messages;
+        start_stamp = clock.start_stamp();
+    }
     return 0;
 }
 
@@ -27,19 +113,54 @@ int Benchmarks::start_iteration()
 // Returns -1 on error, 0 otherwise.
 int Benchmarks::end_iteration(ull num_messages)
 {
-    ull end_ns = get_time_ns();
+    ++niterations;
+    total_messages += num_messages;
+
+    ull timed_its = 1;
+    if (batch_size > 1)
+    {
+        batch_messages += num_messages;
+        // A trailing partial batch is counted but not timed
+        if (niterations % batch_size != 0)
+        {
+            return 0;
+        }
+        num_messages = batch_messages;
+        batch_messages = 0;
+        timed_its = batch_size;
+    }
+    else if (!timing_iteration)
+    {
+        iteration_max_size = 0;
+        iteration_bytes = 0;
+        return 0;
+    }
+
+    ull end_stamp = clock.end_stamp();
     // End >= start, this should always be true since the clock is monotonically increasing
-    if (end_ns < start_ns)
+    if (end_stamp < start_stamp)
     {
         std::cerr << "End time is less than start time" << std::endl;
         return -1;
     }
 
-    ull duration_ns = end_ns - start_ns;
-    durations.push_back(duration_ns);
+    ull duration_ns = clock.to_ns(end_stamp - start_stamp);
+    // A batch is recorded once with its average per iteration latency
+    durations.record(duration_ns / timed_its);
+    if (first_lap_messages > 0)
+    {
+        (start_message < first_lap_messages ? first_lap_durations : steady_durations).record(duration_ns / timed_its);
+    }
+    if (!size_class_durations.empty())
+    {
+        size_class_durations[size_class(iteration_max_size)].record(duration_ns / timed_its);
+        timed_bytes += iteration_bytes;
+        iteration_max_size = 0;
+        iteration_bytes = 0;
+    }
     total_duration_ns += duration_ns;
-    total_messages += num_messages;
-    ++niterations;
+    timed_messages += num_messages;
+    timed_iterations += timed_its;
 
     return 0;
 }
@@ -47,15 +168,108 @@ int Benchmarks::end_iteration(ull num_messages)
 // Display summary statistics to stdout in a pretty printed format
 void Benchmarks::report()
 {
+    // Before printing, so the report's own writes are not counted
+    perf_counters.stop();
+    ResourceUsage usage_end = get_resource_usage();
     std::cout << "========================================" << std::endl;
-    std::cout << "Benchmark: " << name << " (" << message_size << " byte msgs)" << std::endl;
+    std::cout << "Benchmark: " << name << " (" << (size_class_durations.empty() ? "" : "up to ") << message_size
+              << " byte msgs)" << std::endl;
     std::cout << "========================================" << std::endl;
     std::cout << "Iterations: " << niterations << std::endl;
+    if (timed_iterations == 0 || total_duration_ns == 0)
+    {
+        std::cout << "No timed iterations" << std::endl;
+        return;
+    }
+    std::cout << "Clock: " << clock.get_name() << std::endl;
+    if (sample_every > 1)
+    {
+        std::cout << "Timed iterations (every " << sample_every << "): " << timed_iterations << std::endl;
+    }
+    if (batch_size > 1)
+    {
+        std::cout << "Timed iterations (batches of " << batch_size << "): " << timed_iterations << std::endl;
+    }
     std::cout << "Total duration (sec): " << total_duration_ns / NS_PER_SEC << std::endl;
-    std::cout << "Duration (ns) / it: " << total_duration_ns / niterations << std::endl;
+    std::cout << "Duration (ns) / it: " << total_duration_ns / timed_iterations << std::endl;
+    std::cout << "Min (ns): " << durations.min() << std::endl;
+    std::cout << "p50 (ns): " << durations.percentile(50.0) << std::endl;
+    std::cout << "p90 (ns): " << durations.percentile(90.0) << std::endl;
+    std::cout << "p99 (ns): " << durations.percentile(99.0) << std::endl;
+    std::cout << "p99.9 (ns): " << durations.percentile(99.9) << std::endl;
+    std::cout << "p99.99 (ns): " << durations.percentile(99.99) << std::endl;
+    std::cout << "Max (ns): " << durations.max() << std::endl;
     std::cout << "Total messages: " << total_messages << std::endl;
-    std::cout << "Messages / sec: " << total_messages * NS_PER_SEC / total_duration_ns << std::endl;
-    std::cout << "Bytes / sec: " << total_messages * message_size * NS_PER_SEC / total_duration_ns << std::endl;
+    // Rates only include timed iterations so sampling does not skew them.
+    // Bulk byte counts (and message counts of long soak runs) overflow `ull` once scaled to
+    // nanoseconds, so the rates are computed in floating point.
+    ull messages_per_sec =
+        static_cast<ull>(static_cast<long double>(timed_messages) * NS_PER_SEC / total_duration_ns);
+    long double timed_payload_bytes = size_class_durations.empty()
+                                          ? static_cast<long double>(timed_messages) * message_size
+                                          : static_cast<long double>(timed_bytes);
+    long double bytes_per_sec = timed_payload_bytes * NS_PER_SEC / total_duration_ns;
+    std::cout << "Messages / sec: " << messages_per_sec << std::endl;
+    std::cout << "Bytes / sec: " << static_cast<ull>(bytes_per_sec) << std::endl;
+    if (bulk)
+    {
+        std::cout << "GB / sec: " << std::fixed << std::setprecision(3) << bytes_per_sec / 1e9 << std::defaultfloat
+                  << std::endl;
+    }
+    if (!size_class_durations.empty())
+    {
+        std::cout << "Mean message size (bytes): " << timed_bytes / std::max<ull>(timed_messages, 1) << std::endl;
+        // A pipelined iteration covers several messages and is classed by its largest one
+        std::cout << "Latency by largest message size, count / p50 / p99 / max (ns):" << std::endl;
+        for (size_t i = 0; i < size_class_durations.size(); i++)
+        {
+            const LatencyHistogram &class_durations = size_class_durations[i];
+            if (class_durations.count() == 0)
+            {
+                continue;
+            }
+            std::cout << "  " << size_class_label(i) << ": " << class_durations.count() << " / "
+                      << class_durations.percentile(50.0) << " / " << class_durations.percentile(99.0) << " / "
+                      << class_durations.max() << std::endl;
+        }
+    }
+    report_resource_usage("", usage_start, usage_end, niterations, total_messages);
+    perf_counters.report("", total_messages);
+    if (first_lap_messages > 0)
+    {
+        std::cout << "First lap (first " << first_lap_messages << " msgs) p50 / p99 / max (ns): "
+                  << first_lap_durations.percentile(50.0) << " / " << first_lap_durations.percentile(99.0) << " / "
+                  << first_lap_durations.max() << std::endl;
+    }
+    if (first_lap_messages > 0 && steady_durations.count() > 0)
+    {
+        std::cout << "Steady state p50 / p99 / max (ns): " << steady_durations.percentile(50.0) << " / "
+                  << steady_durations.percentile(99.0) << " / " << steady_durations.max() << std::endl;
+    }
+
+    if (!results_path.empty())
+    {
+        BenchResult result;
+        result.name = name;
+        result.message_size = message_size;
+        result.iterations = niterations;
+        result.messages_per_sec = messages_per_sec;
+        result.bytes_per_sec = static_cast<ull>(bytes_per_sec);
+        result.mean_ns = total_duration_ns / timed_iterations;
+        result.min_ns = durations.min();
+        result.p50_ns = durations.percentile(50.0);
+        result.p90_ns = durations.percentile(90.0);
+        result.p99_ns = durations.percentile(99.0);
+        result.p99_9_ns = durations.percentile(99.9);
+        result.p99_99_ns = durations.percentile(99.99);
+        result.max_ns = durations.max();
+        result.cpu_ns_per_msg = (usage_end.user_ns + usage_end.system_ns - usage_start.user_ns - usage_start.system_ns) /
+                                std::max<ull>(total_messages, 1);
+        if (!append_result(results_path, result))
+        {
+            std::cerr << "Failed to write results to " << results_path << std::endl;
+        }
+    }
 }
 
 // Add a new benchmark iteration to the given Benchmarks object as a member function
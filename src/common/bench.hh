@@ -4,35 +4,121 @@
 #include <string>
 #include <vector>
 #include "types.hh"
+#include "args.hh"
+#include "histogram.hh"
+#include "timing.hh"
+#include "results.hh"
+#include "perf_counters.hh"
 
 extern const ull NS_PER_SEC;
 
+// CPU time, scheduling and page faults of the calling thread so far (of the process on
+// platforms without `RUSAGE_THREAD`, where every benchmark side is a single thread anyway)
+struct ResourceUsage
+{
+    ull user_ns = 0;
+    ull system_ns = 0;
+    // Switches away while blocked (e.g. in `read` or a futex wait) and by preemption
+    ull voluntary_switches = 0;
+    ull involuntary_switches = 0;
+    // Served without I/O, e.g. a page of a shared memory segment mapped on first touch
+    ull minor_faults = 0;
+    // Needed I/O to be served
+    ull major_faults = 0;
+    // Time spent runnable but waiting for a CPU, from `/proc/thread-self/schedstat`. Only
+    // valid if `has_schedstat`, the file needs Linux with `CONFIG_SCHEDSTATS`.
+    ull run_queue_wait_ns = 0;
+    bool has_schedstat = false;
+};
+ResourceUsage get_resource_usage();
+
+// Prints the usage between `start` and `end`: CPU time in total, per iteration and per message,
+// its user and system split, context switches, run queue wait and page faults. Each line is
+// prefixed with `prefix`.
+void report_resource_usage(const std::string &prefix, const ResourceUsage &start, const ResourceUsage &end,
+                           ull iterations, ull messages);
+
 class Benchmarks
 {
 private:
     // Identifier for the benchmark
     const std::string name;
-    // Start of most recent iteration (ns)
-    ull start_ns;
-    // Vector duration of each iteration (ns)
-    std::vector<ull> durations;
-    // Total duration of all iterations (ns)
+    // Timestamp source selected by `-c`
+    const BenchClock clock;
+    // Only every `sample_every`-th iteration is timed
+    const ull sample_every;
+    // Iterations covered by one timestamp pair, the per iteration latency is the batch average
+    const ull batch_size;
+    // Start of most recent timed iteration or batch (clock ticks)
+    ull start_stamp;
+    // Whether the current iteration is timed when sampling
+    bool timing_iteration;
+    // Distribution of iteration durations (ns), fixed size so recording never allocates
+    LatencyHistogram durations;
+    // Total duration of all timed iterations (ns)
     ull total_duration_ns = 0;
     // Total number of messages sent
     ull total_messages = 0;
-    // Message size
+    // Number of messages sent in timed iterations
+    ull timed_messages = 0;
+    // Messages sent in the current batch
+    ull batch_messages = 0;
+    // Message size, the payload size in bulk mode
     ull message_size;
+    // Whether an iteration is one bulk payload, which adds the GB/s rate to the report
+    const bool bulk;
     // Number of iterations
     ull niterations;
+    // Number of timed iterations
+    ull timed_iterations;
+    // Resource usage at the start of the first iteration, so setup is excluded
+    ResourceUsage usage_start;
+    bool usage_started = false;
+    // Iterations starting within the first `first_lap_messages` messages are reported apart
+    // from the rest, 0 to not split the report
+    ull first_lap_messages;
+    // Messages sent before the current timed iteration (or batch) started
+    ull start_message;
+    // Durations of the timed iterations in and after the first lap (ns), when split
+    LatencyHistogram first_lap_durations;
+    LatencyHistogram steady_durations;
+    // Durations of the timed iterations by the size class of their largest message (see
+    // `size_class`), only for variable size workloads
+    std::vector<LatencyHistogram> size_class_durations;
+    // Largest message and bytes sent in the current iteration (or batch) so far
+    size_t iteration_max_size = 0;
+    ull iteration_bytes = 0;
+    // Bytes sent in timed iterations, the byte rate of variable size workloads
+    ull timed_bytes = 0;
+    // CSV file the summary is appended to, empty to only print the report
+    const std::string results_path;
+    // `-P` counters of the calling thread from the first iteration to the report
+    PerfCounters perf_counters;
 
 public:
     // Const lvalue reference allows rvalues in constructor
-    Benchmarks(const std::string &name, ull message_size);
+    // The clock and sampling mode are taken from `args`
+    Benchmarks(const std::string &name, const Args &args);
 
-    // Internally sets `start_ns` to the current time in nano seconds as measured
-    // by the system monotonically increasing clock
+    // Splits the latencies into the first lap, the iterations starting within the first
+    // `messages` messages, and the steady state after it. For a ring of `messages` slots
+    // the first lap is the one which faults in its pages.
+    void set_first_lap(ull messages);
+
+    // Internally records the start timestamp of the iteration (or batch) if it is timed
     int start_iteration();
 
+    // Records a message of `size` bytes sent in the current iteration, which variable size
+    // workloads call for every message between `start_iteration` and `end_iteration`
+    void record_message_size(size_t size)
+    {
+        if (size > iteration_max_size)
+        {
+            iteration_max_size = size;
+        }
+        iteration_bytes += size;
+    }
+
     // Function to add a new benchmark iteration
     // Internally calculates the duration since the last call to `start_iteration`
     int end_iteration(ull num_messages);
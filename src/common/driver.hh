@@ -0,0 +1,370 @@
+#pragma once
+
+#include "args.hh"
+#include "bench.hh"
+#include "fan_in.hh"
+#include "payload.hh"
+#include "perf_counters.hh"
+#include "pipeline.hh"
+#include "transport.hh"
+#include "types.hh"
+#include "workload.hh"
+
+#include <cstdlib>
+#include <iostream>
+
+// The benchmark loops every transport runs, over an endpoint satisfying `Transport` (see
+// `transport.hh`). A benchmark's `main` sets its endpoint up, synchronizes with the peer
+// through the `ReadyBarrier` and hands the endpoint to `run_server`, `run_client` or
+// `run_fan_in_server`, which pick the mode `args` selects:
+// - ping-pong: the server sends a message and times until its echo arrives
+// - pipelined or bulk (`is_streaming`): the server streams messages under the `-p` window
+//   and the client acks them, see `pipeline.hh`
+// - fan-in (`is_fan_in`): every client streams stamped messages to the one server, see
+//   `fan_in.hh`
+// The endpoint's optional operations (batches, fused round trips, acks of its own) are
+// used when it has them.
+//
+// Outgoing messages come from a `PayloadPool` and carry their sequence number, which the
+// receiver checks (the server checks the echoes), see `stamps_payloads`.
+//
+// A variable size workload (`-W`) runs the ping-pong or pipelined loop with frames of the
+// sizes of a `SizeGenerator` through the endpoint's `FramedTransport` operations, one message
+// per call: no batches and no fused round trips, whose sizes are fixed up front.
+
+// Whether messages carry sequence stamps. Not in fan-in mode, whose messages start with their
+// own header, not for messages shorter than a stamp, not for streams sent in batches (a batch
+// is copies of one message) and not for endpoints which do not read what they receive.
+template <Transport T>
+bool stamps_payloads(const T &transport, const Args &args)
+{
+    if (is_fan_in(args) || args.message_size < sizeof(PayloadStamp))
+    {
+        return false;
+    }
+    if constexpr (BatchTransport<T>)
+    {
+        if (is_streaming(args) && !is_variable_size(args))
+        {
+            return false;
+        }
+    }
+    if constexpr (HasOpaquePayload<T>)
+    {
+        return transport.payload_readable();
+    }
+    return true;
+}
+
+// Pool of the outgoing messages, the endpoint's own buffer if it has one
+template <Transport T>
+PayloadPool make_payload_pool(T &transport, const Args &args)
+{
+    if constexpr (HasSendBuffer<T>)
+    {
+        return PayloadPool(transport.send_buffer(), args.message_size, stamps_payloads(transport, args));
+    }
+    else
+    {
+        return PayloadPool(args.message_size, stamps_payloads(transport, args));
+    }
+}
+
+// Acks the messages received so far, `message` holds at least `args.message_size` bytes
+template <Transport T>
+void send_ack(T &transport, const char *message)
+{
+    if constexpr (HasAck<T>)
+    {
+        (void)message;
+        transport.send_ack();
+    }
+    else
+    {
+        transport.send(message, ACK_SIZE);
+    }
+}
+
+template <Transport T>
+void recv_ack(T &transport)
+{
+    if constexpr (HasAck<T>)
+    {
+        transport.recv_ack();
+    }
+    else
+    {
+        transport.recv(ACK_SIZE);
+    }
+}
+
+// Sends the frame of `size` bytes at `message`
+template <FramedTransport T>
+void send_frame(T &transport, const char *message, size_t size)
+{
+    if constexpr (requires { transport.send_framed(message, size); })
+    {
+        transport.send_framed(message, size);
+    }
+    else
+    {
+        transport.send(message, size);
+    }
+}
+
+// `run_server` for a variable size workload, each message's size is recorded in `benchmarks`
+template <FramedTransport T>
+void run_framed_server(Benchmarks &benchmarks, const Args &args, T &transport)
+{
+    PayloadPool payloads = make_payload_pool(transport, args);
+    SizeGenerator sizes(args);
+    size_t max_size = args.message_size;
+    if (is_streaming(args))
+    {
+        run_pipelined_producer(
+            benchmarks, args,
+            [&]
+            {
+                size_t size = sizes.next();
+                benchmarks.record_message_size(size);
+                send_frame(transport, payloads.next_framed(size), size);
+            },
+            [&]
+            { recv_ack(transport); });
+        return;
+    }
+    StampChecker echoes(stamps_payloads(transport, args));
+    for (ull i = 0; i < args.iterations; i++)
+    {
+        benchmarks.start_iteration();
+        size_t size = sizes.next();
+        benchmarks.record_message_size(size);
+        send_frame(transport, payloads.next_framed(size), size);
+        echoes.check(transport.recv_framed(max_size));
+        benchmarks.end_iteration(1);
+    }
+}
+
+// `run_client_loop` for a variable size workload, echoes each frame at its own length
+template <FramedTransport T>
+void run_framed_client_loop(const Args &args, T &transport)
+{
+    PayloadPool payloads = make_payload_pool(transport, args);
+    char *message = payloads.next();
+    StampChecker stamps(stamps_payloads(transport, args));
+    size_t max_size = args.message_size;
+    if (is_streaming(args))
+    {
+        run_pipelined_consumer(
+            args,
+            [&]
+            { stamps.check(transport.recv_framed(max_size)); },
+            [&]
+            { send_ack(transport, message); });
+        return;
+    }
+    for (ull i = 0; i < args.iterations; i++)
+    {
+        const char *received = transport.recv_framed(max_size);
+        stamps.check(received);
+        send_frame(transport, received, frame_length(received, max_size));
+    }
+}
+
+// Exits for endpoints which cannot receive the frames of a variable size workload
+inline void unsupported_variable_size()
+{
+    std::cerr << "This transport does not support variable size workloads" << std::endl;
+    exit(EXIT_FAILURE);
+}
+
+// The server's side of a ping-pong, pipelined or bulk run, timed into `benchmarks`
+template <Transport T>
+void run_server(Benchmarks &benchmarks, const Args &args, T &transport)
+{
+    if (is_variable_size(args))
+    {
+        if constexpr (FramedTransport<T>)
+        {
+            run_framed_server(benchmarks, args, transport);
+        }
+        else
+        {
+            unsupported_variable_size();
+        }
+        return;
+    }
+    PayloadPool payloads = make_payload_pool(transport, args);
+    size_t size = args.message_size;
+    if (is_streaming(args))
+    {
+        if constexpr (BatchTransport<T>)
+        {
+            run_pipelined_batch_producer(
+                benchmarks, args,
+                [&](ull count)
+                { return static_cast<ull>(transport.send_batch(payloads.next(), size, count)); },
+                [&]
+                { recv_ack(transport); });
+        }
+        else
+        {
+            run_pipelined_producer(
+                benchmarks, args,
+                [&]
+                { transport.send(payloads.next(), size); },
+                [&]
+                { recv_ack(transport); });
+        }
+        return;
+    }
+    StampChecker echoes(stamps_payloads(transport, args));
+    for (ull i = 0; i < args.iterations; i++)
+    {
+        benchmarks.start_iteration();
+        const char *message = payloads.next();
+        if constexpr (RoundTripTransport<T>)
+        {
+            echoes.check(transport.send_then_recv(message, size));
+        }
+        else
+        {
+            transport.send(message, size);
+            echoes.check(transport.recv(size));
+        }
+        benchmarks.end_iteration(1);
+    }
+}
+
+// The loops of `run_client`
+template <Transport T>
+void run_client_loop(const Args &args, T &transport)
+{
+    if (is_variable_size(args))
+    {
+        if constexpr (FramedTransport<T>)
+        {
+            run_framed_client_loop(args, transport);
+        }
+        else
+        {
+            unsupported_variable_size();
+        }
+        return;
+    }
+    // The client only sends payloads of its own in fan-in mode, else this is the ack buffer
+    PayloadPool payloads = make_payload_pool(transport, args);
+    char *message = payloads.next();
+    StampChecker stamps(stamps_payloads(transport, args));
+    size_t size = args.message_size;
+    if (is_fan_in(args))
+    {
+        // The reply may overwrite the message in the endpoint's own buffer, the stamp is
+        // written again before every send
+        run_fan_in_client(
+            args, message,
+            [&]
+            { transport.send(message, size); },
+            [&]
+            {
+                if (args.window > 1)
+                {
+                    recv_ack(transport);
+                }
+                else
+                {
+                    transport.recv(size);
+                }
+            });
+        return;
+    }
+    if (is_streaming(args))
+    {
+        if constexpr (BatchTransport<T>)
+        {
+            run_pipelined_batch_consumer(
+                args,
+                [&](ull max)
+                { return static_cast<ull>(transport.recv_batch(size, max)); },
+                [&]
+                { send_ack(transport, message); });
+        }
+        else
+        {
+            run_pipelined_consumer(
+                args,
+                [&]
+                { stamps.check(transport.recv(size)); },
+                [&]
+                { send_ack(transport, message); });
+        }
+        return;
+    }
+    for (ull i = 0; i < args.iterations; i++)
+    {
+        if constexpr (RoundTripTransport<T>)
+        {
+            // Fused, the server checks the echo
+            transport.recv_then_echo(size);
+        }
+        else
+        {
+            const char *received = transport.recv(size);
+            stamps.check(received);
+            transport.send(received, size);
+        }
+    }
+}
+
+// The client's side: echoes or acks the server's messages, or in fan-in mode streams its own
+// stamped messages to the server. The client's CPU time, context switches and faults (and with
+// `-P` its counters) are reported after the loop, the server's are in its `Benchmarks` report.
+template <Transport T>
+void run_client(const Args &args, T &transport)
+{
+    PerfCounters perf_counters(args.perf_counters);
+    ResourceUsage usage_start = get_resource_usage();
+    perf_counters.start();
+    run_client_loop(args, transport);
+    perf_counters.stop();
+    report_resource_usage("Client ", usage_start, get_resource_usage(), args.iterations, args.iterations);
+    perf_counters.report("Client ", args.iterations);
+}
+
+// The server's side of a fan-in run: receives every client's messages, records them in
+// `server` and replies with an echo, or an ack in pipelined mode
+template <FanInTransport T>
+void run_fan_in_server(FanInServer &server, const Args &args, T &transport)
+{
+    size_t size = args.message_size;
+    server.start();
+    while (!server.done())
+    {
+        size_t source;
+        const char *message = transport.recv_any(size, source);
+        bool reply;
+        ull client = server.on_message(message, reply);
+        if (reply && args.window > 1)
+        {
+            if constexpr (requires { transport.reply_ack(source); })
+            {
+                transport.reply_ack(source);
+            }
+            else
+            {
+                transport.reply(source, message, ACK_SIZE);
+            }
+        }
+        else if (reply)
+        {
+            transport.reply(source, message, size);
+        }
+        if constexpr (requires { transport.drop(source); })
+        {
+            if (server.client_done(client))
+            {
+                transport.drop(source);
+            }
+        }
+    }
+}
@@ -0,0 +1,263 @@
+#include "fan_in.hh"
+#include "bench.hh"
+#include "results.hh"
+#include "timing.hh"
+
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+std::string fan_in_name(const std::string &name, const Args &args)
+{
+    std::string suffix;
+    if (args.fan_in > 1)
+    {
+        suffix += " (fan-in " + std::to_string(args.fan_in) + ")";
+    }
+    if (is_open_loop(args))
+    {
+        suffix += " (open-loop " + std::to_string(args.send_rate) + " msg/s)";
+    }
+    return name + suffix;
+}
+
+size_t fan_in_reply_size(const Args &args)
+{
+    return args.window > 1 ? ACK_SIZE : args.message_size;
+}
+
+void stamp_message(char *message, const Args &args, ull sent_ns)
+{
+    FanInHeader header = {args.client_id, sent_ns};
+    memcpy(message, &header, sizeof(header));
+}
+
+// How far ahead of a due time a waiting client stops sleeping and starts spinning, which
+// covers the timer slack and wake up latency of `clock_nanosleep`
+constexpr ull SCHEDULE_SPIN_NS = 50000;
+
+SendSchedule::SendSchedule(const Args &args) : rate(args.send_rate), start_ns(0)
+{
+}
+
+ull SendSchedule::wait_until_due(ull index)
+{
+    ull now_ns = get_time_ns();
+    if (rate == 0)
+    {
+        return now_ns;
+    }
+    if (index == 0)
+    {
+        start_ns = now_ns;
+    }
+    // Split so `index * NS_PER_SEC` cannot overflow, and due times do not drift by rounding
+    ull due_ns = start_ns + index / rate * NS_PER_SEC + index % rate * NS_PER_SEC / rate;
+    if (now_ns >= due_ns)
+    {
+        // Late, e.g. held up by a full window: sent now but still charged from its due time
+        return due_ns;
+    }
+    if (due_ns - now_ns > SCHEDULE_SPIN_NS)
+    {
+        ull wake_ns = due_ns - SCHEDULE_SPIN_NS;
+        struct timespec wake = {static_cast<time_t>(wake_ns / NS_PER_SEC), static_cast<long>(wake_ns % NS_PER_SEC)};
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake, nullptr) == EINTR)
+        {
+        }
+    }
+    while (get_time_ns() < due_ns)
+    {
+    }
+    return due_ns;
+}
+
+ull fan_in_sender(const char *message)
+{
+    FanInHeader header;
+    memcpy(&header, message, sizeof(header));
+    return header.client;
+}
+
+FanInServer::FanInServer(const std::string &name, const Args &args)
+    : name(name), message_size(args.message_size), clients(args.fan_in), iterations(args.iterations),
+      window(args.window), send_rate(args.send_rate), results_path(args.results_path), received(args.fan_in, 0),
+      latencies(args.fan_in), latency_sums_ns(args.fan_in, 0), last_ns(args.fan_in, 0),
+      perf_counters(args.perf_counters)
+{
+}
+
+FanInServer::~FanInServer()
+{
+    report();
+}
+
+void FanInServer::start()
+{
+    usage_start = get_resource_usage();
+    perf_counters.start();
+    start_ns = get_time_ns();
+}
+
+ull FanInServer::on_message(const char *message, bool &reply)
+{
+    ull now_ns = get_time_ns();
+    FanInHeader header;
+    memcpy(&header, message, sizeof(header));
+    if (header.client >= clients)
+    {
+        std::cerr << "Received a message from unknown client " << header.client << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    ull client = header.client;
+    // A message sent before `start` (while other clients were still joining) counts from `start`
+    ull sent_ns = std::max<ull>(header.sent_ns, start_ns);
+    ull latency_ns = now_ns > sent_ns ? now_ns - sent_ns : 0;
+    latencies[client].record(latency_ns);
+    all_latencies.record(latency_ns);
+    latency_sums_ns[client] += latency_ns;
+    ull count = ++received[client];
+    ++total_received;
+    last_ns[client] = now_ns;
+    end_ns = now_ns;
+    reply = window <= 1 || count % ack_batch_size(window) == 0 || count == iterations;
+    return client;
+}
+
+bool FanInServer::done() const
+{
+    return total_received == clients * iterations;
+}
+
+bool FanInServer::client_done(ull client) const
+{
+    return received[client] == iterations;
+}
+
+void FanInServer::report()
+{
+    perf_counters.stop();
+    ResourceUsage usage_end = get_resource_usage();
+    std::cout << "========================================" << std::endl;
+    std::cout << "Benchmark: " << name << " (" << message_size << " byte msgs)" << std::endl;
+    std::cout << "========================================" << std::endl;
+    std::cout << "Clients: " << clients << std::endl;
+    std::cout << "Total messages: " << total_received << std::endl;
+    ull duration_ns = end_ns > start_ns ? end_ns - start_ns : 0;
+    if (duration_ns == 0)
+    {
+        std::cout << "No timed messages" << std::endl;
+        return;
+    }
+    ull sum_ns = 0;
+    for (ull sum : latency_sums_ns)
+    {
+        sum_ns += sum;
+    }
+    BenchResult total = histogram_result(name, message_size, total_received, sum_ns, all_latencies, duration_ns);
+    total.cpu_ns_per_msg = (usage_end.user_ns + usage_end.system_ns - usage_start.user_ns - usage_start.system_ns) /
+                           std::max<ull>(total_received, 1);
+    std::cout << "Total duration (sec): " << duration_ns / NS_PER_SEC << std::endl;
+    std::cout << "Aggregate messages / sec: " << total.messages_per_sec << std::endl;
+    std::cout << "Aggregate bytes / sec: " << total.bytes_per_sec << std::endl;
+    if (send_rate > 0)
+    {
+        std::cout << "Offered messages / sec: " << send_rate * clients << std::endl;
+        std::cout << "One-way latency (ns), client due time to server receive:" << std::endl;
+    }
+    else
+    {
+        std::cout << "One-way latency (ns), client send to server receive:" << std::endl;
+    }
+    constexpr int width = 12;
+    std::cout << std::setw(width) << "client" << std::setw(width) << "msgs/s" << std::setw(width) << "p50"
+              << std::setw(width) << "p99" << std::setw(width) << "p99.9" << std::setw(width) << "max" << std::endl;
+    std::vector<BenchResult> rows;
+    for (ull client = 0; client < clients; client++)
+    {
+        ull client_duration_ns = std::max<ull>(last_ns[client] > start_ns ? last_ns[client] - start_ns : 0, 1);
+        rows.push_back(histogram_result(name + " client " + std::to_string(client), message_size, received[client],
+                                        latency_sums_ns[client], latencies[client], client_duration_ns));
+    }
+    rows.push_back(total);
+    for (ull i = 0; i < rows.size(); i++)
+    {
+        const BenchResult &row = rows[i];
+        std::cout << std::setw(width) << (i < clients ? std::to_string(i) : "all") << std::setw(width)
+                  << row.messages_per_sec << std::setw(width) << row.p50_ns << std::setw(width) << row.p99_ns
+                  << std::setw(width) << row.p99_9_ns << std::setw(width) << row.max_ns << std::endl;
+    }
+    report_resource_usage("", usage_start, usage_end, total_received, total_received);
+    perf_counters.report("", total_received);
+
+    if (!results_path.empty())
+    {
+        // The aggregate row is last, which is the row the launcher's sweeps read back
+        for (const BenchResult &row : rows)
+        {
+            if (!append_result(results_path, row))
+            {
+                std::cerr << "Failed to write results to " << results_path << std::endl;
+                break;
+            }
+        }
+    }
+}
+
+SharedFdFanIn::SharedFdFanIn(int request_fd, const std::vector<int> &reply_fds, size_t message_size)
+    : request_fd(request_fd), reply_fds(reply_fds), buffer(message_size)
+{
+}
+
+const char *SharedFdFanIn::recv_any(size_t size, size_t &source)
+{
+    // Each message was written atomically, so reads stay aligned to whole messages
+    read_full(request_fd, buffer.data(), size);
+    source = fan_in_sender(buffer.data());
+    return buffer.data();
+}
+
+void SharedFdFanIn::reply(size_t source, const char *message, size_t size)
+{
+    write_full(reply_fds[source], message, size);
+}
+
+FdPoller::FdPoller(const std::vector<int> &fds) : cursor(0)
+{
+    for (int fd : fds)
+    {
+        pfds.push_back({fd, POLLIN, 0});
+    }
+}
+
+size_t FdPoller::next_ready()
+{
+    while (true)
+    {
+        for (; cursor < pfds.size(); cursor++)
+        {
+            // A negative descriptor is ignored by `poll`
+            if (pfds[cursor].fd != -1 && pfds[cursor].revents != 0)
+            {
+                pfds[cursor].revents = 0;
+                return cursor++;
+            }
+        }
+        if (poll(pfds.data(), pfds.size(), -1) == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            report_and_exit("poll");
+        }
+        cursor = 0;
+    }
+}
+
+void FdPoller::remove(size_t index)
+{
+    pfds[index].fd = -1;
+    pfds[index].revents = 0;
+}
@@ -0,0 +1,229 @@
+#pragma once
+
+#include "args.hh"
+#include "bench.hh"
+#include "histogram.hh"
+#include "perf_counters.hh"
+#include "pipeline.hh"
+#include "transport.hh"
+#include "types.hh"
+#include "utils.hh"
+
+#include <cerrno>
+#include <cstdint>
+#include <poll.h>
+#include <string>
+#include <vector>
+
+// Fan-in mode, enabled with `-f <clients>` for `clients > 1`. The launcher starts one
+// server and `clients` clients (each told its index with `-j`), and every client sends
+// `args.iterations` messages to the single server. In ping-pong mode the server echoes each
+// message to its sender, with a window the server acks every `ack_batch_size(window)`
+// messages (and the final message) of each client, as the pipelined consumer does.
+//
+// Each message starts with a `FanInHeader`. The server identifies the sender by it (so
+// transports which merge all clients into one stream need no other demultiplexing) and
+// records the one-way latency from the client's send to the server's receive. Both stamps
+// are `CLOCK_MONOTONIC`, which is system wide, regardless of `-c`.
+//
+// Open-loop mode, enabled with `-r <rate>`, runs on the same path (with any number of clients,
+// one included). Each client sends on a fixed schedule of `rate` messages per second instead
+// of as soon as its window allows, and stamps each message with the time it was due rather
+// than the time it went out. A send held up by a stall, or by a full window, is still
+// charged from its due time, so the latency queued behind a stall is measured rather than
+// omitted, as a closed loop which only sends after the last reply would (coordinated omission).
+
+struct FanInHeader
+{
+    uint64_t client;
+    uint64_t sent_ns;
+};
+
+inline bool is_open_loop(const Args &args)
+{
+    return args.send_rate > 0;
+}
+
+inline bool is_fan_in(const Args &args)
+{
+    return args.fan_in > 1 || is_open_loop(args);
+}
+
+// Appends " (fan-in N)" to `name` with several clients and " (open-loop R msg/s)" in
+// open-loop mode
+std::string fan_in_name(const std::string &name, const Args &args);
+
+// Size of the server's reply, the full echo in ping-pong mode and an ack otherwise
+size_t fan_in_reply_size(const Args &args);
+
+// Writes the header of `args.client_id` with the send time `sent_ns` to the start of `message`
+void stamp_message(char *message, const Args &args, ull sent_ns);
+
+// Send times of a client. In open-loop mode message `n` is due `n / rate` seconds after the
+// first, otherwise every message is due as soon as it can be sent.
+class SendSchedule
+{
+    const ull rate;
+    ull start_ns;
+
+public:
+    explicit SendSchedule(const Args &args);
+
+    // Waits until message `index` is due and returns the time it was due, or the current time
+    // if it is late or the client is not open-loop. Sleeps until shortly before the due time
+    // and spins the rest, so sends are on time to within the cost of reading the clock.
+    ull wait_until_due(ull index);
+};
+
+// Sends `args.iterations` stamped messages of `message` with `send()`, keeping at most
+// `args.window` of them unanswered and waiting for the server's replies with `recv_reply()`
+template <typename SendFn, typename RecvReplyFn>
+void run_fan_in_client(const Args &args, char *message, SendFn send, RecvReplyFn recv_reply)
+{
+    // A window of 1 is ping-pong, each message is answered by its echo
+    ull batch = ack_batch_size(args.window);
+    ull sent = 0;
+    ull answered = 0;
+    SendSchedule schedule(args);
+    while (answered < args.iterations)
+    {
+        while (sent < args.iterations && sent - answered < args.window)
+        {
+            stamp_message(message, args, schedule.wait_until_due(sent));
+            send();
+            ++sent;
+        }
+        recv_reply();
+        answered += std::min(batch, args.iterations - answered);
+    }
+}
+
+// Server side of a fan-in run: tracks every client's progress and its one-way latency
+// distribution, and prints the aggregate and per-client report on destruction
+class FanInServer
+{
+    const std::string name;
+    const ull message_size;
+    const ull clients;
+    const ull iterations;
+    const ull window;
+    // Messages per second each client is offered at in open-loop mode, 0 otherwise
+    const ull send_rate;
+    const std::string results_path;
+    // Messages received per client
+    std::vector<ull> received;
+    std::vector<LatencyHistogram> latencies;
+    std::vector<ull> latency_sums_ns;
+    // Receive time of each client's latest message, a client's rate is over its own duration
+    std::vector<ull> last_ns;
+    LatencyHistogram all_latencies;
+    ull total_received = 0;
+    // Time from `start` to the last message
+    ull start_ns = 0;
+    ull end_ns = 0;
+    // `-P` counters of the server from `start` to the report
+    PerfCounters perf_counters;
+    // Resource usage of the server at `start`
+    ResourceUsage usage_start;
+
+public:
+    FanInServer(const std::string &name, const Args &args);
+    ~FanInServer();
+
+    FanInServer(const FanInServer &) = delete;
+    FanInServer &operator=(const FanInServer &) = delete;
+
+    // Starts the aggregate clock, call once all clients are ready
+    void start();
+
+    // Records `message` and returns the index of the client which sent it. `reply` is set if
+    // the server must now answer that client with `fan_in_reply_size` bytes. Exits if the
+    // header names an unknown client.
+    ull on_message(const char *message, bool &reply);
+
+    // Whether every client's messages have been received
+    bool done() const;
+
+    // Whether all of `client`'s messages have been received
+    bool client_done(ull client) const;
+
+    void report();
+};
+
+// Client index in the header of `message`. Not validated, a transport may address its reply
+// by it as `FanInServer::on_message` exits on unknown clients before any reply.
+ull fan_in_sender(const char *message);
+
+// Waits for any of a set of descriptors, one per client, to become readable. The server side
+// of fan-in transports with a descriptor per client.
+class FdPoller
+{
+    std::vector<struct pollfd> pfds;
+    // Next descriptor to check in the results of the last `poll`
+    size_t cursor;
+
+public:
+    explicit FdPoller(const std::vector<int> &fds);
+
+    // Index (in the constructor's `fds`) of a readable descriptor, only polls again once
+    // every descriptor readable in the last poll was returned
+    size_t next_ready();
+
+    // Stops polling descriptor `index`, as a client may close its end at any time after its
+    // last reply
+    void remove(size_t index);
+};
+
+// Fan-in server over one descriptor all clients write their messages to, and one per client
+// its replies go to. Messages stay whole only while each is written atomically, at most
+// `PIPE_BUF` bytes to a pipe or FIFO.
+class SharedFdFanIn
+{
+    int request_fd;
+    std::vector<int> reply_fds;
+    std::vector<char> buffer;
+
+public:
+    SharedFdFanIn(int request_fd, const std::vector<int> &reply_fds, size_t message_size);
+
+    const char *recv_any(size_t size, size_t &source);
+    void reply(size_t source, const char *message, size_t size);
+};
+
+// Fan-in server over one `PollingTransport` endpoint per client, each of which the client
+// has to itself. Sweeps the endpoints with `try_recv`, calling `idle()` after a sweep which
+// found nothing, and replies on the endpoint the message came from.
+template <PollingTransport T, typename IdleFn>
+class PolledFanIn
+{
+    std::vector<T> &endpoints;
+    IdleFn idle;
+    // Endpoint the next sweep starts at, so busy clients cannot starve the others
+    size_t next;
+
+public:
+    PolledFanIn(std::vector<T> &endpoints, IdleFn idle) : endpoints(endpoints), idle(idle), next(0) {}
+
+    const char *recv_any(size_t size, size_t &source)
+    {
+        while (true)
+        {
+            for (size_t n = 0; n < endpoints.size(); n++)
+            {
+                size_t i = next;
+                next = next + 1 == endpoints.size() ? 0 : next + 1;
+                if (const char *message = endpoints[i].try_recv(size))
+                {
+                    source = i;
+                    return message;
+                }
+            }
+            idle();
+        }
+    }
+
+    void reply(size_t source, const char *message, size_t size)
+    {
+        endpoints[source].send(message, size);
+    }
+};
@@ -0,0 +1,74 @@
+#include "histogram.hh"
+
+#include <algorithm>
+#include <cmath>
+
+ull LatencyHistogram::bucket_upper_bound(unsigned int index)
+{
+    if (index < (1u << HISTOGRAM_SUB_BUCKET_BITS))
+    {
+        return index;
+    }
+    // Inverse of `bucket_index`
+    unsigned int shift = index / HISTOGRAM_HALF_SUB_BUCKETS - 1;
+    ull mantissa = index - shift * HISTOGRAM_HALF_SUB_BUCKETS;
+    // `((mantissa + 1) << shift) - 1` without overflowing for the last bucket
+    return (mantissa << shift) + ((1ULL << shift) - 1);
+}
+
+void LatencyHistogram::merge(const LatencyHistogram &other)
+{
+    for (unsigned int i = 0; i < HISTOGRAM_NUM_BUCKETS; i++)
+    {
+        counts[i] += other.counts[i];
+    }
+    total_count += other.total_count;
+    min_value = std::min(min_value, other.min_value);
+    max_value = std::max(max_value, other.max_value);
+}
+
+ull LatencyHistogram::count() const
+{
+    return total_count;
+}
+
+ull LatencyHistogram::min() const
+{
+    return total_count == 0 ? 0 : min_value;
+}
+
+ull LatencyHistogram::max() const
+{
+    return max_value;
+}
+
+ull LatencyHistogram::percentile(double percentile) const
+{
+    if (total_count == 0)
+    {
+        return 0;
+    }
+
+    // Rank of the target value, at least 1 so p0 reports the minimum
+    ull target = static_cast<ull>(std::ceil(percentile / 100.0 * total_count));
+    if (target == 0)
+    {
+        target = 1;
+    }
+
+    ull seen = 0;
+    for (unsigned int i = 0; i < HISTOGRAM_NUM_BUCKETS; i++)
+    {
+        seen += counts[i];
+        if (seen >= target)
+        {
+            ull value = bucket_upper_bound(i);
+            if (value < min_value)
+            {
+                return min_value;
+            }
+            return value > max_value ? max_value : value;
+        }
+    }
+    return max_value;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "types.hh"
+
+#include <array>
+
+// Fixed memory log-linear histogram of latencies, in the style of HdrHistogram.
+// Values below 2^HISTOGRAM_SUB_BUCKET_BITS are recorded exactly. Larger values are
+// bucketed by their power of two, each power split into 2^(HISTOGRAM_SUB_BUCKET_BITS - 1)
+// linear sub-buckets, so the relative error of any reported value is below
+// 2^-(HISTOGRAM_SUB_BUCKET_BITS - 1) (< 1.6% for 7 bits) across the full `ull` range.
+constexpr unsigned int HISTOGRAM_SUB_BUCKET_BITS = 7;
+constexpr unsigned int HISTOGRAM_HALF_SUB_BUCKETS = 1u << (HISTOGRAM_SUB_BUCKET_BITS - 1);
+constexpr unsigned int HISTOGRAM_NUM_BUCKETS = (66 - HISTOGRAM_SUB_BUCKET_BITS) * HISTOGRAM_HALF_SUB_BUCKETS;
+
+class LatencyHistogram
+{
+private:
+    std::array<ull, HISTOGRAM_NUM_BUCKETS> counts{};
+    ull total_count = 0;
+    ull min_value = ~0ULL;
+    ull max_value = 0;
+
+    // Index of the bucket `value` falls in
+    static unsigned int bucket_index(ull value);
+    // Largest value which maps to the bucket at `index`
+    static ull bucket_upper_bound(unsigned int index);
+
+public:
+    // Constant time and never allocates
+    void record(ull value)
+    {
+        ++counts[bucket_index(value)];
+        ++total_count;
+        if (value < min_value)
+        {
+            min_value = value;
+        }
+        if (value > max_value)
+        {
+            max_value = value;
+        }
+    }
+
+    // Adds every value recorded in `other`
+    void merge(const LatencyHistogram &other);
+
+    ull count() const;
+    // Returns 0 if no values were recorded
+    ull min() const;
+    ull max() const;
+    // Returns the smallest bucket upper bound such that at least `percentile` percent
+    // (0-100) of recorded values are at or below it, clamped to the exact min and max
+    ull percentile(double percentile) const;
+};
+
+inline unsigned int LatencyHistogram::bucket_index(ull value)
+{
+    if (value < (1ULL << HISTOGRAM_SUB_BUCKET_BITS))
+    {
+        return static_cast<unsigned int>(value);
+    }
+    // Shift so the mantissa keeps `HISTOGRAM_SUB_BUCKET_BITS` significant bits, leaving
+    // it in [HISTOGRAM_HALF_SUB_BUCKETS, 2 * HISTOGRAM_HALF_SUB_BUCKETS)
+    unsigned int msb = 63 - __builtin_clzll(value);
+    unsigned int shift = msb - HISTOGRAM_SUB_BUCKET_BITS + 1;
+    return shift * HISTOGRAM_HALF_SUB_BUCKETS + static_cast<unsigned int>(value >> shift);
+}
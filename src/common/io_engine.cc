@@ -0,0 +1,449 @@
+#include "io_engine.hh"
+#include "utils.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+
+// Submission and completion queue entries, a chain is at most two ops
+constexpr unsigned IO_URING_ENTRIES = 8;
+// Milliseconds the SQPOLL thread keeps polling after the last submission before sleeping
+constexpr unsigned IO_URING_SQ_THREAD_IDLE_MS = 1000;
+// Completion queue polls with SQPOLL before blocking in `io_uring_enter`
+constexpr unsigned IO_URING_SPIN_LIMIT = 1 << 14;
+
+IoBackend parse_io_backend(const std::string &name)
+{
+    if (name == "syscall")
+    {
+        return IoBackend::SYSCALL;
+    }
+    if (name == "io_uring")
+    {
+        return IoBackend::IO_URING;
+    }
+    if (name == "io_uring_sqpoll")
+    {
+        return IoBackend::IO_URING_SQPOLL;
+    }
+    throw std::invalid_argument("Unknown IO engine: " + name + " (expected syscall, io_uring, or io_uring_sqpoll)");
+}
+
+const char *io_backend_name(IoBackend backend)
+{
+    switch (backend)
+    {
+    case IoBackend::SYSCALL:
+        return "syscall";
+    case IoBackend::IO_URING:
+        return "io_uring";
+    case IoBackend::IO_URING_SQPOLL:
+        return "io_uring_sqpoll";
+    }
+    return "unknown";
+}
+
+std::string io_engine_name(const std::string &name, const Args &args)
+{
+    if (args.io_engine == "syscall")
+    {
+        return name;
+    }
+    return name + " (" + args.io_engine + ")";
+}
+
+IoEngine::IoEngine(const Args &args)
+    : backend(parse_io_backend(args.io_engine)), ring_fd(-1), sq_ring(nullptr), sq_ring_size(0),
+      cq_ring(nullptr), cq_ring_size(0), sqes(nullptr), sqes_size(0), sq_head(nullptr), sq_tail(nullptr),
+      sq_mask(nullptr), sq_flags(nullptr), sq_array(nullptr), cq_head(nullptr), cq_tail(nullptr),
+      cq_mask(nullptr), cqes(nullptr)
+{
+    if (backend != IoBackend::SYSCALL)
+    {
+        setup_ring();
+    }
+}
+
+IoBackend IoEngine::get_backend() const
+{
+    return backend;
+}
+
+void IoEngine::read_full(int fd, void *buf, size_t size)
+{
+    if (backend == IoBackend::SYSCALL)
+    {
+        ::read_full(fd, buf, size);
+        return;
+    }
+    IoOp op = {false, fd, static_cast<char *>(buf), size};
+    run(&op, 1);
+}
+
+void IoEngine::write_full(int fd, const void *buf, size_t size)
+{
+    if (backend == IoBackend::SYSCALL)
+    {
+        ::write_full(fd, buf, size);
+        return;
+    }
+    IoOp op = {true, fd, const_cast<char *>(static_cast<const char *>(buf)), size};
+    run(&op, 1);
+}
+
+void IoEngine::write_then_read(int write_fd, const void *write_buf, size_t write_size, int read_fd, void *read_buf,
+                               size_t read_size)
+{
+    if (backend == IoBackend::SYSCALL)
+    {
+        ::write_full(write_fd, write_buf, write_size);
+        ::read_full(read_fd, read_buf, read_size);
+        return;
+    }
+    IoOp ops[2] = {
+        {true, write_fd, const_cast<char *>(static_cast<const char *>(write_buf)), write_size},
+        {false, read_fd, static_cast<char *>(read_buf), read_size},
+    };
+    run(ops, 2);
+}
+
+void IoEngine::read_then_write(int read_fd, void *read_buf, size_t read_size, int write_fd, const void *write_buf,
+                               size_t write_size)
+{
+    if (backend == IoBackend::SYSCALL)
+    {
+        ::read_full(read_fd, read_buf, read_size);
+        ::write_full(write_fd, write_buf, write_size);
+        return;
+    }
+    IoOp ops[2] = {
+        {false, read_fd, static_cast<char *>(read_buf), read_size},
+        {true, write_fd, const_cast<char *>(static_cast<const char *>(write_buf)), write_size},
+    };
+    run(ops, 2);
+}
+
+void IoEngine::run(IoOp *ops, size_t count)
+{
+    int results[2];
+    submit_linked(ops, count, results);
+    for (size_t i = 0; i < count; i++)
+    {
+        // A short transfer fails the chain, so the ops after it complete with -ECANCELED
+        // and are reissued here, in order, after the short op has been finished
+        int result = results[i];
+        if (result == -ECANCELED)
+        {
+            result = 0;
+        }
+        else if (result < 0)
+        {
+            errno = -result;
+            report_and_exit(ops[i].is_write ? "io_uring write" : "io_uring read");
+        }
+        else if (result == 0 && ops[i].size > 0 && !ops[i].is_write)
+        {
+            std::cerr << "io_uring read: unexpected EOF" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        while (static_cast<size_t>(result) < ops[i].size)
+        {
+            IoOp rest = {ops[i].is_write, ops[i].fd, ops[i].buf + result, ops[i].size - result};
+            int rest_result;
+            submit_linked(&rest, 1, &rest_result);
+            if (rest_result < 0)
+            {
+                errno = -rest_result;
+                report_and_exit(rest.is_write ? "io_uring write" : "io_uring read");
+            }
+            if (rest_result == 0 && !rest.is_write)
+            {
+                std::cerr << "io_uring read: unexpected EOF" << std::endl;
+                exit(EXIT_FAILURE);
+            }
+            result += rest_result;
+        }
+    }
+}
+
+#ifdef __linux__
+
+static int io_uring_setup(unsigned entries, struct io_uring_params *params)
+{
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+static int io_uring_enter(int ring_fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+    return static_cast<int>(syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, nullptr, 0));
+}
+
+static int io_uring_register(int ring_fd, unsigned opcode, const void *arg, unsigned nr_args)
+{
+    return static_cast<int>(syscall(__NR_io_uring_register, ring_fd, opcode, arg, nr_args));
+}
+
+// The ring indices are shared with the kernel, which reads and writes them concurrently
+static unsigned load_acquire(unsigned *index)
+{
+    return std::atomic_ref<unsigned>(*index).load(std::memory_order_acquire);
+}
+
+static void store_release(unsigned *index, unsigned value)
+{
+    std::atomic_ref<unsigned>(*index).store(value, std::memory_order_release);
+}
+
+void IoEngine::setup_ring()
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    if (backend == IoBackend::IO_URING_SQPOLL)
+    {
+        params.flags |= IORING_SETUP_SQPOLL;
+        params.sq_thread_idle = IO_URING_SQ_THREAD_IDLE_MS;
+    }
+    ring_fd = io_uring_setup(IO_URING_ENTRIES, &params);
+    if (ring_fd == -1)
+    {
+        report_and_exit("io_uring_setup");
+    }
+
+    sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    // Kernels with `IORING_FEAT_SINGLE_MMAP` map both rings with one mapping
+    bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap)
+    {
+        sq_ring_size = std::max(sq_ring_size, cq_ring_size);
+        cq_ring_size = sq_ring_size;
+    }
+    sq_ring = mmap(NULL, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+    if (sq_ring == MAP_FAILED)
+    {
+        report_and_exit("mmap io_uring SQ ring");
+    }
+    if (single_mmap)
+    {
+        cq_ring = sq_ring;
+    }
+    else
+    {
+        cq_ring = mmap(NULL, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd,
+                       IORING_OFF_CQ_RING);
+        if (cq_ring == MAP_FAILED)
+        {
+            report_and_exit("mmap io_uring CQ ring");
+        }
+    }
+    sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    void *sqes_ptr = mmap(NULL, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+    if (sqes_ptr == MAP_FAILED)
+    {
+        report_and_exit("mmap io_uring SQEs");
+    }
+    sqes = static_cast<struct io_uring_sqe *>(sqes_ptr);
+
+    char *sq = static_cast<char *>(sq_ring);
+    sq_head = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+    sq_tail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    sq_mask = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    sq_flags = reinterpret_cast<unsigned *>(sq + params.sq_off.flags);
+    sq_array = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+    char *cq = static_cast<char *>(cq_ring);
+    cq_head = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    cq_tail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    cq_mask = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<struct io_uring_cqe *>(cq + params.cq_off.cqes);
+}
+
+IoEngine::~IoEngine()
+{
+    if (sqes != nullptr)
+    {
+        munmap(sqes, sqes_size);
+    }
+    if (cq_ring != nullptr && cq_ring != sq_ring)
+    {
+        munmap(cq_ring, cq_ring_size);
+    }
+    if (sq_ring != nullptr)
+    {
+        munmap(sq_ring, sq_ring_size);
+    }
+    if (ring_fd != -1)
+    {
+        close(ring_fd);
+    }
+}
+
+void IoEngine::register_files(const std::vector<int> &fds)
+{
+    if (backend == IoBackend::SYSCALL)
+    {
+        return;
+    }
+    if (io_uring_register(ring_fd, IORING_REGISTER_FILES, fds.data(), fds.size()) == -1)
+    {
+        report_and_exit("io_uring_register files");
+    }
+    files = fds;
+}
+
+void IoEngine::register_buffers(const std::vector<std::pair<char *, size_t>> &bufs)
+{
+    if (backend == IoBackend::SYSCALL)
+    {
+        return;
+    }
+    std::vector<struct iovec> iovecs;
+    for (const auto &[base, size] : bufs)
+    {
+        iovecs.push_back({base, size});
+    }
+    if (io_uring_register(ring_fd, IORING_REGISTER_BUFFERS, iovecs.data(), iovecs.size()) == -1)
+    {
+        // Registered buffers are pinned and count against `RLIMIT_MEMLOCK`
+        perror("io_uring_register buffers");
+        std::cerr << "Continuing with unregistered buffers" << std::endl;
+        return;
+    }
+    buffers = bufs;
+}
+
+void IoEngine::submit_linked(const IoOp *ops, size_t count, int *results)
+{
+    unsigned tail = *sq_tail;
+    for (size_t i = 0; i < count; i++)
+    {
+        const IoOp &op = ops[i];
+        unsigned index = tail & *sq_mask;
+        struct io_uring_sqe *sqe = &sqes[index];
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = op.is_write ? IORING_OP_WRITE : IORING_OP_READ;
+        sqe->fd = op.fd;
+        sqe->addr = reinterpret_cast<unsigned long>(op.buf);
+        sqe->len = static_cast<unsigned>(op.size);
+        // Pipes, FIFOs and sockets have no file position
+        sqe->off = 0;
+        sqe->user_data = i;
+        for (size_t f = 0; f < files.size(); f++)
+        {
+            if (files[f] == op.fd)
+            {
+                sqe->fd = static_cast<int>(f);
+                sqe->flags |= IOSQE_FIXED_FILE;
+                break;
+            }
+        }
+        for (size_t b = 0; b < buffers.size(); b++)
+        {
+            if (op.buf >= buffers[b].first && op.buf + op.size <= buffers[b].first + buffers[b].second)
+            {
+                sqe->opcode = op.is_write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+                sqe->buf_index = static_cast<unsigned short>(b);
+                break;
+            }
+        }
+        if (i + 1 < count)
+        {
+            sqe->flags |= IOSQE_IO_LINK;
+        }
+        sq_array[index] = index;
+        tail++;
+    }
+    store_release(sq_tail, tail);
+
+    if (backend == IoBackend::IO_URING_SQPOLL)
+    {
+        // The polling thread picks the entries up, it only needs a system call to wake it
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (load_acquire(sq_flags) & IORING_SQ_NEED_WAKEUP)
+        {
+            if (io_uring_enter(ring_fd, 0, 0, IORING_ENTER_SQ_WAKEUP) == -1)
+            {
+                report_and_exit("io_uring_enter wakeup");
+            }
+        }
+        for (unsigned spins = 0; spins < IO_URING_SPIN_LIMIT; spins++)
+        {
+            if (load_acquire(cq_tail) - *cq_head >= count)
+            {
+                break;
+            }
+        }
+    }
+
+    size_t reaped = 0;
+    // Entries left for `io_uring_enter` to submit, the kernel may take fewer than asked
+    size_t unsubmitted = backend == IoBackend::IO_URING_SQPOLL ? 0 : count;
+    while (reaped < count)
+    {
+        unsigned head = *cq_head;
+        unsigned available = load_acquire(cq_tail);
+        while (head != available && reaped < count)
+        {
+            struct io_uring_cqe *cqe = &cqes[head & *cq_mask];
+            results[cqe->user_data] = cqe->res;
+            head++;
+            reaped++;
+        }
+        store_release(cq_head, head);
+        if (reaped == count)
+        {
+            break;
+        }
+        // Submits (unless the SQ thread does) and waits for the remaining completions in one call.
+        // After a short submission the kernel returns without waiting, and the rest is
+        // submitted by the next call.
+        int ret = io_uring_enter(ring_fd, unsubmitted, count - reaped, IORING_ENTER_GETEVENTS);
+        if (ret == -1)
+        {
+            // EAGAIN and EBUSY mean no entry was taken for lack of resources or room in the
+            // completion queue, which the reaping above makes before retrying
+            if (errno != EINTR && errno != EAGAIN && errno != EBUSY)
+            {
+                report_and_exit("io_uring_enter");
+            }
+            continue;
+        }
+        unsubmitted -= std::min<size_t>(ret, unsubmitted);
+    }
+}
+
+#else
+
+void IoEngine::setup_ring()
+{
+    std::cerr << "io_uring is only supported on Linux" << std::endl;
+    exit(EXIT_FAILURE);
+}
+
+IoEngine::~IoEngine()
+{
+}
+
+void IoEngine::register_files(const std::vector<int> &)
+{
+}
+
+void IoEngine::register_buffers(const std::vector<std::pair<char *, size_t>> &)
+{
+}
+
+void IoEngine::submit_linked(const IoOp *, size_t, int *)
+{
+}
+
+#endif
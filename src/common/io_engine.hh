@@ -0,0 +1,159 @@
+#pragma once
+
+#include "args.hh"
+#include "payload.hh"
+
+#include <string>
+#include <vector>
+
+// How the kernel mediated transports (pipe, named_pipe, unix_socket) issue their reads and writes
+enum class IoBackend
+{
+    // One blocking `read`/`write` system call per operation
+    SYSCALL,
+    // io_uring with fixed files and registered buffers. A ping-pong round trip is one linked
+    // write and read submitted and reaped with a single `io_uring_enter`.
+    IO_URING,
+    // As IO_URING, but a kernel thread polls the submission queue and completions are polled
+    // before falling back to `io_uring_enter`
+    IO_URING_SQPOLL,
+};
+
+// Parses the `-e` option, throws `std::invalid_argument` for unknown names
+IoBackend parse_io_backend(const std::string &name);
+
+const char *io_backend_name(IoBackend backend);
+
+// Appends " (<backend>)" to `name` for the io_uring backends, so the report is distinguishable
+std::string io_engine_name(const std::string &name, const Args &args);
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+// Issues the blocking reads and writes of one process with the backend selected in `Args`.
+// Every operation transfers exactly the requested size, retrying short transfers, and exits
+// on errors or EOF, as `read_full`/`write_full`.
+class IoEngine
+{
+    // One read or write of a linked submission
+    struct IoOp
+    {
+        bool is_write;
+        int fd;
+        char *buf;
+        size_t size;
+    };
+
+    IoBackend backend;
+    int ring_fd;
+    void *sq_ring;
+    size_t sq_ring_size;
+    void *cq_ring;
+    size_t cq_ring_size;
+    io_uring_sqe *sqes;
+    size_t sqes_size;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_flags;
+    unsigned *sq_array;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    io_uring_cqe *cqes;
+    // Registered descriptors and buffers, the index is the fixed file or buffer index
+    std::vector<int> files;
+    std::vector<std::pair<char *, size_t>> buffers;
+
+    void setup_ring();
+    // Submits `ops` as one linked chain and waits for all of their completions, storing the
+    // number of bytes transferred (or the negated errno) of each op in `results`
+    void submit_linked(const IoOp *ops, size_t count, int *results);
+    // Runs `ops` in order, finishing short or cancelled ops of the chain
+    void run(IoOp *ops, size_t count);
+
+public:
+    explicit IoEngine(const Args &args);
+    ~IoEngine();
+
+    IoEngine(const IoEngine &) = delete;
+    IoEngine &operator=(const IoEngine &) = delete;
+
+    IoBackend get_backend() const;
+
+    // Registers the descriptors used for IO as fixed files. Only call once, descriptors
+    // which are not registered still work through the regular path.
+    void register_files(const std::vector<int> &fds);
+    // Registers the buffers used for IO, operations within a registered buffer use the
+    // `_FIXED` opcodes. Only call once. Registration can fail on `RLIMIT_MEMLOCK`, in which
+    // case a warning is printed and the buffers are used unregistered.
+    void register_buffers(const std::vector<std::pair<char *, size_t>> &bufs);
+
+    void read_full(int fd, void *buf, size_t size);
+    void write_full(int fd, const void *buf, size_t size);
+    // A write followed by a read, linked in one submission with io_uring
+    void write_then_read(int write_fd, const void *write_buf, size_t write_size, int read_fd, void *read_buf,
+                         size_t read_size);
+    // A read followed by a write, linked in one submission with io_uring
+    void read_then_write(int read_fd, void *read_buf, size_t read_size, int write_fd, const void *write_buf,
+                         size_t write_size);
+};
+
+// One side of a pair of byte streams (a pipe, FIFO or stream socket in each direction, or
+// one socket for both), as a `Transport` which issues its reads and writes through `engine`.
+// Messages are received into `recv_buf` and composed in `send_buf`, which may be the same
+// buffer and are best registered with the engine.
+class StreamTransport
+{
+    IoEngine &engine;
+    int send_fd;
+    int recv_fd;
+    char *send_buf;
+    char *recv_buf;
+
+public:
+    StreamTransport(IoEngine &engine, int send_fd, int recv_fd, char *send_buf, char *recv_buf)
+        : engine(engine), send_fd(send_fd), recv_fd(recv_fd), send_buf(send_buf), recv_buf(recv_buf)
+    {
+    }
+
+    char *send_buffer()
+    {
+        return send_buf;
+    }
+
+    void send(const char *message, size_t size)
+    {
+        engine.write_full(send_fd, message, size);
+    }
+
+    const char *recv(size_t size)
+    {
+        engine.read_full(recv_fd, recv_buf, size);
+        return recv_buf;
+    }
+
+    // The header says how much of the frame is still to come
+    const char *recv_framed(size_t max_size)
+    {
+        engine.read_full(recv_fd, recv_buf, FRAME_HEADER_SIZE);
+        size_t length = frame_length(recv_buf, max_size);
+        if (length > FRAME_HEADER_SIZE)
+        {
+            engine.read_full(recv_fd, recv_buf + FRAME_HEADER_SIZE, length - FRAME_HEADER_SIZE);
+        }
+        return recv_buf;
+    }
+
+    // A linked write and read with io_uring
+    const char *send_then_recv(const char *message, size_t size)
+    {
+        engine.write_then_read(send_fd, message, size, recv_fd, recv_buf, size);
+        return recv_buf;
+    }
+
+    void recv_then_echo(size_t size)
+    {
+        engine.read_then_write(recv_fd, recv_buf, size, send_fd, recv_buf, size);
+    }
+};
@@ -1,32 +1,137 @@
 #include "args.hh"
 #include "utils.hh"
-#include "signals.hh"
+#include "barrier.hh"
+#include "affinity.hh"
+#include "results.hh"
 
 #include <iostream>
+#include <iomanip>
+#include <algorithm>
 #include <sys/wait.h>
 #include <unistd.h>
-#include <thread>
 #include <format>
 #include <signal.h>
+#include <string>
+#include <vector>
 
-int main(int argc, char *argv[])
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
+
+// Replaces the current process with `binary`, forwarding the benchmark options in `args`.
+// Only returns if `execv` fails.
+void exec_benchmark(const std::string &binary, const char *argv0, const Args &args)
 {
-    LauncherArgs args = parse_launcher_args(argc, argv);
+    std::vector<std::string> options = format_args(args);
+    std::vector<char *> argv;
+    argv.push_back(const_cast<char *>(argv0));
+    for (std::string &option : options)
+    {
+        argv.push_back(option.data());
+    }
+    argv.push_back(nullptr);
+    execv(binary.c_str(), argv.data());
+}
+
+// Called in a forked server or client before it execs: asks for SIGTERM once the launcher
+// (`launcher_pid`) exits (Linux only, the request survives `execv`). The barrier cannot tell a
+// peer exited, so a launcher which failed or was killed must not leave its children waiting
+// on the barrier or on the transport forever.
+void exit_with_launcher(pid_t launcher_pid)
+{
+#ifdef __linux__
+    if (prctl(PR_SET_PDEATHSIG, SIGTERM) == -1)
+    {
+        report_and_exit("prctl PR_SET_PDEATHSIG");
+    }
+    // The launcher may have exited before the request was made
+    if (getppid() != launcher_pid)
+    {
+        exit(EXIT_FAILURE);
+    }
+#else
+    (void)launcher_pid;
+#endif
+}
+
+// The unnamed pipe benchmark forks its own client, so it is run as a single process.
+// The client inherits the server's affinity, `client_cpu` only has to match it.
+int run_pipe_benchmark(const LauncherArgs &args, int server_cpu, int client_cpu)
+{
+    if (client_cpu != -1 && client_cpu != server_cpu)
+    {
+        std::cerr << "pipe runs its client in a forked child which shares the server's CPU, "
+                  << "ignoring client CPU " << client_cpu << std::endl;
+    }
 
-    // Convert integers to strings
-    std::string message_size_str = std::to_string(args.message_size);
-    std::string iterations_str = std::to_string(args.iterations);
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        report_and_exit("fork");
+    }
+    else if (pid == 0)
+    {
+        if (server_cpu != -1)
+        {
+            pin_to_cpu(server_cpu);
+        }
+        exec_benchmark("bin/pipe/pipe", "pipe", args);
+        std::cerr << "Failed to execute pipe process" << std::endl;
+        report_and_exit("execv");
+    }
+
+    int status;
+    if (waitpid(pid, &status, 0) == -1)
+    {
+        report_and_exit("waitpid pipe");
+    }
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0 ? 0 : 1;
+}
+
+// The threads benchmark runs its server and client as two threads of one process, which pin
+// themselves to `server_cpu` and `client_cpu`
+int run_threads_benchmark(const LauncherArgs &args, int server_cpu, int client_cpu)
+{
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        report_and_exit("fork");
+    }
+    else if (pid == 0)
+    {
+        Args thread_args = args;
+        thread_args.server_cpu = server_cpu;
+        thread_args.client_cpu = client_cpu;
+        exec_benchmark("bin/threads/threads", "threads", thread_args);
+        std::cerr << "Failed to execute threads process" << std::endl;
+        report_and_exit("execv");
+    }
 
-    // Convert strings to const char*
-    const char *message_size = message_size_str.c_str();
-    const char *iterations = iterations_str.c_str();
+    int status;
+    if (waitpid(pid, &status, 0) == -1)
+    {
+        report_and_exit("waitpid threads");
+    }
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0 ? 0 : 1;
+}
 
-    std::cout << "Message size and iterations: " << message_size << " " << iterations << std::endl;
+// Runs one client/server benchmark, pinning each side to its CPU if it is not -1. In
+// fan-in mode `args.fan_in` clients are started, each told its index, and all pinned to
+// `client_cpu`. Returns 0 if every process exited successfully.
+int run_benchmark(const LauncherArgs &args, int server_cpu, int client_cpu)
+{
+    if (args.benchmark_name == "pipe")
+    {
+        return run_pipe_benchmark(args, server_cpu, client_cpu);
+    }
+    if (args.benchmark_name == "threads")
+    {
+        return run_threads_benchmark(args, server_cpu, client_cpu);
+    }
 
-    // Registers signal handlers for the launcher which ignores all user signals (SIGUSR1, SIGUSR2)
-    // which would otherwise terminate the launcher process
-    SignalManager signal_manager = SignalManager(SignalManager::SignalTarget::LAUNCHER);
-    (void)signal_manager;
+    // Inherited by all processes, the clients wait on it instead of the launcher sleeping
+    ReadyBarrier barrier(ReadyBarrier::Role::LAUNCHER);
+    pid_t launcher_pid = getpid();
 
     // Fork to create the server process
     pid_t server_pid = fork();
@@ -38,46 +143,401 @@ int main(int argc, char *argv[])
     }
     else if (server_pid == 0)
     {
+        exit_with_launcher(launcher_pid);
+        if (server_cpu != -1)
+        {
+            pin_to_cpu(server_cpu);
+        }
         std::string server_binary = std::format("bin/{}/server", args.benchmark_name);
         // Child process for server
-        execl(server_binary.c_str(), "server", "-m", message_size, "-i", iterations, (char *)NULL);
-        // If execl returns, it means there was an error
+        exec_benchmark(server_binary, "server", args);
+        // If execv returns, it means there was an error
         std::cerr << "Failed to execute server process" << std::endl;
-        report_and_exit("execl");
+        report_and_exit("execv");
     }
 
-    // Sleep for a bit to allow the server to start
-    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    // Fork to create the client processes
+    std::vector<pid_t> pids = {server_pid};
+    for (unsigned long long client_id = 0; client_id < args.fan_in; client_id++)
+    {
+        pid_t client_pid = fork();
+        if (client_pid < 0)
+        {
+            std::cerr << "Failed to fork client process" << std::endl;
+            report_and_exit("fork");
+        }
+        else if (client_pid == 0)
+        {
+            exit_with_launcher(launcher_pid);
+            if (client_cpu != -1)
+            {
+                pin_to_cpu(client_cpu);
+            }
+            std::string client_binary = std::format("bin/{}/client", args.benchmark_name);
+            std::cout << "Client binary: " << client_binary << std::endl;
+            // Client process
+            Args client_args = args;
+            client_args.client_id = client_id;
+            exec_benchmark(client_binary, "client", client_args);
+            // If execv returns, it means there was an error
+            std::cerr << "Failed to execute client process" << std::endl;
+            report_and_exit("execv");
+        }
+        pids.push_back(client_pid);
+    }
 
-    // Fork to create the child process
-    pid_t client_pid = fork();
-    if (client_pid < 0)
+    // Wait for the clients and server to finish, in whichever order they exit
+    bool succeeded = true;
+    for (size_t remaining = pids.size(); remaining > 0; remaining--)
     {
-        std::cerr << "Failed to fork client process" << std::endl;
-        report_and_exit("fork");
+        int status;
+        pid_t pid = waitpid(-1, &status, 0);
+        if (pid == -1)
+        {
+            report_and_exit("waitpid");
+        }
+        std::erase(pids, pid);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        {
+            // The peers may be blocked on the barrier or on the transport forever, stop them. The
+            // barrier itself never sees a peer exit, every process holds its channels.
+            std::cerr << (pid == server_pid ? "Server" : "Client") << " process failed" << std::endl;
+            if (succeeded)
+            {
+                for (pid_t peer : pids)
+                {
+                    kill(peer, SIGTERM);
+                }
+            }
+            succeeded = false;
+        }
     }
-    else if (client_pid == 0)
+    return succeeded ? 0 : 1;
+}
+
+// Runs the benchmark for every ordered (server, client) pair of `cpus` and prints a matrix
+// of the median iteration latency. Pairs on the same CPU are included, they show the cost
+// of the two sides time slicing one core.
+int run_affinity_sweep(LauncherArgs args, const std::vector<int> &cpus)
+{
+    // Each run appends a row, the matrix reads back the last one. Without `-o` the rows
+    // go to a scratch file which is removed afterwards.
+    bool scratch_results = args.results_path.empty();
+    if (scratch_results)
     {
-        std::string client_binary = std::format("bin/{}/client", args.benchmark_name);
-        std::cout << "Client binary: " << client_binary << std::endl;
-        // Client process
-        execl(client_binary.c_str(), "client", "-m", message_size, "-i", iterations, (char *)NULL);
-        // If execl returns, it means there was an error
-        std::cerr << "Failed to execute client process" << std::endl;
-        report_and_exit("execl");
+        args.results_path = std::format("/tmp/ipc_bench_affinity_{}.csv", getpid());
     }
 
-    // Wait for the client and server to finish
-    int status;
-    if (waitpid(server_pid, &status, 0) == -1)
+    std::vector<std::vector<long long>> p50_ns(cpus.size(), std::vector<long long>(cpus.size(), -1));
+    for (size_t s = 0; s < cpus.size(); s++)
     {
-        report_and_exit("waitpid server");
+        for (size_t c = 0; c < cpus.size(); c++)
+        {
+            std::cout << "Affinity sweep: server CPU " << cpus[s] << ", client CPU " << cpus[c] << std::endl;
+            BenchResult result;
+            if (run_benchmark(args, cpus[s], cpus[c]) == 0 && read_last_result(args.results_path, result))
+            {
+                p50_ns[s][c] = result.p50_ns;
+            }
+        }
     }
 
-    if (waitpid(client_pid, &status, 0) == -1)
+    if (scratch_results)
     {
-        report_and_exit("waitpid client");
+        unlink(args.results_path.c_str());
     }
 
+    std::cout << "========================================" << std::endl;
+    std::cout << "Affinity sweep: " << args.benchmark_name << " (" << args.message_size << " byte msgs)" << std::endl;
+    std::cout << "p50 latency (ns) / it, rows: server CPU, columns: client CPU, -: failed" << std::endl;
+    std::cout << "========================================" << std::endl;
+    constexpr int width = 10;
+    std::cout << std::setw(width) << "";
+    for (int cpu : cpus)
+    {
+        std::cout << std::setw(width) << cpu;
+    }
+    std::cout << std::endl;
+    for (size_t s = 0; s < cpus.size(); s++)
+    {
+        std::cout << std::setw(width) << cpus[s];
+        for (size_t c = 0; c < cpus.size(); c++)
+        {
+            if (p50_ns[s][c] < 0)
+            {
+                std::cout << std::setw(width) << "-";
+            }
+            else
+            {
+                std::cout << std::setw(width) << p50_ns[s][c];
+            }
+        }
+        std::cout << std::endl;
+    }
     return 0;
-}
\ No newline at end of file
+}
+
+// A load is sustained while the achieved rate is within this fraction of the offered rate
+constexpr double KNEE_SUSTAINED_FRACTION = 0.95;
+// and its p99 is within this factor of the p99 at the lightest load
+constexpr ull KNEE_P99_FACTOR = 4;
+
+// Whether the transport kept up with the `offered` load of `point`, given the `lightest` load's
+// result
+bool load_sustained(const std::pair<ull, BenchResult> &point, const BenchResult &lightest)
+{
+    const auto &[offered, result] = point;
+    return result.messages_per_sec >= offered * KNEE_SUSTAINED_FRACTION &&
+           result.p99_ns <= lightest.p99_ns * KNEE_P99_FACTOR;
+}
+
+// Runs every benchmark of `-N` open-loop at each offered load of `-L`, lightest first, and
+// prints each one's load curve: offered and achieved rate and the one-way latency from the
+// due time. The knee is the heaviest load the transport sustains before its p99 turns up,
+// see `KNEE_SUSTAINED_FRACTION` and `KNEE_P99_FACTOR`.
+int run_load_sweep(LauncherArgs args)
+{
+    // Each run appends a row which is read back, as in `run_affinity_sweep`
+    bool scratch_results = args.results_path.empty();
+    if (scratch_results)
+    {
+        args.results_path = std::format("/tmp/ipc_bench_load_{}.csv", getpid());
+    }
+
+    std::vector<unsigned long long> send_rates = args.sweep_send_rates;
+    std::sort(send_rates.begin(), send_rates.end());
+    for (const std::string &benchmark_name : args.sweep_benchmarks)
+    {
+        args.benchmark_name = benchmark_name;
+        // The row read back is the aggregate over all clients, so the offered load is as well
+        std::vector<std::pair<ull, BenchResult>> curve;
+        for (unsigned long long send_rate : send_rates)
+        {
+            std::cout << "Load sweep: " << benchmark_name << ", send_rate=" << send_rate << std::endl;
+            args.send_rate = send_rate;
+            BenchResult result;
+            if (run_benchmark(args, args.server_cpu, args.client_cpu) == 0 &&
+                read_last_result(args.results_path, result))
+            {
+                curve.emplace_back(send_rate * args.fan_in, result);
+            }
+        }
+
+        std::cout << "========================================" << std::endl;
+        std::cout << "Load sweep: " << benchmark_name << " (" << args.message_size << " byte msgs, " << args.fan_in
+                  << " clients)" << std::endl;
+        std::cout << "One-way latency (ns) from the due time, by offered load (msgs/s)" << std::endl;
+        std::cout << "========================================" << std::endl;
+        constexpr int width = 12;
+        std::cout << std::setw(width) << "offered" << std::setw(width) << "achieved" << std::setw(width) << "p50"
+                  << std::setw(width) << "p99" << std::setw(width) << "p99.9" << std::setw(width) << "max"
+                  << std::endl;
+        // The loads up to the first one which is not sustained, a heavier load which happens to
+        // be does not move the knee past it
+        size_t sustained = 0;
+        while (sustained < curve.size() && load_sustained(curve[sustained], curve.front().second))
+        {
+            ++sustained;
+        }
+        for (const auto &[offered, result] : curve)
+        {
+            std::cout << std::setw(width) << offered << std::setw(width) << result.messages_per_sec
+                      << std::setw(width) << result.p50_ns << std::setw(width) << result.p99_ns << std::setw(width)
+                      << result.p99_9_ns << std::setw(width) << result.max_ns << std::endl;
+        }
+        if (curve.empty())
+        {
+            std::cout << "Knee: every run failed" << std::endl;
+        }
+        else if (sustained == 0)
+        {
+            std::cout << "Knee: below the lightest load, " << curve.front().first << " msgs/s is not sustained"
+                      << std::endl;
+        }
+        else if (sustained == curve.size())
+        {
+            std::cout << "Knee: above the heaviest load, every load up to " << curve.back().first
+                      << " msgs/s is sustained" << std::endl;
+        }
+        else
+        {
+            std::cout << "Knee: " << curve[sustained - 1].first << " msgs/s (p99 " << curve[sustained - 1].second.p99_ns
+                      << " ns), " << curve[sustained].first << " msgs/s is not sustained" << std::endl;
+        }
+    }
+
+    if (scratch_results)
+    {
+        unlink(args.results_path.c_str());
+    }
+    return 0;
+}
+
+// Runs the benchmark in `args` `args.repetitions` times and summarizes the results
+MatrixCell run_sweep_cell(const LauncherArgs &args)
+{
+    MatrixCell cell;
+    cell.benchmark = args.benchmark_name;
+    // In bulk mode the chunk size is part of the report name and the cell is the payload size
+    cell.message_size = args.bulk_size > 0 ? args.bulk_size : args.message_size;
+    cell.iterations = args.iterations;
+    std::vector<BenchResult> results;
+    for (unsigned long long rep = 0; rep < args.repetitions; rep++)
+    {
+        std::cout << "Sweep: " << args.benchmark_name << ", message_size=" << args.message_size
+                  << ", iterations=" << args.iterations;
+        if (args.benchmark_name == "unix_socket")
+        {
+            std::cout << ", socket_type=" << args.socket_type << ", kernel_buffer_size=" << args.kernel_buffer_size;
+        }
+        else if (args.benchmark_name == "pipe")
+        {
+            std::cout << ", pipe_mode=" << args.pipe_mode << ", kernel_buffer_size=" << args.kernel_buffer_size;
+        }
+        else if (args.benchmark_name == "posix_mq")
+        {
+            std::cout << ", mq_wait=" << args.mq_wait;
+        }
+        else if (args.benchmark_name == "threads")
+        {
+            std::cout << ", thread_transport=" << args.thread_transport;
+        }
+        if (args.fan_in > 1)
+        {
+            std::cout << ", fan_in=" << args.fan_in;
+        }
+        if (args.send_rate > 0)
+        {
+            std::cout << ", send_rate=" << args.send_rate;
+        }
+        std::cout << ", repetition " << rep + 1 << "/" << args.repetitions << std::endl;
+        BenchResult result;
+        if (run_benchmark(args, args.server_cpu, args.client_cpu) == 0 &&
+            read_last_result(args.results_path, result))
+        {
+            results.push_back(result);
+        }
+        else
+        {
+            ++cell.failures;
+        }
+    }
+    cell.repetitions = results.size();
+    if (!results.empty())
+    {
+        cell.median = median_result(results);
+    }
+    return cell;
+}
+
+// Runs every combination of the sweep lists `repetitions` times and writes the per cell
+// medians to `args.matrix_path`
+int run_parameter_sweep(LauncherArgs args)
+{
+    // Each run appends a row which is read back, as in `run_affinity_sweep`
+    bool scratch_results = args.results_path.empty();
+    if (scratch_results)
+    {
+        args.results_path = std::format("/tmp/ipc_bench_sweep_{}.csv", getpid());
+    }
+
+    std::vector<MatrixCell> cells;
+    // The offered loads are the innermost dimension, so a transport's load curve is contiguous
+    std::vector<unsigned long long> send_rates =
+        args.sweep_send_rates.empty() ? std::vector<unsigned long long>{args.send_rate} : args.sweep_send_rates;
+    for (const std::string &benchmark_name : args.sweep_benchmarks)
+    {
+        // Transport specific options only multiply the cells of the transport they apply to:
+        // the socket types of unix_socket, the pipe modes of pipe and the wait modes of posix_mq,
+        // and the kernel buffer sizes of unix_socket and pipe. Other transports run once per cell.
+        bool is_socket = benchmark_name == "unix_socket";
+        bool is_pipe = benchmark_name == "pipe";
+        bool is_posix_mq = benchmark_name == "posix_mq";
+        std::vector<std::string> modes = is_socket     ? args.sweep_socket_types
+                                         : is_pipe     ? args.sweep_pipe_modes
+                                         : is_posix_mq ? args.sweep_mq_waits
+                                                       : std::vector<std::string>{""};
+        std::vector<size_t> kernel_buffer_sizes = is_socket || is_pipe
+                                                      ? args.sweep_kernel_buffer_sizes
+                                                      : std::vector<size_t>{args.sweep_kernel_buffer_sizes.front()};
+        for (size_t message_size : args.sweep_message_sizes)
+        {
+            for (unsigned long long iterations : args.sweep_iterations)
+            {
+                for (const std::string &mode : modes)
+                {
+                    for (size_t kernel_buffer_size : kernel_buffer_sizes)
+                    {
+                        for (unsigned long long fan_in : args.sweep_fan_ins)
+                        {
+                            for (unsigned long long send_rate : send_rates)
+                            {
+                                args.benchmark_name = benchmark_name;
+                                args.message_size = message_size;
+                                args.iterations = iterations;
+                                args.socket_type = is_socket ? mode : args.sweep_socket_types.front();
+                                args.pipe_mode = is_pipe ? mode : args.sweep_pipe_modes.front();
+                                args.mq_wait = is_posix_mq ? mode : args.sweep_mq_waits.front();
+                                args.kernel_buffer_size = kernel_buffer_size;
+                                args.fan_in = fan_in;
+                                args.send_rate = send_rate;
+                                cells.push_back(run_sweep_cell(args));
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    if (scratch_results)
+    {
+        unlink(args.results_path.c_str());
+    }
+
+    if (!write_matrix(args.matrix_path, cells))
+    {
+        std::cerr << "Failed to write sweep matrix to " << args.matrix_path << std::endl;
+        return 1;
+    }
+    std::cout << "Wrote sweep matrix of " << cells.size() << " cells to " << args.matrix_path << std::endl;
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    LauncherArgs args = parse_launcher_args(argc, argv);
+
+    std::cout << "Message size and iterations: " << args.message_size << " " << args.iterations << std::endl;
+
+    // Validate CPUs up front, a child failing to pin itself would leave its peer blocked
+    std::vector<int> allowed = available_cpus();
+    std::vector<int> requested = args.affinity_sweep.empty() ? std::vector<int>{} : parse_cpu_list(args.affinity_sweep);
+    requested.push_back(args.server_cpu);
+    requested.push_back(args.client_cpu);
+    for (int cpu : requested)
+    {
+        if (cpu != -1 && std::find(allowed.begin(), allowed.end(), cpu) == allowed.end())
+        {
+            std::cerr << "CPU " << cpu << " is not available to this process" << std::endl;
+            return 1;
+        }
+    }
+
+    if (!args.matrix_path.empty())
+    {
+        return run_parameter_sweep(args);
+    }
+
+    if (!args.affinity_sweep.empty())
+    {
+        return run_affinity_sweep(args, parse_cpu_list(args.affinity_sweep));
+    }
+
+    if (!args.sweep_send_rates.empty())
+    {
+        return run_load_sweep(args);
+    }
+
+    return run_benchmark(args, args.server_cpu, args.client_cpu);
+}
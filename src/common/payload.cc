@@ -0,0 +1,131 @@
+#include "payload.hh"
+#include "utils.hh"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+// Fills `size` bytes with printable letters which differ between slots, so a payload is not
+// one repeated byte
+static void fill_payload(char *payload, size_t size, size_t slot)
+{
+    for (size_t i = 0; i < size; i++)
+    {
+        payload[i] = static_cast<char>('a' + (slot + i) % 26);
+    }
+}
+
+PayloadPool::PayloadPool(size_t message_size, bool stamped)
+    : owned(true), stride((message_size + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE),
+      num_slots(std::clamp<size_t>(PAYLOAD_POOL_BYTES / std::max<size_t>(stride, 1), 1, PAYLOAD_POOL_SLOTS)),
+      stamped(stamped), sequence(0)
+{
+    // `aligned_alloc` needs a multiple of the alignment, which `stride` is
+    arena = static_cast<char *>(std::aligned_alloc(CACHE_LINE_SIZE, std::max<size_t>(stride, CACHE_LINE_SIZE) *
+                                                                        num_slots));
+    if (arena == nullptr)
+    {
+        report_and_exit("aligned_alloc");
+    }
+    for (size_t slot = 0; slot < num_slots; slot++)
+    {
+        fill_payload(arena + slot * stride, message_size, slot);
+    }
+}
+
+PayloadPool::PayloadPool(char *buffer, size_t message_size, bool stamped)
+    : arena(buffer), owned(false), stride(0), num_slots(1), stamped(stamped), sequence(0)
+{
+    fill_payload(buffer, message_size, 0);
+}
+
+PayloadPool::~PayloadPool()
+{
+    if (owned)
+    {
+        std::free(arena);
+    }
+}
+
+char *PayloadPool::next()
+{
+    char *payload = arena + (sequence % num_slots) * stride;
+    if (stamped)
+    {
+        PayloadStamp stamp = sequence;
+        memcpy(payload, &stamp, sizeof(stamp));
+    }
+    ++sequence;
+    return payload;
+}
+
+char *PayloadPool::next_framed(size_t size)
+{
+    char *payload = arena + (sequence % num_slots) * stride;
+    FrameHeader header = {sequence, size};
+    memcpy(payload, &header, sizeof(header));
+    ++sequence;
+    return payload;
+}
+
+size_t frame_length(const char *message, size_t max_size)
+{
+    FrameHeader header;
+    memcpy(&header, message, sizeof(header));
+    if (header.length < FRAME_HEADER_SIZE || header.length > max_size)
+    {
+        std::cerr << "Received a frame of " << header.length << " bytes, frames are " << FRAME_HEADER_SIZE
+                  << " to " << max_size << " bytes" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    return header.length;
+}
+
+void check_whole_frame(const char *message, size_t received, size_t max_size)
+{
+    if (received < FRAME_HEADER_SIZE || frame_length(message, max_size) != received)
+    {
+        std::cerr << "Received a " << received << " byte message which is not one whole frame" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
+void check_frame_length(size_t length, size_t size)
+{
+    if (length != size)
+    {
+        std::cerr << "Received a frame of " << length << " bytes, expected " << size << std::endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
+uint8_t touch_frame(const char *data, size_t length)
+{
+    uint8_t sum = 0;
+    for (size_t i = 0; i < length; i += CACHE_LINE_SIZE)
+    {
+        sum += static_cast<uint8_t>(data[i]);
+    }
+    return sum;
+}
+
+StampChecker::StampChecker(bool enabled) : enabled(enabled), expected(0)
+{
+}
+
+void StampChecker::check(const char *message)
+{
+    if (!enabled)
+    {
+        return;
+    }
+    PayloadStamp stamp;
+    memcpy(&stamp, message, sizeof(stamp));
+    if (stamp != expected)
+    {
+        std::cerr << "Message " << expected << " arrived out of sequence, stamped " << stamp << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    ++expected;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "types.hh"
+
+#include <cstdint>
+
+// Sequence number written to the first bytes of every stamped payload
+typedef uint64_t PayloadStamp;
+
+// Most slots in a `PayloadPool`, and the size its arena stays within once a slot is smaller
+constexpr size_t PAYLOAD_POOL_SLOTS = 16;
+constexpr size_t PAYLOAD_POOL_BYTES = 1 << 20;
+
+// Start of every message of a variable size workload (`-W`), which makes it a frame: the
+// receiver reads its length from the header, so messages of any size share one connection.
+// `sequence` is in the place of the stamp, so a frame is a stamped payload as well.
+struct FrameHeader
+{
+    PayloadStamp sequence;
+    // Bytes of the whole frame, the header included
+    uint64_t length;
+};
+constexpr size_t FRAME_HEADER_SIZE = sizeof(FrameHeader);
+
+// Length of the frame starting at `message`. Exits unless it is a valid length for frames of
+// at most `max_size` bytes.
+size_t frame_length(const char *message, size_t max_size);
+
+// For endpoints which receive a message whole: exits unless the `received` bytes at `message`
+// are exactly one frame of at most `max_size` bytes
+void check_whole_frame(const char *message, size_t received, size_t max_size);
+
+// For endpoints whose messages carry their length out of band, e.g. in a doorbell frame:
+// exits unless `length` is the expected `size`
+void check_frame_length(size_t length, size_t size);
+
+// Reads one byte per cache line of the `length` bytes at `data`, so an endpoint which hands
+// out messages in place (in memory another process wrote) pulls them into the receiver's
+// cache as a copying transport would. Returns the sum so it is not optimized away.
+uint8_t touch_frame(const char *data, size_t length);
+
+// The payloads one side sends: a fixed pool of pre-filled slots the messages cycle through,
+// each cache line aligned in one arena. The memory is fixed however many iterations run, and
+// the working set stays a few slots rather than growing with the run. If `stamped`, each
+// payload is stamped with its sequence number (counting from 0) as it is handed out, which the
+// receiver checks with a `StampChecker`.
+class PayloadPool
+{
+    char *arena;
+    // Whether `arena` is owned, rather than a buffer of the endpoint
+    bool owned;
+    size_t stride;
+    size_t num_slots;
+    bool stamped;
+    ull sequence;
+
+public:
+    // A pool of up to `PAYLOAD_POOL_SLOTS` slots of `message_size` bytes, fewer for large messages
+    PayloadPool(size_t message_size, bool stamped);
+    // A pool of the one buffer an endpoint composes its messages in
+    PayloadPool(char *buffer, size_t message_size, bool stamped);
+    ~PayloadPool();
+
+    PayloadPool(const PayloadPool &) = delete;
+    PayloadPool &operator=(const PayloadPool &) = delete;
+
+    // The payload of the next message, stamped if the pool is
+    char *next();
+    // The payload of the next message as a frame of `size` bytes, which must be at least
+    // `FRAME_HEADER_SIZE` and at most the pool's message size
+    char *next_framed(size_t size);
+};
+
+// Receiving side of stamped payloads, which expects the stamps in sequence
+class StampChecker
+{
+    bool enabled;
+    ull expected;
+
+public:
+    explicit StampChecker(bool enabled);
+
+    // Exits unless `message` carries the next sequence number. Only reads the stamp, not the
+    // whole payload.
+    void check(const char *message);
+};
@@ -0,0 +1,270 @@
+#include "perf_counters.hh"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+// Report label of each `PerfEvent`
+static const char *perf_event_label(PerfEvent event)
+{
+    switch (event)
+    {
+    case PerfEvent::CYCLES:
+        return "Cycles";
+    case PerfEvent::INSTRUCTIONS:
+        return "Instructions";
+    case PerfEvent::LLC_MISSES:
+        return "LLC misses";
+    case PerfEvent::BRANCH_MISSES:
+        return "Branch misses";
+    case PerfEvent::CONTEXT_SWITCHES:
+        return "Context switches";
+    case PerfEvent::PAGE_FAULTS:
+        return "Page faults";
+    case PerfEvent::CPU_MIGRATIONS:
+        return "CPU migrations";
+    }
+    return "";
+}
+
+#ifdef __linux__
+
+// Sets the `perf_event_attr` type and config of each `PerfEvent`
+static void perf_event_config(PerfEvent event, struct perf_event_attr &attr)
+{
+    __u32 &type = attr.type;
+    __u64 &config = attr.config;
+    switch (event)
+    {
+    case PerfEvent::CYCLES:
+        type = PERF_TYPE_HARDWARE;
+        config = PERF_COUNT_HW_CPU_CYCLES;
+        return;
+    case PerfEvent::INSTRUCTIONS:
+        type = PERF_TYPE_HARDWARE;
+        config = PERF_COUNT_HW_INSTRUCTIONS;
+        return;
+    case PerfEvent::LLC_MISSES:
+        // Read misses of the last level cache, demand misses of both loads and stores show up
+        // as reads since a store first reads the line
+        type = PERF_TYPE_HW_CACHE;
+        config = PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                 (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        return;
+    case PerfEvent::BRANCH_MISSES:
+        type = PERF_TYPE_HARDWARE;
+        config = PERF_COUNT_HW_BRANCH_MISSES;
+        return;
+    case PerfEvent::CONTEXT_SWITCHES:
+        type = PERF_TYPE_SOFTWARE;
+        config = PERF_COUNT_SW_CONTEXT_SWITCHES;
+        return;
+    case PerfEvent::PAGE_FAULTS:
+        type = PERF_TYPE_SOFTWARE;
+        config = PERF_COUNT_SW_PAGE_FAULTS;
+        return;
+    case PerfEvent::CPU_MIGRATIONS:
+        type = PERF_TYPE_SOFTWARE;
+        config = PERF_COUNT_SW_CPU_MIGRATIONS;
+        return;
+    }
+}
+
+// Opens a counter of `event` for the calling thread on any CPU, as a member of `group_fd`'s
+// group or as a new (disabled) leader for -1. Returns -1 with `errno` set on failure.
+static int open_perf_event(PerfEvent event, int group_fd, bool exclude_kernel)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    perf_event_config(event, attr);
+    // Members follow their leader, which starts disabled until `start`
+    attr.disabled = group_fd == -1;
+    attr.exclude_kernel = exclude_kernel;
+    attr.exclude_hv = exclude_kernel;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, PERF_FLAG_FD_CLOEXEC));
+}
+
+#endif
+
+PerfCounters::PerfCounters(bool enabled) : user_only(false), counts{}, counted{}, hardware_running(1.0)
+{
+    if (!enabled)
+    {
+        return;
+    }
+#ifdef __linux__
+    open_group(hardware,
+               {PerfEvent::CYCLES, PerfEvent::INSTRUCTIONS, PerfEvent::LLC_MISSES, PerfEvent::BRANCH_MISSES});
+    open_group(software, {PerfEvent::CONTEXT_SWITCHES, PerfEvent::PAGE_FAULTS, PerfEvent::CPU_MIGRATIONS});
+    if (!active())
+    {
+        std::cerr << "No perf counters available: " << strerror(errno) << std::endl;
+    }
+#else
+    std::cerr << "Perf counters are only available on Linux" << std::endl;
+#endif
+}
+
+PerfCounters::~PerfCounters()
+{
+    for (const Group *group : {&hardware, &software})
+    {
+        for (int fd : group->fds)
+        {
+            close(fd);
+        }
+    }
+}
+
+void PerfCounters::open_group(Group &group, const std::vector<PerfEvent> &events)
+{
+#ifdef __linux__
+    // Both groups count in the same modes, so the hardware group decides for the software one
+    bool exclude_kernel = user_only;
+    for (PerfEvent event : events)
+    {
+        int fd = open_perf_event(event, group.leader_fd, exclude_kernel);
+        if (fd == -1 && group.leader_fd == -1 && !exclude_kernel && (errno == EACCES || errno == EPERM))
+        {
+            exclude_kernel = true;
+            fd = open_perf_event(event, group.leader_fd, exclude_kernel);
+        }
+        if (fd == -1)
+        {
+            // Not provided here, the next counter may still lead the group
+            continue;
+        }
+        // Switches and migrations happen in the kernel, a user mode only count is always 0
+        if (exclude_kernel && (event == PerfEvent::CONTEXT_SWITCHES || event == PerfEvent::CPU_MIGRATIONS))
+        {
+            close(fd);
+            continue;
+        }
+        if (group.leader_fd == -1)
+        {
+            group.leader_fd = fd;
+        }
+        group.events.push_back(event);
+        group.fds.push_back(fd);
+    }
+    user_only = exclude_kernel;
+#else
+    (void)group;
+    (void)events;
+#endif
+}
+
+bool PerfCounters::active() const
+{
+    return hardware.leader_fd != -1 || software.leader_fd != -1;
+}
+
+void PerfCounters::start()
+{
+#ifdef __linux__
+    for (const Group *group : {&hardware, &software})
+    {
+        if (group->leader_fd != -1)
+        {
+            ioctl(group->leader_fd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+            ioctl(group->leader_fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        }
+    }
+#endif
+}
+
+void PerfCounters::stop()
+{
+#ifdef __linux__
+    for (const Group *group : {&hardware, &software})
+    {
+        if (group->leader_fd != -1)
+        {
+            ioctl(group->leader_fd, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+        }
+    }
+    double software_running;
+    read_group(hardware, hardware_running);
+    read_group(software, software_running);
+#endif
+}
+
+void PerfCounters::read_group(const Group &group, double &running)
+{
+    running = 1.0;
+    if (group.leader_fd == -1)
+    {
+        return;
+    }
+    // `PERF_FORMAT_GROUP` layout: number of counters, time enabled, time running, the values
+    std::vector<uint64_t> values(3 + group.events.size());
+    ssize_t bytes = read(group.leader_fd, values.data(), values.size() * sizeof(uint64_t));
+    if (bytes != static_cast<ssize_t>(values.size() * sizeof(uint64_t)) || values[0] != group.events.size())
+    {
+        std::cerr << "Failed to read perf counters" << std::endl;
+        return;
+    }
+    uint64_t enabled_ns = values[1];
+    uint64_t running_ns = values[2];
+    if (running_ns == 0)
+    {
+        // Never scheduled on the PMU, e.g. all counters taken by another perf session
+        return;
+    }
+    // A multiplexed group only counted part of the time, scale up to the whole interval
+    running = static_cast<double>(running_ns) / enabled_ns;
+    for (size_t i = 0; i < group.events.size(); i++)
+    {
+        size_t index = static_cast<size_t>(group.events[i]);
+        counts[index] = values[3 + i] / running;
+        counted[index] = true;
+    }
+}
+
+void PerfCounters::report(const std::string &prefix, ull messages) const
+{
+    if (!active() || messages == 0)
+    {
+        return;
+    }
+    if (user_only)
+    {
+        std::cout << prefix << "Perf counters: user mode only (perf_event_paranoid)" << std::endl;
+    }
+    if (hardware_running < 1.0)
+    {
+        std::cout << prefix << "Hardware counters multiplexed, running (%): " << std::fixed << std::setprecision(1)
+                  << hardware_running * 100 << std::defaultfloat << std::endl;
+    }
+    for (size_t i = 0; i < NUM_PERF_EVENTS; i++)
+    {
+        std::cout << prefix << perf_event_label(static_cast<PerfEvent>(i)) << " / msg: ";
+        if (counted[i])
+        {
+            std::cout << std::fixed << std::setprecision(3) << counts[i] / messages << std::defaultfloat;
+        }
+        else
+        {
+            std::cout << "unavailable";
+        }
+        std::cout << std::endl;
+    }
+    size_t cycles = static_cast<size_t>(PerfEvent::CYCLES);
+    size_t instructions = static_cast<size_t>(PerfEvent::INSTRUCTIONS);
+    if (counted[cycles] && counted[instructions] && counts[cycles] > 0)
+    {
+        std::cout << prefix << "Instructions / cycle: " << std::fixed << std::setprecision(2)
+                  << counts[instructions] / counts[cycles] << std::defaultfloat << std::endl;
+    }
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "types.hh"
+
+#include <array>
+#include <string>
+#include <vector>
+
+// Counters of a `PerfCounters` set, in report order
+enum class PerfEvent
+{
+    CYCLES,
+    INSTRUCTIONS,
+    LLC_MISSES,
+    BRANCH_MISSES,
+    CONTEXT_SWITCHES,
+    PAGE_FAULTS,
+    CPU_MIGRATIONS,
+};
+constexpr size_t NUM_PERF_EVENTS = 7;
+
+// Hardware and software counters of the calling thread over a timed loop, read with
+// `perf_event_open` (`-P`, Linux only). The hardware counters form one group and the software
+// counters another, so the counters of a group cover exactly the same instructions and ratios
+// such as instructions per cycle are exact. A counter the CPU, kernel or hypervisor does not
+// provide is reported as unavailable, the rest still count. When the kernel refuses to count
+// kernel mode (`perf_event_paranoid` >= 2 without `CAP_PERFMON`) only user mode is counted.
+class PerfCounters
+{
+    // One group leader and its members
+    struct Group
+    {
+        int leader_fd = -1;
+        // Counters in the order the group reads them, the leader first
+        std::vector<PerfEvent> events;
+        std::vector<int> fds;
+    };
+
+    Group hardware;
+    Group software;
+    // Whether kernel mode is excluded from the counts
+    bool user_only;
+    // Counts over the last `start`/`stop` interval, scaled up if the group was multiplexed
+    std::array<double, NUM_PERF_EVENTS> counts;
+    std::array<bool, NUM_PERF_EVENTS> counted;
+    // Fraction of the interval each group was scheduled on the PMU, below 1 when multiplexed
+    double hardware_running;
+
+    void open_group(Group &group, const std::vector<PerfEvent> &events);
+    void read_group(const Group &group, double &running);
+
+public:
+    // Opens the counters if `enabled`, a disabled set does nothing and reports nothing
+    explicit PerfCounters(bool enabled);
+    ~PerfCounters();
+
+    PerfCounters(const PerfCounters &) = delete;
+    PerfCounters &operator=(const PerfCounters &) = delete;
+
+    // Whether any counter is open
+    bool active() const;
+
+    // Resets and starts every counter
+    void start();
+
+    // Stops every counter and reads the counts of the interval since `start`
+    void stop();
+
+    // Prints each count divided by `messages`, each line prefixed with `prefix`
+    void report(const std::string &prefix, ull messages) const;
+};
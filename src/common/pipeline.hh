@@ -0,0 +1,228 @@
+#pragma once
+
+#include "args.hh"
+#include "bench.hh"
+#include "types.hh"
+
+#include <algorithm>
+
+// Pipelined (streaming) mode, enabled with `-p <window>` for `window > 1`.
+// The producer keeps up to `window` unacknowledged messages in flight and the consumer
+// acknowledges every `ack_batch_size(window)` messages (and the final message) with a
+// single ack. The ack schedule is deterministic, so an ack carries no payload and only
+// its arrival matters. A window of 1 would degenerate to ping-pong, which the
+// benchmarks keep as their own loop.
+//
+// Bulk mode, enabled with `-g <bulk size>`, reuses the same loops for large payloads.
+// Every iteration streams one payload as `bulk_chunks(args)` chunks of `message_size`
+// bytes under the same window, and the final chunk of each payload is always acked, so
+// an iteration measures the whole payload from its first chunk to its last ack. With a
+// window of 1 every chunk is acked, larger windows keep the transport busy.
+
+// Size of an ack on transports which allow messages of any size
+constexpr size_t ACK_SIZE = 1;
+
+// Number of messages the consumer receives before sending one ack. Half the window,
+// so the producer can refill one half while the other half is being consumed.
+inline ull ack_batch_size(ull window)
+{
+    return window / 2 > 0 ? window / 2 : 1;
+}
+
+// Whether the benchmarks run the producer and consumer loops below rather than ping-pong
+inline bool is_streaming(const Args &args)
+{
+    return args.window > 1 || args.bulk_size > 0;
+}
+
+// Number of chunks a bulk payload is split into
+inline ull bulk_chunks(const Args &args)
+{
+    return args.bulk_size / args.message_size;
+}
+
+// Appends " (window N)" to `name` in pipelined mode, or " (bulk chunks=N ...)" in bulk mode,
+// so the report is distinguishable from the ping-pong numbers. No commas, the name is a
+// field of the results CSV.
+inline std::string pipelined_name(const std::string &name, const Args &args)
+{
+    if (args.bulk_size > 0)
+    {
+        std::string suffix = " (bulk chunks=" + std::to_string(args.message_size);
+        if (args.window > 1)
+        {
+            suffix += " window=" + std::to_string(args.window);
+        }
+        return name + suffix + ")";
+    }
+    if (args.window <= 1)
+    {
+        return name;
+    }
+    return name + " (window " + std::to_string(args.window) + ")";
+}
+
+// Streams `args.iterations` payloads of `bulk_chunks(args)` chunks, `send_batch(count)` sends up
+// to `count` chunks and returns how many it sent. Each benchmark iteration is one payload.
+template <typename SendBatchFn, typename RecvAckFn>
+void run_bulk_producer(Benchmarks &benchmarks, const Args &args, SendBatchFn send_batch, RecvAckFn recv_ack)
+{
+    ull chunks = bulk_chunks(args);
+    ull batch = ack_batch_size(args.window);
+    for (ull i = 0; i < args.iterations; i++)
+    {
+        benchmarks.start_iteration();
+        ull sent = 0;
+        ull acked = 0;
+        while (acked < chunks)
+        {
+            while (sent < chunks && sent - acked < args.window)
+            {
+                sent += send_batch(std::min(chunks - sent, args.window - (sent - acked)));
+            }
+            recv_ack();
+            acked += std::min(batch, chunks - acked);
+        }
+        benchmarks.end_iteration(1);
+    }
+}
+
+// Receives the payloads of `run_bulk_producer`, `recv_batch(max)` as in
+// `run_pipelined_batch_consumer`. Acks every `ack_batch_size(args.window)` chunks and the
+// final chunk of each payload with `send_ack()`.
+template <typename RecvBatchFn, typename SendAckFn>
+void run_bulk_consumer(const Args &args, RecvBatchFn recv_batch, SendAckFn send_ack)
+{
+    ull chunks = bulk_chunks(args);
+    ull batch = ack_batch_size(args.window);
+    for (ull i = 0; i < args.iterations; i++)
+    {
+        ull received = 0;
+        while (received < chunks)
+        {
+            ull next_ack = std::min((received / batch + 1) * batch, chunks);
+            received += recv_batch(next_ack - received);
+            if (received == next_ack)
+            {
+                send_ack();
+            }
+        }
+    }
+}
+
+// Sends `args.iterations` messages with `send()` while keeping at most `args.window` of them
+// unacknowledged, waiting for acks with `recv_ack()`. Each benchmark iteration covers the
+// messages acknowledged by one ack. Runs `run_bulk_producer` in bulk mode.
+template <typename SendFn, typename RecvAckFn>
+void run_pipelined_producer(Benchmarks &benchmarks, const Args &args, SendFn send, RecvAckFn recv_ack)
+{
+    if (args.bulk_size > 0)
+    {
+        run_bulk_producer(
+            benchmarks, args,
+            [&](ull)
+            {
+                send();
+                return 1ull;
+            },
+            recv_ack);
+        return;
+    }
+    ull batch = ack_batch_size(args.window);
+    ull sent = 0;
+    ull acked = 0;
+    while (acked < args.iterations)
+    {
+        benchmarks.start_iteration();
+        while (sent < args.iterations && sent - acked < args.window)
+        {
+            send();
+            ++sent;
+        }
+        recv_ack();
+        // The final ack may cover a partial batch
+        ull newly_acked = std::min(batch, args.iterations - acked);
+        acked += newly_acked;
+        benchmarks.end_iteration(newly_acked);
+    }
+}
+
+// Receives `args.iterations` messages with `recv()`, acknowledging every
+// `ack_batch_size(args.window)` messages and the final message with `send_ack()`.
+template <typename RecvFn, typename SendAckFn>
+void run_pipelined_consumer(const Args &args, RecvFn recv, SendAckFn send_ack)
+{
+    if (args.bulk_size > 0)
+    {
+        run_bulk_consumer(
+            args,
+            [&](ull)
+            {
+                recv();
+                return 1ull;
+            },
+            send_ack);
+        return;
+    }
+    ull batch = ack_batch_size(args.window);
+    for (ull i = 1; i <= args.iterations; i++)
+    {
+        recv();
+        if (i % batch == 0 || i == args.iterations)
+        {
+            send_ack();
+        }
+    }
+}
+
+// Variant of `run_pipelined_producer` for transports which can send several messages in
+// one call. `send_batch(count)` sends up to `count` messages and returns how many it sent.
+template <typename SendBatchFn, typename RecvAckFn>
+void run_pipelined_batch_producer(Benchmarks &benchmarks, const Args &args, SendBatchFn send_batch,
+                                  RecvAckFn recv_ack)
+{
+    if (args.bulk_size > 0)
+    {
+        run_bulk_producer(benchmarks, args, send_batch, recv_ack);
+        return;
+    }
+    ull batch = ack_batch_size(args.window);
+    ull sent = 0;
+    ull acked = 0;
+    while (acked < args.iterations)
+    {
+        benchmarks.start_iteration();
+        while (sent < args.iterations && sent - acked < args.window)
+        {
+            sent += send_batch(std::min(args.iterations - sent, args.window - (sent - acked)));
+        }
+        recv_ack();
+        ull newly_acked = std::min(batch, args.iterations - acked);
+        acked += newly_acked;
+        benchmarks.end_iteration(newly_acked);
+    }
+}
+
+// Variant of `run_pipelined_consumer` for transports which can receive several messages
+// in one call. `recv_batch(max)` blocks for at least one message, receives at most `max`
+// and returns how many it received. It is never asked for messages past the next ack.
+template <typename RecvBatchFn, typename SendAckFn>
+void run_pipelined_batch_consumer(const Args &args, RecvBatchFn recv_batch, SendAckFn send_ack)
+{
+    if (args.bulk_size > 0)
+    {
+        run_bulk_consumer(args, recv_batch, send_ack);
+        return;
+    }
+    ull batch = ack_batch_size(args.window);
+    ull received = 0;
+    while (received < args.iterations)
+    {
+        ull next_ack = std::min((received / batch + 1) * batch, args.iterations);
+        received += recv_batch(next_ack - received);
+        if (received == next_ack)
+        {
+            send_ack();
+        }
+    }
+}
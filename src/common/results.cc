@@ -0,0 +1,185 @@
+#include "results.hh"
+#include "bench.hh"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <vector>
+
+const char *RESULT_CSV_HEADER = "benchmark,message_size,iterations,messages_per_sec,bytes_per_sec,"
+                                "mean_ns,min_ns,p50_ns,p90_ns,p99_ns,p99_9_ns,p99_99_ns,max_ns,cpu_ns_per_msg";
+
+BenchResult histogram_result(const std::string &name, ull message_size, ull messages, ull latency_sum_ns,
+                             const LatencyHistogram &latencies, ull duration_ns)
+{
+    BenchResult result;
+    result.name = name;
+    result.message_size = message_size;
+    result.iterations = messages;
+    result.messages_per_sec = static_cast<ull>(static_cast<long double>(messages) * NS_PER_SEC / duration_ns);
+    result.bytes_per_sec = static_cast<ull>(static_cast<long double>(messages) * message_size * NS_PER_SEC / duration_ns);
+    result.mean_ns = messages > 0 ? latency_sum_ns / messages : 0;
+    result.min_ns = latencies.min();
+    result.p50_ns = latencies.percentile(50.0);
+    result.p90_ns = latencies.percentile(90.0);
+    result.p99_ns = latencies.percentile(99.0);
+    result.p99_9_ns = latencies.percentile(99.9);
+    result.p99_99_ns = latencies.percentile(99.99);
+    result.max_ns = latencies.max();
+    return result;
+}
+
+bool append_result(const std::string &path, const BenchResult &result)
+{
+    std::ofstream out(path, std::ios::app);
+    if (!out)
+    {
+        return false;
+    }
+    // `tellp` is the end of the file when opened for appending
+    if (out.tellp() == 0)
+    {
+        out << RESULT_CSV_HEADER << "\n";
+    }
+    out << result.name << "," << result.message_size << "," << result.iterations << ","
+        << result.messages_per_sec << "," << result.bytes_per_sec << "," << result.mean_ns << ","
+        << result.min_ns << "," << result.p50_ns << "," << result.p90_ns << "," << result.p99_ns << ","
+        << result.p99_9_ns << "," << result.p99_99_ns << "," << result.max_ns << "," << result.cpu_ns_per_msg
+        << "\n";
+    return static_cast<bool>(out);
+}
+
+bool read_last_result(const std::string &path, BenchResult &result)
+{
+    std::ifstream in(path);
+    if (!in)
+    {
+        return false;
+    }
+
+    std::string line;
+    std::string last;
+    while (std::getline(in, line))
+    {
+        if (!line.empty() && line != RESULT_CSV_HEADER)
+        {
+            last = line;
+        }
+    }
+    if (last.empty())
+    {
+        return false;
+    }
+
+    std::vector<std::string> fields;
+    std::stringstream row(last);
+    std::string field;
+    while (std::getline(row, field, ','))
+    {
+        fields.push_back(field);
+    }
+    if (fields.size() != 14)
+    {
+        return false;
+    }
+
+    ull *values[] = {&result.message_size, &result.iterations, &result.messages_per_sec,
+                     &result.bytes_per_sec, &result.mean_ns, &result.min_ns, &result.p50_ns,
+                     &result.p90_ns, &result.p99_ns, &result.p99_9_ns, &result.p99_99_ns, &result.max_ns,
+                     &result.cpu_ns_per_msg};
+    result.name = fields[0];
+    for (size_t i = 0; i < std::size(values); i++)
+    {
+        *values[i] = std::strtoull(fields[i + 1].c_str(), nullptr, 10);
+    }
+    return true;
+}
+
+// Metrics of a result in CSV column order, shared by the readers and writers
+static std::vector<ull BenchResult::*> result_metrics()
+{
+    return {&BenchResult::messages_per_sec, &BenchResult::bytes_per_sec, &BenchResult::mean_ns,
+            &BenchResult::min_ns, &BenchResult::p50_ns, &BenchResult::p90_ns, &BenchResult::p99_ns,
+            &BenchResult::p99_9_ns, &BenchResult::p99_99_ns, &BenchResult::max_ns, &BenchResult::cpu_ns_per_msg};
+}
+
+static const char *METRIC_NAMES[] = {"messages_per_sec", "bytes_per_sec", "mean_ns", "min_ns", "p50_ns",
+                                     "p90_ns", "p99_ns", "p99_9_ns", "p99_99_ns", "max_ns", "cpu_ns_per_msg"};
+
+BenchResult median_result(const std::vector<BenchResult> &results)
+{
+    BenchResult median = results.front();
+    for (ull BenchResult::*metric : result_metrics())
+    {
+        std::vector<ull> values;
+        for (const BenchResult &result : results)
+        {
+            values.push_back(result.*metric);
+        }
+        // Upper median, so a single repetition reports its own values
+        std::nth_element(values.begin(), values.begin() + values.size() / 2, values.end());
+        median.*metric = values[values.size() / 2];
+    }
+    return median;
+}
+
+static void write_matrix_csv(std::ofstream &out, const std::vector<MatrixCell> &cells)
+{
+    out << "transport,benchmark,message_size,iterations,repetitions,failures";
+    for (const char *metric_name : METRIC_NAMES)
+    {
+        out << "," << metric_name;
+    }
+    out << "\n";
+    for (const MatrixCell &cell : cells)
+    {
+        out << cell.benchmark << "," << cell.median.name << "," << cell.message_size << "," << cell.iterations
+            << "," << cell.repetitions << "," << cell.failures;
+        for (ull BenchResult::*metric : result_metrics())
+        {
+            out << "," << cell.median.*metric;
+        }
+        out << "\n";
+    }
+}
+
+static void write_matrix_json(std::ofstream &out, const std::vector<MatrixCell> &cells)
+{
+    std::vector<ull BenchResult::*> metrics = result_metrics();
+    out << "[\n";
+    for (size_t i = 0; i < cells.size(); i++)
+    {
+        const MatrixCell &cell = cells[i];
+        // Names are benchmark identifiers like `shm (spin)`, which need no escaping
+        out << "  {\"transport\": \"" << cell.benchmark << "\", \"benchmark\": \"" << cell.median.name
+            << "\", \"message_size\": " << cell.message_size << ", \"iterations\": " << cell.iterations
+            << ", \"repetitions\": " << cell.repetitions << ", \"failures\": " << cell.failures;
+        for (size_t m = 0; m < metrics.size(); m++)
+        {
+            out << ", \"" << METRIC_NAMES[m] << "\": " << cell.median.*metrics[m];
+        }
+        out << "}" << (i + 1 < cells.size() ? "," : "") << "\n";
+    }
+    out << "]\n";
+}
+
+bool write_matrix(const std::string &path, const std::vector<MatrixCell> &cells)
+{
+    std::ofstream out(path, std::ios::trunc);
+    if (!out)
+    {
+        return false;
+    }
+    bool json = path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0;
+    if (json)
+    {
+        write_matrix_json(out, cells);
+    }
+    else
+    {
+        write_matrix_csv(out, cells);
+    }
+    return static_cast<bool>(out);
+}
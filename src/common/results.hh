@@ -0,0 +1,63 @@
+#pragma once
+
+#include "types.hh"
+#include "histogram.hh"
+
+#include <string>
+#include <vector>
+
+// Summary of one benchmark run, appended as a CSV row to the `-o <results file>` so
+// drivers (e.g. the launcher's sweeps) can collect results without parsing the report
+struct BenchResult
+{
+    std::string name;
+    ull message_size = 0;
+    ull iterations = 0;
+    ull messages_per_sec = 0;
+    ull bytes_per_sec = 0;
+    ull mean_ns = 0;
+    ull min_ns = 0;
+    ull p50_ns = 0;
+    ull p90_ns = 0;
+    ull p99_ns = 0;
+    ull p99_9_ns = 0;
+    ull p99_99_ns = 0;
+    ull max_ns = 0;
+    // CPU time of the timed side per message, 0 where not measured (fan-in per client rows)
+    ull cpu_ns_per_msg = 0;
+};
+
+// Summary of `messages` messages whose latencies are in `latencies` (summing to
+// `latency_sum_ns`), with the rates over `duration_ns`, which must not be 0
+BenchResult histogram_result(const std::string &name, ull message_size, ull messages, ull latency_sum_ns,
+                             const LatencyHistogram &latencies, ull duration_ns);
+
+// Column names of the CSV rows written by `append_result`
+extern const char *RESULT_CSV_HEADER;
+
+// Appends `result` as a CSV row to `path`, writing the header first if the file is empty.
+// Returns false on IO errors.
+bool append_result(const std::string &path, const BenchResult &result);
+
+// Parses the last row of the CSV at `path` into `result`. Returns false if the file
+// cannot be read or has no data rows.
+bool read_last_result(const std::string &path, BenchResult &result);
+
+// One cell of a parameter sweep: the median of each metric over the successful repetitions
+struct MatrixCell
+{
+    // Transport name as passed to the launcher, `median.name` is the name from the report
+    std::string benchmark;
+    ull message_size = 0;
+    ull iterations = 0;
+    ull repetitions = 0;
+    ull failures = 0;
+    BenchResult median;
+};
+
+// Per metric median of `results`, which must not be empty
+BenchResult median_result(const std::vector<BenchResult> &results);
+
+// Writes the sweep matrix to `path`, as JSON if it ends in `.json` and CSV otherwise.
+// Returns false on IO errors.
+bool write_matrix(const std::string &path, const std::vector<MatrixCell> &cells);
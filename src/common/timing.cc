@@ -0,0 +1,75 @@
+#include "timing.hh"
+
+#include <iostream>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+// Duration of the busy wait used to calibrate the TSC against `CLOCK_MONOTONIC`
+constexpr ull TSC_CALIBRATION_NS = 50 * 1000 * 1000;
+
+bool tsc_is_invariant()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned int eax, ebx, ecx, edx;
+    // Advanced power management leaf, EDX bit 8 is "Invariant TSC"
+    if (__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) == 0)
+    {
+        return false;
+    }
+    return (edx & (1u << 8)) != 0;
+#else
+    return false;
+#endif
+}
+
+BenchClock::BenchClock(const std::string &name) : source(ClockSource::MONOTONIC), tsc_ns_per_tick_fp(0)
+{
+    if (name != "tsc")
+    {
+        return;
+    }
+
+    if (!tsc_is_invariant())
+    {
+        std::cerr << "Invariant TSC not available, falling back to the monotonic clock" << std::endl;
+        return;
+    }
+
+    source = ClockSource::TSC;
+    calibrate_tsc();
+}
+
+void BenchClock::calibrate_tsc()
+{
+    // Measure the TSC rate over a fixed `CLOCK_MONOTONIC` interval
+    ull start_ns = get_time_ns();
+    ull start_tsc = end_stamp();
+    ull now_ns = start_ns;
+    while (now_ns - start_ns < TSC_CALIBRATION_NS)
+    {
+        now_ns = get_time_ns();
+    }
+    ull end_tsc = end_stamp();
+
+    ull elapsed_tsc = end_tsc - start_tsc;
+    if (elapsed_tsc == 0)
+    {
+        std::cerr << "TSC did not advance during calibration, falling back to the monotonic clock" << std::endl;
+        source = ClockSource::MONOTONIC;
+        return;
+    }
+    tsc_ns_per_tick_fp = static_cast<ull>((static_cast<unsigned __int128>(now_ns - start_ns) << 32) / elapsed_tsc);
+    std::cout << "Calibrated TSC: " << static_cast<double>(elapsed_tsc) / (now_ns - start_ns) << " ticks / ns" << std::endl;
+}
+
+ClockSource BenchClock::get_source() const
+{
+    return source;
+}
+
+const char *BenchClock::get_name() const
+{
+    return source == ClockSource::TSC ? "tsc" : "monotonic";
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "types.hh"
+
+#include <string>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+enum class ClockSource
+{
+    // `clock_gettime(CLOCK_MONOTONIC)`, portable but costs a vDSO call per timestamp
+    MONOTONIC,
+    // Serialized `rdtsc`/`rdtscp`, only available on x86 with an invariant TSC
+    TSC,
+};
+
+// Get the current time of the monotonically increasing clock in nanoseconds
+inline ull get_time_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Returns true if the CPU reports an invariant TSC, which ticks at a constant rate
+// across P-states and C-states and is synchronized across cores
+bool tsc_is_invariant();
+
+// Timestamp source for `Benchmarks`. Stamps are in clock specific ticks and must be
+// converted with `to_ns`. The TSC backend is calibrated against `CLOCK_MONOTONIC` on
+// construction and falls back to `MONOTONIC` if the TSC is not invariant.
+class BenchClock
+{
+private:
+    ClockSource source;
+    // Nanoseconds per TSC tick in 32.32 fixed point
+    ull tsc_ns_per_tick_fp;
+
+    void calibrate_tsc();
+
+public:
+    // `name` is `monotonic` or `tsc`
+    explicit BenchClock(const std::string &name);
+
+    ClockSource get_source() const;
+    const char *get_name() const;
+
+    // Timestamp taken before the timed region. Later instructions do not start
+    // until the timestamp is read.
+    ull start_stamp() const
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        if (source == ClockSource::TSC)
+        {
+            // The leading `lfence` keeps earlier instructions from drifting into the region
+            _mm_lfence();
+            ull tsc = __rdtsc();
+            _mm_lfence();
+            return tsc;
+        }
+#endif
+        return get_time_ns();
+    }
+
+    // Timestamp taken after the timed region. `rdtscp` waits for all earlier
+    // instructions and the trailing `lfence` keeps later ones from starting early.
+    ull end_stamp() const
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        if (source == ClockSource::TSC)
+        {
+            unsigned int aux;
+            ull tsc = __rdtscp(&aux);
+            _mm_lfence();
+            return tsc;
+        }
+#endif
+        return get_time_ns();
+    }
+
+    ull to_ns(ull ticks) const
+    {
+        if (source == ClockSource::TSC)
+        {
+            return static_cast<ull>((static_cast<unsigned __int128>(ticks) * tsc_ns_per_tick_fp) >> 32);
+        }
+        return ticks;
+    }
+};
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "types.hh"
+
+#include <concepts>
+#include <cstddef>
+
+// A transport endpoint is one side of a benchmark's connection, holding both directions.
+// The loops in `driver.hh` (ping-pong, pipelined, bulk and fan-in) are templates over the
+// endpoint type, so every mode runs on every transport with the endpoint's operations
+// resolved at compile time, and an endpoint only has to provide the operations below.
+//
+// Every message is `args.message_size` bytes, except the acks of pipelined and bulk mode and
+// the frames of a variable size workload (`FramedTransport`).
+
+// The operations every endpoint has
+template <typename T>
+concept Transport = requires(T &transport, const char *message, size_t size) {
+    // Sends the `size` bytes at `message` as one message. `message` may be the pointer
+    // returned by the last receive, which echoes it.
+    transport.send(message, size);
+    // Blocks for the next message of `size` bytes and returns where it can be read. The
+    // message stays valid until the next receive.
+    { transport.recv(size) } -> std::same_as<const char *>;
+};
+
+// An endpoint with a buffer of its own which messages are composed in before they are sent,
+// e.g. one registered with io_uring or behind a message header, so they are sent without
+// an extra copy. It holds at least `args.message_size` bytes.
+template <typename T>
+concept HasSendBuffer = requires(T &transport) {
+    { transport.send_buffer() } -> std::same_as<char *>;
+};
+
+// An endpoint which may pass messages on without their content, e.g. by splicing them onward
+// unread. `payload_readable` tells whether a received message holds what was sent and whether
+// a payload may be rewritten once sent, the driver only stamps and checks payloads if so.
+template <typename T>
+concept HasOpaquePayload = requires(const T &transport) {
+    { transport.payload_readable() } -> std::same_as<bool>;
+};
+
+// An endpoint which receives messages of any size up to `max_size`, for the variable size
+// workloads of `-W`. Every such message is a frame starting with its `FrameHeader` (see
+// `payload.hh`). `recv_framed` blocks for the next frame and returns it as `recv`, its length
+// is in the header.
+//
+// Optional: `send_framed(message, size)` for endpoints whose `send` always sends
+// `args.message_size` bytes, e.g. a full slot of a ring.
+template <typename T>
+concept FramedTransport = Transport<T> && requires(T &transport, size_t max_size) {
+    { transport.recv_framed(max_size) } -> std::same_as<const char *>;
+};
+
+// An endpoint whose acks are not plain messages of `ACK_SIZE` bytes
+template <typename T>
+concept HasAck = requires(T &transport) {
+    transport.send_ack();
+    transport.recv_ack();
+};
+
+// An endpoint which can check for a message without blocking. `try_recv` returns nullptr
+// if none is waiting, otherwise it receives as `recv`.
+template <typename T>
+concept PollingTransport = Transport<T> && requires(T &transport, size_t size) {
+    { transport.try_recv(size) } -> std::same_as<const char *>;
+};
+
+// An endpoint which sends and receives several messages in one call. `send_batch` sends up
+// to `count` copies of `message` and `recv_batch` blocks for at least one message and
+// receives at most `count`, both return how many messages they moved.
+template <typename T>
+concept BatchTransport = Transport<T> && requires(T &transport, const char *message, size_t size, size_t count) {
+    { transport.send_batch(message, size, count) } -> std::same_as<size_t>;
+    { transport.recv_batch(size, count) } -> std::same_as<size_t>;
+};
+
+// An endpoint which issues a round trip as one operation, e.g. linked io_uring submissions.
+// `send_then_recv` sends `message` and returns the answer as `recv`, `recv_then_echo`
+// receives a message and sends it back.
+template <typename T>
+concept RoundTripTransport = Transport<T> && requires(T &transport, const char *message, size_t size) {
+    { transport.send_then_recv(message, size) } -> std::same_as<const char *>;
+    transport.recv_then_echo(size);
+};
+
+// The server side of fan-in mode, which receives from every client. `recv_any` blocks for
+// the next message of any client and sets `source` to where it came from, `reply` answers
+// that source.
+//
+// Optional: `reply_ack(source)` if acks are not replies of `ACK_SIZE` bytes, and
+// `drop(source)` which is called once the client behind `source` sent all its messages,
+// after which `recv_any` must not wait for it.
+template <typename T>
+concept FanInTransport = requires(T &transport, const char *message, size_t size, size_t &source) {
+    { transport.recv_any(size, source) } -> std::same_as<const char *>;
+    transport.reply(source, message, size);
+};
@@ -1,5 +1,12 @@
 #pragma once
 
+#include <cstddef>
+
 // Type aliases
 typedef unsigned long long ull;
 constexpr ull MAX_MESSAGE_SIZE = 1 << 17; // ~128 KB
+// Cap for transports which handle partial reads and writes (or never copy the payload)
+constexpr ull MAX_LARGE_MESSAGE_SIZE = 1 << 26; // 64 MB
+// Assumed cache line size, used to pad the shm ring indices so the producer and consumer do
+// not false share a line, and to align payload slots
+constexpr size_t CACHE_LINE_SIZE = 64;
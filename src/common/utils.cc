@@ -1,7 +1,39 @@
 #include "utils.hh"
 
+#include <unistd.h>
+
 void report_and_exit(const char *msg)
 {
     perror(msg);
     exit(EXIT_FAILURE);
 }
+
+void read_full(int fd, void *buf, size_t size)
+{
+    char *dest = static_cast<char *>(buf);
+    while (size > 0)
+    {
+        ssize_t bytes_read = read(fd, dest, size);
+        if (bytes_read <= 0)
+        {
+            report_and_exit(bytes_read == 0 ? "read_full: unexpected EOF" : "read_full");
+        }
+        dest += bytes_read;
+        size -= bytes_read;
+    }
+}
+
+void write_full(int fd, const void *buf, size_t size)
+{
+    const char *src = static_cast<const char *>(buf);
+    while (size > 0)
+    {
+        ssize_t bytes_written = write(fd, src, size);
+        if (bytes_written < 0)
+        {
+            report_and_exit("write_full");
+        }
+        src += bytes_written;
+        size -= bytes_written;
+    }
+}
@@ -14,3 +14,9 @@
 #endif
 
 void report_and_exit(const char *msg);
+
+// Reads exactly `size` bytes from `fd`, retrying on short reads. Exits on error or EOF.
+void read_full(int fd, void *buf, size_t size);
+
+// Writes exactly `size` bytes to `fd`, retrying on short writes. Exits on error.
+void write_full(int fd, const void *buf, size_t size);
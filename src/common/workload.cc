@@ -0,0 +1,227 @@
+#include "workload.hh"
+#include "payload.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+
+// Seed of every drawn workload, so runs (and both sides of a sweep) see the same sizes
+constexpr uint64_t WORKLOAD_SEED = 42;
+
+// Exits with the usage of `-W`, `reason` says what is wrong with `spec`
+[[noreturn]] static void workload_error(const std::string &spec, const std::string &reason)
+{
+    std::cerr << "Invalid workload " << spec << ": " << reason << std::endl;
+    std::cerr << "Workloads: fixed, uniform:<min>:<max>, bimodal:<small>:<large>:<percent large>, "
+              << "zipf:<min>:<max>:<exponent> or trace:<path>" << std::endl;
+    exit(EXIT_FAILURE);
+}
+
+// Parses a message size of `spec`, which must fit a frame of at most `max_size` bytes
+static size_t parse_workload_size(const std::string &spec, const std::string &text, size_t max_size)
+{
+    size_t size = parse_byte_size(text.c_str());
+    if (size < FRAME_HEADER_SIZE || size > max_size)
+    {
+        workload_error(spec, "sizes must be between " + std::to_string(FRAME_HEADER_SIZE) +
+                                 " (the frame header) and the message size " + std::to_string(max_size));
+    }
+    return size;
+}
+
+// A size or a range `<min>-<max>` of sizes of `spec`
+static std::uniform_int_distribution<size_t> parse_size_range(const std::string &spec, const std::string &text,
+                                                              size_t max_size)
+{
+    size_t dash = text.find('-');
+    size_t min = parse_workload_size(spec, text.substr(0, dash), max_size);
+    size_t max = dash == std::string::npos ? min : parse_workload_size(spec, text.substr(dash + 1), max_size);
+    if (min > max)
+    {
+        workload_error(spec, "a range must not end below its start");
+    }
+    return std::uniform_int_distribution<size_t>(min, max);
+}
+
+// The fields of `spec` after its name, split at the colons
+static std::vector<std::string> workload_fields(const std::string &spec)
+{
+    std::vector<std::string> fields;
+    std::stringstream stream(spec);
+    std::string field;
+    std::getline(stream, field, ':');
+    while (std::getline(stream, field, ':'))
+    {
+        fields.push_back(field);
+    }
+    return fields;
+}
+
+// Reads the sizes of a trace file, one per line
+static std::vector<size_t> read_trace(const std::string &spec, const std::string &path, size_t max_size)
+{
+    std::ifstream trace(path);
+    if (!trace)
+    {
+        workload_error(spec, "cannot open " + path);
+    }
+    std::vector<size_t> sizes;
+    std::string line;
+    while (std::getline(trace, line))
+    {
+        if (!line.empty())
+        {
+            sizes.push_back(parse_workload_size(spec, line, max_size));
+        }
+    }
+    if (sizes.empty())
+    {
+        workload_error(spec, path + " lists no sizes");
+    }
+    return sizes;
+}
+
+// Draws `WORKLOAD_TABLE_SIZE` sizes of `args.workload`, or reads them from its trace. Exits if
+// the workload is malformed.
+static std::vector<size_t> draw_sizes(const Args &args)
+{
+    const std::string &spec = args.workload;
+    size_t max_size = args.message_size;
+    std::string kind = spec.substr(0, spec.find(':'));
+    if (kind == "fixed" && spec == kind)
+    {
+        return {max_size};
+    }
+    if (kind == "trace" && spec.size() > kind.size())
+    {
+        // The path may itself contain colons
+        return read_trace(spec, spec.substr(kind.size() + 1), max_size);
+    }
+
+    std::vector<std::string> fields = workload_fields(spec);
+    std::mt19937_64 random(WORKLOAD_SEED);
+    std::vector<size_t> sizes(WORKLOAD_TABLE_SIZE);
+    if (kind == "uniform" && fields.size() == 2)
+    {
+        size_t min = parse_workload_size(spec, fields[0], max_size);
+        size_t max = parse_workload_size(spec, fields[1], max_size);
+        if (min > max)
+        {
+            workload_error(spec, "max must not be below min");
+        }
+        std::uniform_int_distribution<size_t> range(min, max);
+        for (size_t &size : sizes)
+        {
+            size = range(random);
+        }
+        return sizes;
+    }
+    if (kind == "bimodal" && fields.size() == 3)
+    {
+        std::uniform_int_distribution<size_t> small = parse_size_range(spec, fields[0], max_size);
+        std::uniform_int_distribution<size_t> large = parse_size_range(spec, fields[1], max_size);
+        char *end;
+        double percent_large = std::strtod(fields[2].c_str(), &end);
+        if (*end != '\0' || percent_large < 0 || percent_large > 100)
+        {
+            workload_error(spec, "the share of large messages must be a percentage");
+        }
+        std::bernoulli_distribution is_large(percent_large / 100);
+        for (size_t &size : sizes)
+        {
+            size = is_large(random) ? large(random) : small(random);
+        }
+        return sizes;
+    }
+    if (kind == "zipf" && fields.size() == 3)
+    {
+        size_t min = parse_workload_size(spec, fields[0], max_size);
+        size_t max = parse_workload_size(spec, fields[1], max_size);
+        char *end;
+        double exponent = std::strtod(fields[2].c_str(), &end);
+        if (*end != '\0' || exponent < 0 || min > max)
+        {
+            workload_error(spec, "the exponent must not be negative, nor max below min");
+        }
+        std::vector<size_t> ranked;
+        std::vector<double> weights;
+        // Doubling stops past `max / 2`, so `size` cannot wrap around
+        for (size_t size = min; size <= max; size = size > max / 2 ? max + 1 : size * 2)
+        {
+            ranked.push_back(size);
+            weights.push_back(1.0 / std::pow(static_cast<double>(ranked.size()), exponent));
+        }
+        std::discrete_distribution<size_t> rank(weights.begin(), weights.end());
+        for (size_t &size : sizes)
+        {
+            size = ranked[rank(random)];
+        }
+        return sizes;
+    }
+    workload_error(spec, "unknown workload or wrong number of fields");
+}
+
+bool is_variable_size(const Args &args)
+{
+    return args.workload != "fixed";
+}
+
+void check_workload(const Args &args)
+{
+    draw_sizes(args);
+}
+
+std::string workload_name(const std::string &name, const Args &args)
+{
+    if (!is_variable_size(args))
+    {
+        return name;
+    }
+    // No comma, the name is a field of the results CSV and a trace path may contain one
+    std::string spec = args.workload;
+    std::replace(spec.begin(), spec.end(), ',', ';');
+    return name + " (workload " + spec + ")";
+}
+
+SizeGenerator::SizeGenerator(const Args &args) : sizes(draw_sizes(args)), next_index(0)
+{
+}
+
+size_t size_class(size_t size)
+{
+    size_t bound = SIZE_CLASS_BASE;
+    size_t index = 0;
+    while (size > bound && index + 1 < NUM_SIZE_CLASSES)
+    {
+        bound *= 4;
+        ++index;
+    }
+    return index;
+}
+
+// Formats a power of two byte count with a binary suffix, e.g. 4096 as `4K`
+static std::string format_class_bound(size_t bytes)
+{
+    if (bytes >= 1 << 20)
+    {
+        return std::to_string(bytes >> 20) + "M";
+    }
+    if (bytes >= 1 << 10)
+    {
+        return std::to_string(bytes >> 10) + "K";
+    }
+    return std::to_string(bytes);
+}
+
+std::string size_class_label(size_t size_class)
+{
+    if (size_class + 1 == NUM_SIZE_CLASSES)
+    {
+        return "> " + format_class_bound(SIZE_CLASS_BASE << (2 * (size_class - 1)));
+    }
+    return "<= " + format_class_bound(SIZE_CLASS_BASE << (2 * size_class));
+}
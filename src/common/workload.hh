@@ -0,0 +1,60 @@
+#pragma once
+
+#include "args.hh"
+#include "types.hh"
+
+#include <string>
+#include <vector>
+
+// Message sizes the server draws from, selected with `-W <workload>`:
+// - `fixed`: every message is `-m` bytes, the default
+// - `uniform:<min>:<max>`: uniformly distributed in [min, max]
+// - `bimodal:<small>:<large>:<percent large>`: `small` bytes, or `large` bytes for the given
+//   percentage of messages. Either size may be a range `<min>-<max>`, e.g. `bimodal:64:4K-64K:20`.
+// - `zipf:<min>:<max>:<exponent>`: the powers of two from `min` up to `max`, the k-th smallest
+//   drawn with a probability proportional to 1 / k^exponent
+// - `trace:<path>`: the sizes listed in the file, one per line, replayed in a cycle
+// Sizes take a `K` or `M` suffix and must be within [FRAME_HEADER_SIZE, -m], `-m` being the
+// largest message the endpoints are set up for. Every message of a variable size workload is
+// a frame which starts with its length, see `payload.hh`.
+
+// Sizes drawn up front and cycled, so no random numbers are generated in the timed loop
+constexpr size_t WORKLOAD_TABLE_SIZE = 1 << 16;
+
+// Whether `-W` selects a workload other than `fixed`
+bool is_variable_size(const Args &args);
+
+// Exits unless `args.workload` is a valid workload for `args.message_size`
+void check_workload(const Args &args);
+
+// Appends " (workload <spec>)" to `name` for variable size workloads. No commas, the name is a
+// field of the results CSV, so a comma of the spec (in a trace path) becomes a semicolon.
+std::string workload_name(const std::string &name, const Args &args);
+
+// The message sizes of `args.workload`. The same sequence on every run, it is drawn with a
+// fixed seed.
+class SizeGenerator
+{
+    std::vector<size_t> sizes;
+    size_t next_index;
+
+public:
+    explicit SizeGenerator(const Args &args);
+
+    size_t next()
+    {
+        size_t size = sizes[next_index];
+        next_index = next_index + 1 == sizes.size() ? 0 : next_index + 1;
+        return size;
+    }
+};
+
+// Latency classes of the report, the iterations whose largest message is at most
+// `SIZE_CLASS_BASE` bytes, at most 4 times that, ... and the last class everything larger
+constexpr size_t SIZE_CLASS_BASE = 64;
+constexpr size_t NUM_SIZE_CLASSES = 8;
+
+size_t size_class(size_t size);
+
+// Label of a size class, e.g. `<= 4K` or `> 256K`
+std::string size_class_label(size_t size_class);
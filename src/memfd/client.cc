@@ -0,0 +1,63 @@
+#include "memfd.hh"
+#include "args.hh"
+#include "utils.hh"
+#include "barrier.hh"
+#include "pipeline.hh"
+#include "fan_in.hh"
+#include "driver.hh"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <iostream>
+#include <unistd.h>
+#include <vector>
+
+int main(int argc, char *argv[])
+{
+    std::cout << "Launching client" << std::endl;
+    Args args = parse_args(argc, argv, MAX_LARGE_MESSAGE_SIZE);
+    ReadyBarrier barrier(ReadyBarrier::Role::CLIENT);
+    // Wait until the server is listening
+    barrier.wait_until_notify();
+
+    int client_fd;
+    struct sockaddr_un addr;
+
+    if ((client_fd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1)
+    {
+        report_and_exit("socket");
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, MEMFD_SOCKET_PATH, sizeof(addr.sun_path) - 1);
+
+    if (connect(client_fd, (struct sockaddr *)&addr, sizeof(addr)) == -1)
+    {
+        close(client_fd);
+        report_and_exit("connect");
+    }
+
+    // The region's descriptor is the only thing passed with `SCM_RIGHTS`, once
+    MemfdManager region(args.message_size, args.window + 1);
+    region.receive_fd(client_fd);
+
+    // Indicate to server client is ready
+    barrier.notify();
+    if (is_fan_in(args))
+    {
+        // Stamped messages rotate through the client's `window` slots, as the server's do
+        // when it produces, so a slot is only rewritten once its message was answered
+        MemfdTransport transport(client_fd, region, 0, args.window);
+        run_client(args, transport);
+    }
+    else
+    {
+        // Echo the message through the client's own slot, as the socket benchmark writes it back
+        MemfdTransport transport(client_fd, region, args.window, 1);
+        run_client(args, transport);
+    }
+
+    close(client_fd);
+    return 0;
+}
@@ -0,0 +1,256 @@
+#include "memfd.hh"
+#include "payload.hh"
+#include "utils.hh"
+
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+MemfdManager::MemfdManager(size_t message_size, size_t num_slots)
+    : fd(-1), region(nullptr), region_size(message_size * num_slots), message_size(message_size),
+      num_slots(num_slots)
+{
+}
+
+MemfdManager::~MemfdManager()
+{
+    if (region != nullptr && munmap(region, region_size) == -1)
+    {
+        std::cerr << "munmap failed" << std::endl;
+    }
+    if (fd != -1)
+    {
+        close(fd);
+    }
+}
+
+void MemfdManager::create_region()
+{
+#ifdef __linux__
+    fd = memfd_create("ipc_bench_memfd", MFD_CLOEXEC);
+    if (fd == -1)
+    {
+        report_and_exit("memfd_create");
+    }
+#else
+    // Without memfd an unlinked POSIX shared memory object is an equivalent anonymous region
+    std::string name = "/ipc_bench_memfd_" + std::to_string(getpid());
+    fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd == -1)
+    {
+        report_and_exit("shm_open");
+    }
+    shm_unlink(name.c_str());
+#endif
+    if (ftruncate(fd, region_size) == -1)
+    {
+        report_and_exit("ftruncate");
+    }
+    map_region();
+}
+
+void MemfdManager::map_region()
+{
+    void *ptr = mmap(NULL, region_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (ptr == MAP_FAILED)
+    {
+        report_and_exit("mmap");
+    }
+    region = static_cast<char *>(ptr);
+}
+
+void MemfdManager::send_fd(int socket_fd) const
+{
+    // Ancillary data must be aligned for `cmsghdr`
+    union
+    {
+        char buf[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    memset(&control, 0, sizeof(control));
+
+    // At least one byte of real data has to accompany the ancillary data
+    char byte = 0;
+    struct iovec iov = {&byte, sizeof(byte)};
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+
+    if (sendmsg(socket_fd, &msg, 0) != sizeof(byte))
+    {
+        report_and_exit("sendmsg SCM_RIGHTS");
+    }
+}
+
+void MemfdManager::receive_fd(int socket_fd)
+{
+    union
+    {
+        char buf[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    memset(&control, 0, sizeof(control));
+
+    char byte;
+    struct iovec iov = {&byte, sizeof(byte)};
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    if (recvmsg(socket_fd, &msg, 0) != sizeof(byte))
+    {
+        report_and_exit("recvmsg SCM_RIGHTS");
+    }
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    if (cmsg == nullptr || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS ||
+        cmsg->cmsg_len != CMSG_LEN(sizeof(int)))
+    {
+        std::cerr << "Expected a file descriptor from the server" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+
+    // The server and client derive the layout from the same arguments
+    struct stat sb;
+    if (fstat(fd, &sb) == -1)
+    {
+        report_and_exit("fstat");
+    }
+    if (static_cast<size_t>(sb.st_size) != region_size)
+    {
+        std::cerr << "Shared region is " << sb.st_size << " bytes, expected " << region_size << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    map_region();
+}
+
+char *MemfdManager::slot(size_t index) const
+{
+    ASSERT(index < num_slots);
+    return region + index * message_size;
+}
+
+MemfdFrame MemfdManager::slot_frame(size_t index) const
+{
+    ASSERT(index < num_slots);
+    return MemfdFrame{index * message_size, message_size};
+}
+
+const char *MemfdManager::frame_data(const MemfdFrame &frame) const
+{
+    // The frame comes from the other process, never trust it to stay inside the mapping
+    if (frame.offset > region_size || frame.length > region_size - frame.offset)
+    {
+        std::cerr << "Frame [" << frame.offset << ", +" << frame.length << ") is outside the region" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    return region + frame.offset;
+}
+
+void send_frame(int socket_fd, const MemfdFrame &frame)
+{
+    write_full(socket_fd, &frame, sizeof(frame));
+}
+
+MemfdFrame recv_frame(int socket_fd)
+{
+    MemfdFrame frame;
+    read_full(socket_fd, &frame, sizeof(frame));
+    return frame;
+}
+
+MemfdTransport::MemfdTransport(int socket_fd, MemfdManager &region, size_t first_slot, size_t num_slots)
+    : socket_fd(socket_fd), region(region), first_slot(first_slot), num_slots(num_slots), sent(0), checksum(0)
+{
+}
+
+void MemfdTransport::send(const char *message, size_t size)
+{
+    // A slot is only reused once the message in it was answered, the window bounds how many
+    // are in flight
+    size_t index = first_slot + sent++ % num_slots;
+    memcpy(region.slot(index), message, size);
+    MemfdFrame frame = region.slot_frame(index);
+    frame.length = size;
+    send_frame(socket_fd, frame);
+}
+
+const char *MemfdTransport::recv(size_t size)
+{
+    MemfdFrame frame = recv_frame(socket_fd);
+    check_frame_length(frame.length, size);
+    const char *data = region.frame_data(frame);
+    checksum += touch_frame(data, frame.length);
+    return data;
+}
+
+const char *MemfdTransport::recv_framed(size_t max_size)
+{
+    MemfdFrame frame = recv_frame(socket_fd);
+    const char *data = region.frame_data(frame);
+    check_whole_frame(data, frame.length, max_size);
+    checksum += touch_frame(data, frame.length);
+    return data;
+}
+
+void MemfdTransport::send_ack()
+{
+    char ack = 0;
+    write_full(socket_fd, &ack, ACK_SIZE);
+}
+
+void MemfdTransport::recv_ack()
+{
+    char ack;
+    read_full(socket_fd, &ack, ACK_SIZE);
+}
+
+MemfdFanIn::MemfdFanIn(const std::vector<int> &client_fds, std::vector<std::unique_ptr<MemfdManager>> &regions,
+                       size_t window)
+    : client_fds(client_fds), regions(regions), window(window), poller(client_fds), checksum(0)
+{
+}
+
+const char *MemfdFanIn::recv_any(size_t size, size_t &source)
+{
+    source = poller.next_ready();
+    MemfdFrame frame = recv_frame(client_fds[source]);
+    check_frame_length(frame.length, size);
+    const char *data = regions[source]->frame_data(frame);
+    checksum += touch_frame(data, frame.length);
+    return data;
+}
+
+void MemfdFanIn::reply(size_t source, const char *message, size_t size)
+{
+    memcpy(regions[source]->slot(window), message, size);
+    send_frame(client_fds[source], regions[source]->slot_frame(window));
+}
+
+void MemfdFanIn::reply_ack(size_t source)
+{
+    char ack = 0;
+    write_full(client_fds[source], &ack, ACK_SIZE);
+}
+
+void MemfdFanIn::drop(size_t source)
+{
+    poller.remove(source);
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "fan_in.hh"
+#include "types.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+constexpr const char *MEMFD_SOCKET_PATH = "/tmp/cpp_ipc_benchmarks_memfd";
+
+// Location of a message in the shared region. This is the only data sent over the
+// socket per message, regardless of the message size.
+struct MemfdFrame
+{
+    uint64_t offset;
+    uint64_t length;
+};
+
+// A memory region shared between the server and client through a file descriptor.
+// The server creates the region with `memfd_create` and passes the descriptor to the
+// client once over the connected Unix socket with `SCM_RIGHTS`. Afterwards messages are
+// written into slots of the region in place and only a `MemfdFrame` crosses the socket.
+//
+// The region holds `num_slots` slots of `message_size` bytes. Which side writes which
+// slot is up to the caller, a slot must not be rewritten until its reader is done with it.
+class MemfdManager
+{
+    int fd;
+    char *region;
+    size_t region_size;
+    size_t message_size;
+    size_t num_slots;
+
+    // Maps `fd` once `region_size` is known
+    void map_region();
+
+public:
+    MemfdManager(size_t message_size, size_t num_slots);
+    ~MemfdManager();
+
+    MemfdManager(const MemfdManager &) = delete;
+    MemfdManager &operator=(const MemfdManager &) = delete;
+
+    // Creates and maps a new anonymous region (server side)
+    void create_region();
+    // Passes the region's descriptor to the peer of the connected `socket_fd`
+    void send_fd(int socket_fd) const;
+    // Receives the region's descriptor from `socket_fd` and maps it (client side).
+    // Exits if the region does not have the expected size.
+    void receive_fd(int socket_fd);
+
+    // Start of slot `index`
+    char *slot(size_t index) const;
+    // Frame describing the whole of slot `index`
+    MemfdFrame slot_frame(size_t index) const;
+    // Start of the message described by `frame`, exits if it lies outside the region
+    const char *frame_data(const MemfdFrame &frame) const;
+};
+
+// Sends `frame` over `socket_fd`
+void send_frame(int socket_fd, const MemfdFrame &frame);
+
+// Receives the next frame from `socket_fd`
+MemfdFrame recv_frame(int socket_fd);
+
+// One side of a connection as a `Transport`. A message is copied into the next of the
+// `num_slots` slots from `first_slot` on, rotating, and only its frame is sent. A received
+// message is read in place in the region, every cache line of it is touched.
+class MemfdTransport
+{
+    int socket_fd;
+    MemfdManager &region;
+    size_t first_slot;
+    size_t num_slots;
+    // Messages sent so far, which picks the next slot
+    ull sent;
+    uint8_t checksum;
+
+public:
+    MemfdTransport(int socket_fd, MemfdManager &region, size_t first_slot, size_t num_slots);
+
+    void send(const char *message, size_t size);
+    // Exits if the frame is not `size` bytes
+    const char *recv(size_t size);
+    const char *recv_framed(size_t max_size);
+    // Acks are a byte on the socket, they carry no payload to place in the region
+    void send_ack();
+    void recv_ack();
+};
+
+// Fan-in server over every client's connection and region. A client's messages are in slots
+// [0, window) of its region, it is answered through slot `window` or with an ack byte.
+class MemfdFanIn
+{
+    std::vector<int> client_fds;
+    std::vector<std::unique_ptr<MemfdManager>> &regions;
+    size_t window;
+    FdPoller poller;
+    uint8_t checksum;
+
+public:
+    MemfdFanIn(const std::vector<int> &client_fds, std::vector<std::unique_ptr<MemfdManager>> &regions,
+               size_t window);
+
+    const char *recv_any(size_t size, size_t &source);
+    void reply(size_t source, const char *message, size_t size);
+    void reply_ack(size_t source);
+    void drop(size_t source);
+};
@@ -0,0 +1,119 @@
+#include "memfd.hh"
+#include "args.hh"
+#include "utils.hh"
+#include "barrier.hh"
+#include "bench.hh"
+#include "pipeline.hh"
+#include "fan_in.hh"
+#include "driver.hh"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <iostream>
+#include <memory>
+#include <vector>
+#include <unistd.h>
+
+// Every client has its own connection and region. A client writes its messages into slots
+// [0, window) of its region, the server echoes through the last slot or acks on the socket.
+static int serve_fan_in(const Args &args, ReadyBarrier &barrier, int server_fd)
+{
+    FanInServer server(fan_in_name("memfd", args), args);
+    if (listen(server_fd, static_cast<int>(args.fan_in)) == -1)
+    {
+        close(server_fd);
+        report_and_exit("listen");
+    }
+    barrier.notify(args.fan_in);
+
+    std::vector<int> client_fds;
+    std::vector<std::unique_ptr<MemfdManager>> regions;
+    for (ull i = 0; i < args.fan_in; i++)
+    {
+        int client_fd = accept(server_fd, NULL, NULL);
+        if (client_fd == -1)
+        {
+            report_and_exit("accept");
+        }
+        regions.push_back(std::make_unique<MemfdManager>(args.message_size, args.window + 1));
+        regions.back()->create_region();
+        regions.back()->send_fd(client_fd);
+        client_fds.push_back(client_fd);
+    }
+    barrier.wait_until_notify(args.fan_in);
+
+    MemfdFanIn transport(client_fds, regions, args.window);
+    run_fan_in_server(server, args, transport);
+
+    for (int client_fd : client_fds)
+    {
+        close(client_fd);
+    }
+    close(server_fd);
+    unlink(MEMFD_SOCKET_PATH);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    std::cout << "Launching server" << std::endl;
+    // The payload is never copied through the socket, so large messages are allowed
+    Args args = parse_args(argc, argv, MAX_LARGE_MESSAGE_SIZE);
+    ReadyBarrier barrier(ReadyBarrier::Role::SERVER);
+
+    int server_fd, client_fd;
+    struct sockaddr_un addr;
+
+    if ((server_fd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1)
+    {
+        report_and_exit("socket");
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, MEMFD_SOCKET_PATH, sizeof(addr.sun_path) - 1);
+
+    unlink(MEMFD_SOCKET_PATH); // Remove any existing socket file
+    if (bind(server_fd, (struct sockaddr *)&addr, sizeof(addr)) == -1)
+    {
+        close(server_fd);
+        report_and_exit("bind");
+    }
+
+    if (is_fan_in(args))
+    {
+        return serve_fan_in(args, barrier, server_fd);
+    }
+    Benchmarks benchmarks(pipelined_name("memfd", args), args);
+
+    if (listen(server_fd, 1) == -1)
+    {
+        close(server_fd);
+        report_and_exit("listen");
+    }
+
+    std::cout << "Server listening on " << MEMFD_SOCKET_PATH << std::endl;
+    barrier.notify();
+
+    if ((client_fd = accept(server_fd, NULL, NULL)) == -1)
+    {
+        close(server_fd);
+        report_and_exit("accept");
+    }
+
+    // Slots [0, window) carry server to client messages, the last slot carries the client's echo
+    MemfdManager region(args.message_size, args.window + 1);
+    region.create_region();
+    region.send_fd(client_fd);
+
+    // Wait until client has mapped the region
+    barrier.wait_until_notify();
+    // At most `window` messages are unacknowledged, so a slot is free again once it is reused
+    MemfdTransport transport(client_fd, region, 0, args.window);
+    run_server(benchmarks, args, transport);
+
+    close(client_fd);
+    close(server_fd);
+    unlink(MEMFD_SOCKET_PATH);
+    return 0;
+}
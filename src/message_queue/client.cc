@@ -1,48 +1,27 @@
 #include "message.hh"
 #include "mq.hh"
 #include "args.hh"
-#include "signals.hh"
+#include "barrier.hh"
+#include "pipeline.hh"
+#include "fan_in.hh"
+#include "driver.hh"
 
 #include <cassert>
 #include <sys/msg.h>
 
-// Reads a message from the message queue and writes it back to the server
-void ping_pong(key_t msq_id_server_client, key_t msq_id_client_server, ull iterations, ull message_size)
+// Echoes or acks the server's messages. A fan-in client sends its stamped messages on the
+// shared client to server queue and receives only the replies of its own type.
+void start_client(int msq_id_server_client, int msq_id_client_server, const Args &args)
 {
-    SignalManager signal_manager(SignalManager::SignalTarget::CLIENT);
-    MsgbufRAII msg_buf(message_size, CLIENT_TYPE);
-
-    // Notify server that client has joined
-    signal_manager.notify();
-    for (ull i = 0; i < iterations; i++)
-    {
-        // Send the message to the client
-        // std::cout << "Receiving message " << i << " from server\n";
-        assert(msg_buf.get_len() == message_size);
-        // Receive a message from the client
-        // ```
-        // ssize_t msgrcv(int msqid, void *msgp, size_t msgsz, long msgtyp,
-        //                int msgflg);
-        // ```
-        // Arguments:
-        // 4. msgtyp: means the first message of type `msgtyp` in the queue is received
-        //    unless the type is 0, in which case the first message in the queue is received
-        if (msgrcv(msq_id_server_client, msg_buf.data_ptr(), msg_buf.get_len(), 0, 0) == -1)
-        {
-            std::cerr << "Error Number: " << errno << std::endl;
-            perror("msgrcv");
-            exit(EXIT_FAILURE);
-        }
-
-        msg_buf.data_ptr()->mtype = CLIENT_TYPE;
-        // std::cout << "Sending message " << i << " to server" << std::endl;
-        if (msgsnd(msq_id_client_server, msg_buf.data_ptr(), msg_buf.get_len(), 0) == -1)
-        {
-            std::cerr << "Error Number: " << errno << "\n";
-            perror("msgsnd");
-            return;
-        }
-    }
+    ReadyBarrier barrier(ReadyBarrier::Role::CLIENT);
+    long reply_type = is_fan_in(args) ? fan_in_client_type(args.client_id) : 0;
+    MsgQueueTransport transport(msq_id_client_server, msq_id_server_client, CLIENT_TYPE, reply_type,
+                                args.message_size);
+
+    // Wait until the server is up, then notify it that client has joined
+    barrier.wait_until_notify();
+    barrier.notify();
+    run_client(args, transport);
 }
 
 int main(int argc, char *argv[])
@@ -61,8 +40,7 @@ int main(int argc, char *argv[])
 
     int msq_id_server_client = create_mq(MSG_FILE_SERVER_CLIENT);
     int msq_id_client_server = create_mq(MSG_FILE_CLIENT_SERVER);
-
-    ping_pong(msq_id_server_client, msq_id_client_server, args.iterations, args.message_size);
+    start_client(msq_id_server_client, msq_id_client_server, args);
 
     return 0;
-}
\ No newline at end of file
+}
@@ -1,10 +1,23 @@
 #pragma once
 
 #include "bench.hh"
+#include "fan_in.hh"
+#include "payload.hh"
+#include "utils.hh"
+
+#include <cstring>
+#include <sys/msg.h>
 
 constexpr const unsigned int CLIENT_TYPE = 1;
 constexpr const unsigned int SERVER_TYPE = 2;
 
+// Type of the server's replies to fan-in client `client`, so each client can receive only
+// its own from the shared queue (types must be positive)
+inline long fan_in_client_type(ull client)
+{
+    return static_cast<long>(client) + 1;
+}
+
 // Follows message specification: https://man7.org/linux/man-pages/man3/msgrcv.3p.html
 // ```
 // struct mymsg {
@@ -62,4 +75,113 @@ public:
     {
         std::strncpy(msgbuf->buffer, data, size);
     }
-};
\ No newline at end of file
+};
+
+// One side's pair of queues as a `Transport`. Messages are sent with `send_type` on the queue
+// `send_id` and received from `recv_id`, only those of `recv_type` unless it is 0. A message
+// is composed in (and received into) the text of the one `Msgbuf`.
+class MsgQueueTransport
+{
+    int send_id;
+    int recv_id;
+    long send_type;
+    long recv_type;
+    MsgbufRAII msg_buf;
+
+public:
+    MsgQueueTransport(int send_id, int recv_id, long send_type, long recv_type, size_t message_size)
+        : send_id(send_id), recv_id(recv_id), send_type(send_type), recv_type(recv_type),
+          msg_buf(message_size, send_type)
+    {
+    }
+
+    char *send_buffer()
+    {
+        return msg_buf.data_ptr()->buffer;
+    }
+
+    void send(const char *message, size_t size)
+    {
+        Msgbuf *buf = msg_buf.data_ptr();
+        if (message != buf->buffer)
+        {
+            memcpy(buf->buffer, message, size);
+        }
+        // A received message overwrote the type
+        buf->mtype = send_type;
+        // Blocks while the queue is full, which bounds the window by the queue capacity.
+        // Default queue size is 16KB on Linux: https://linux.die.net/man/2/msgsnd (see `MSGMNB`)
+        if (msgsnd(send_id, buf, size, 0) == -1)
+        {
+            report_and_exit("msgsnd");
+        }
+    }
+
+    const char *recv(size_t)
+    {
+        // ```
+        // ssize_t msgrcv(int msqid, void *msgp, size_t msgsz, long msgtyp,
+        //                int msgflg);
+        // ```
+        // 4. msgtyp: means the first message of type `msgtyp` in the queue is received
+        //    unless the type is 0, in which case the first message in the queue is received
+        // The call blocks until a message of the desired type is placed on the queue.
+        // https://man7.org/linux/man-pages/man3/msgrcv.3p.html
+        if (msgrcv(recv_id, msg_buf.data_ptr(), msg_buf.get_len(), recv_type, 0) == -1)
+        {
+            report_and_exit("msgrcv");
+        }
+        return msg_buf.data_ptr()->buffer;
+    }
+
+    const char *recv_framed(size_t max_size)
+    {
+        // The size of the message text is returned, a message is received whole
+        ssize_t received = msgrcv(recv_id, msg_buf.data_ptr(), msg_buf.get_len(), recv_type, 0);
+        if (received == -1)
+        {
+            report_and_exit("msgrcv");
+        }
+        check_whole_frame(msg_buf.data_ptr()->buffer, static_cast<size_t>(received), max_size);
+        return msg_buf.data_ptr()->buffer;
+    }
+};
+
+// Fan-in server: every client sends to the queue `request_id`, and the replies go to the
+// queue `reply_id` with the type of the client they answer, which only that client receives
+class MsgQueueFanIn
+{
+    int request_id;
+    int reply_id;
+    MsgbufRAII msg_buf;
+
+public:
+    MsgQueueFanIn(int request_id, int reply_id, size_t message_size)
+        : request_id(request_id), reply_id(reply_id), msg_buf(message_size, SERVER_TYPE)
+    {
+    }
+
+    const char *recv_any(size_t, size_t &source)
+    {
+        if (msgrcv(request_id, msg_buf.data_ptr(), msg_buf.get_len(), 0, 0) == -1)
+        {
+            report_and_exit("msgrcv");
+        }
+        source = fan_in_sender(msg_buf.data_ptr()->buffer);
+        return msg_buf.data_ptr()->buffer;
+    }
+
+    void reply(size_t source, const char *message, size_t size)
+    {
+        Msgbuf *buf = msg_buf.data_ptr();
+        if (message != buf->buffer)
+        {
+            memcpy(buf->buffer, message, size);
+        }
+        buf->mtype = fan_in_client_type(source);
+        if (msgsnd(reply_id, buf, size, 0) == -1)
+        {
+            report_and_exit("msgsnd");
+        }
+    }
+};
@@ -1,9 +1,12 @@
-#include "signals.hh"
+#include "barrier.hh"
 #include "bench.hh"
 #include "message.hh"
 #include "mq.hh"
 #include "args.hh"
 #include "utils.hh"
+#include "pipeline.hh"
+#include "fan_in.hh"
+#include "driver.hh"
 
 #include <iostream>
 // Prefer System V message queues over POSIX message queues on MacOS
@@ -12,51 +15,31 @@
 #include <cstdio>
 #include <cassert>
 
-// Server initiates the first message, and then repeatedly ping-pongs the message with the client
-void ping_pong(key_t msq_id_server_client, key_t msq_id_client_server, ull iterations, ull message_size)
+// Server initiates every message, ping-pong or a pipelined stream, on the server to client
+// queue and receives the client's echoes or acks on the client to server queue
+void start_server(int msq_id_server_client, int msq_id_client_server, const Args &args)
 {
-    SignalManager signal_manager(SignalManager::SignalTarget::SERVER);
-    Benchmarks benchmarks(std::string("message_queue"), message_size);
-    MsgbufRAII msg_buf(message_size, SERVER_TYPE);
+    ReadyBarrier barrier(ReadyBarrier::Role::SERVER);
+    Benchmarks benchmarks(pipelined_name("message_queue", args), args);
+    MsgQueueTransport transport(msq_id_server_client, msq_id_client_server, SERVER_TYPE, 0, args.message_size);
 
-    // Wait until client has joined
-    signal_manager.wait_until_notify();
-    for (ull i = 0; i < iterations; i++)
-    {
-        benchmarks.start_iteration();
-        // Send the message to the client
-        // std::cout << "Sending message " << i << " to client" << std::endl;
-        ASSERT(msg_buf.get_len() == message_size);
-        // IPC_NOWAIT - return immediately if the message cannot be sent (e.g. queue full)
-        // Default queue size is 16KB on Linux: https://linux.die.net/man/2/msgsnd (see `MSGMNB`)
-        // On MacOS, the default appears to be 2KB
-        msg_buf.data_ptr()->mtype = SERVER_TYPE;
-        if (msgsnd(msq_id_server_client, msg_buf.data_ptr(), message_size, 0) == -1)
-        {
-            std::cerr << "Error Number: " << errno << "\n";
-            report_and_exit("msgsnd");
-        }
+    // Queues exist, let the client join and wait until it has
+    barrier.notify();
+    barrier.wait_until_notify();
+    run_server(benchmarks, args, transport);
+}
 
-        // Receive a message from the client
-        // ```
-        // ssize_t msgrcv(int msqid, void *msgp, size_t msgsz, long msgtyp,
-        //                int msgflg);
-        // ```
-        // Arguments:
-        // 4. msgtyp: means the first message of type `msgtyp` in the queue is received
-        //    unless the type is 0, in which case the first message in the queue is received
-        // This call is blocking:
-        // "*  If (msgflg & IPC_NOWAIT) is 0, the calling thread shall
-        // suspend execution until one of the following occurs:
-        // --  A message of the desired type is placed on the queue.:
-        // https://man7.org/linux/man-pages/man3/msgrcv.3p.html
-        if (msgrcv(msq_id_client_server, msg_buf.data_ptr(), msg_buf.get_len(), 0, 0) == -1)
-        {
-            report_and_exit("msgrcv");
-        }
-        // Benchmark one ping pong iteration
-        benchmarks.end_iteration(1);
-    }
+// Server receives every client's messages from the one client to server queue and replies
+// on the server to client queue with the sender's type, which only that client receives
+void fan_in(int msq_id_server_client, int msq_id_client_server, const Args &args)
+{
+    ReadyBarrier barrier(ReadyBarrier::Role::SERVER);
+    FanInServer server(fan_in_name("message_queue", args), args);
+    MsgQueueFanIn transport(msq_id_client_server, msq_id_server_client, args.message_size);
+
+    barrier.notify(args.fan_in);
+    barrier.wait_until_notify(args.fan_in);
+    run_fan_in_server(server, args, transport);
 }
 
 int main(int argc, char *argv[])
@@ -76,7 +59,14 @@ int main(int argc, char *argv[])
     int msq_id_server_client = create_mq(MSG_FILE_SERVER_CLIENT);
     int msq_id_client_server = create_mq(MSG_FILE_CLIENT_SERVER);
 
-    ping_pong(msq_id_server_client, msq_id_client_server, args.iterations, args.message_size);
+    if (is_fan_in(args))
+    {
+        fan_in(msq_id_server_client, msq_id_client_server, args);
+    }
+    else
+    {
+        start_server(msq_id_server_client, msq_id_client_server, args);
+    }
 
     return 0;
-}
\ No newline at end of file
+}
@@ -2,28 +2,41 @@
 #include "named_pipe.hh"
 #include "bench.hh"
 #include "types.hh"
-#include "signals.hh"
+#include "barrier.hh"
+#include "pipeline.hh"
+#include "io_engine.hh"
+#include "fan_in.hh"
+#include "driver.hh"
 
-void start_server(Args args)
+void start_client(Args args)
 {
-    FifoManager fifo_s2c(server_to_client_fifo, args);
-    FifoManager fifo_c2s(client_to_server_fifo, args);
-    SignalManager signal_manager = SignalManager(SignalManager::SignalTarget::CLIENT);
-
-    // Notify the client to start
-    signal_manager.notify();
-    for (ull i = 0; i < args.iterations; i++)
+    if (is_fan_in(args))
     {
-        // Full ping pong
-        fifo_s2c.read_fifo();
-        fifo_c2s.write_fifo();
+        check_fan_in_message_size(args);
     }
+    ReadyBarrier barrier(ReadyBarrier::Role::CLIENT);
+    // Wait until the server has created the FIFOs
+    barrier.wait_until_notify();
+    // A fan-in client shares the client to server FIFO and is answered on its own FIFO
+    FifoManager fifo_s2c(is_fan_in(args) ? fan_in_reply_fifo(args.client_id) : server_to_client_fifo, args);
+    FifoManager fifo_c2s(client_to_server_fifo, args);
+    IoEngine engine(args);
+    // The client echoes the server's message, so both directions use the same buffer
+    std::vector<char> &buf = fifo_s2c.get_buf();
+    engine.register_files({fifo_s2c.get_fd(), fifo_c2s.get_fd()});
+    engine.register_buffers({{buf.data(), buf.size()}});
+    StreamTransport transport(engine, fifo_c2s.get_fd(), fifo_s2c.get_fd(), buf.data(), buf.data());
+
+    // Notify the server to start
+    barrier.notify();
+    run_client(args, transport);
 }
 
 int main(int argc, char *argv[])
 {
-    Args args = parse_args(argc, argv);
-    start_server(args);
+    // Reads and writes loop over partial transfers, so messages may exceed the FIFO capacity
+    Args args = parse_args(argc, argv, MAX_LARGE_MESSAGE_SIZE);
+    start_client(args);
 
     return 0;
-}
\ No newline at end of file
+}
@@ -1,4 +1,24 @@
 #include "named_pipe.hh"
+#include "utils.hh"
+
+#include <climits>
+#include <iostream>
+#include <unistd.h>
+
+std::string fan_in_reply_fifo(ull client)
+{
+    return server_to_client_fifo + "_" + std::to_string(client);
+}
+
+void check_fan_in_message_size(const Args &args)
+{
+    if (args.message_size > PIPE_BUF)
+    {
+        std::cerr << "Fan-in clients share one FIFO, messages must be at most PIPE_BUF (" << PIPE_BUF
+                  << ") bytes so writes are not interleaved" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+}
 
 void FifoManager::_create_fifo()
 {
@@ -94,3 +114,13 @@ std::vector<char> &FifoManager::read_fifo()
     _read_fifo();
     return _buf;
 }
+
+int FifoManager::get_fd() const
+{
+    return _fd;
+}
+
+std::vector<char> &FifoManager::get_buf()
+{
+    return _buf;
+}
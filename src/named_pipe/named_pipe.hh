@@ -10,6 +10,13 @@
 const std::string server_to_client_fifo = "/tmp/server_to_client_fifo";
 const std::string client_to_server_fifo = "/tmp/client_to_server_fifo";
 
+// FIFO of the server's replies to fan-in client `client`. All clients share the client to
+// server FIFO, which keeps their messages whole only up to `PIPE_BUF` bytes.
+std::string fan_in_reply_fifo(ull client);
+
+// Exits unless the messages of a fan-in run fit in one atomic FIFO write
+void check_fan_in_message_size(const Args &args);
+
 class FifoManager
 {
 private:
@@ -47,4 +54,8 @@ public:
     void write_fifo();
 
     std::vector<char> &read_fifo();
+
+    int get_fd() const;
+
+    std::vector<char> &get_buf();
 };
@@ -2,31 +2,64 @@
 #include "named_pipe.hh"
 #include "bench.hh"
 #include "types.hh"
-#include "signals.hh"
+#include "barrier.hh"
+#include "pipeline.hh"
+#include "io_engine.hh"
+#include "fan_in.hh"
+#include "driver.hh"
+
+#include <memory>
 
 void start_server(Args args)
 {
     FifoManager fifo_s2c(server_to_client_fifo, args);
     FifoManager fifo_c2s(client_to_server_fifo, args);
-    Benchmarks benchmarks(std::string("named_pipe"), args.message_size);
-    SignalManager signal_manager = SignalManager(SignalManager::SignalTarget::SERVER);
+    Benchmarks benchmarks(pipelined_name(io_engine_name("named_pipe", args), args), args);
+    ReadyBarrier barrier(ReadyBarrier::Role::SERVER);
+    IoEngine engine(args);
+    std::vector<char> &buf_s2c = fifo_s2c.get_buf();
+    std::vector<char> &buf_c2s = fifo_c2s.get_buf();
+    engine.register_files({fifo_s2c.get_fd(), fifo_c2s.get_fd()});
+    engine.register_buffers({{buf_s2c.data(), buf_s2c.size()}, {buf_c2s.data(), buf_c2s.size()}});
+    StreamTransport transport(engine, fifo_s2c.get_fd(), fifo_c2s.get_fd(), buf_s2c.data(), buf_c2s.data());
+
+    // FIFOs exist, let the client open them and wait until it has
+    barrier.notify();
+    barrier.wait_until_notify();
+    run_server(benchmarks, args, transport);
+}
 
-    // Wait until client starts (server should start before the client)
-    signal_manager.wait_until_notify();
-    for (ull i = 0; i < args.iterations; i++)
+// All clients write to the client to server FIFO, each is answered on its own FIFO
+void serve_fan_in(const Args &args)
+{
+    check_fan_in_message_size(args);
+    FifoManager fifo_c2s(client_to_server_fifo, args);
+    std::vector<std::unique_ptr<FifoManager>> reply_fifos;
+    std::vector<int> reply_fds;
+    for (ull client = 0; client < args.fan_in; client++)
     {
-        // Full ping pong
-        benchmarks.start_iteration();
-        fifo_s2c.write_fifo();
-        fifo_c2s.read_fifo();
-        benchmarks.end_iteration(1);
+        reply_fifos.push_back(std::make_unique<FifoManager>(fan_in_reply_fifo(client), args));
+        reply_fds.push_back(reply_fifos.back()->get_fd());
     }
+    FanInServer server(fan_in_name("named_pipe", args), args);
+    ReadyBarrier barrier(ReadyBarrier::Role::SERVER);
+    SharedFdFanIn transport(fifo_c2s.get_fd(), reply_fds, args.message_size);
+
+    barrier.notify(args.fan_in);
+    barrier.wait_until_notify(args.fan_in);
+    run_fan_in_server(server, args, transport);
 }
 
 int main(int argc, char *argv[])
 {
-    Args args = parse_args(argc, argv);
+    // Reads and writes loop over partial transfers, so messages may exceed the FIFO capacity
+    Args args = parse_args(argc, argv, MAX_LARGE_MESSAGE_SIZE);
+    if (is_fan_in(args))
+    {
+        serve_fan_in(args);
+        return 0;
+    }
     start_server(args);
 
     return 0;
-}
\ No newline at end of file
+}
@@ -4,109 +4,222 @@
 
 #include "utils.hh"
 #include "bench.hh"
-#include "signals.hh"
+#include "barrier.hh"
 #include "args.hh"
+#include "pipeline.hh"
+#include "io_engine.hh"
+#include "pipe_mode.hh"
+#include "fan_in.hh"
+#include "driver.hh"
 
+#include <array>
 #include <iostream>
 #include <unistd.h>
+#include <fcntl.h>
+#include <climits>
 #include <string>
-#include <thread>
+#include <sys/wait.h>
+#include <vector>
 
 #define READ_FD 0
 #define WRITE_FD 1
 
-void start_child(int pipefd_s2c[2], int pipefd_c2s[2], ull message_size, ull iterations)
+void start_child(int pipefd_s2c[2], int pipefd_c2s[2], const Args &args, ReadyBarrier &barrier)
 {
-    SignalManager signal_manager(SignalManager::SignalTarget::CLIENT);
+    PipeMode mode = parse_pipe_mode(args.pipe_mode);
+    barrier.assume_role(ReadyBarrier::Role::CLIENT);
 
     // Child process does not write to s2c, and does not read from c2s
     close(pipefd_s2c[WRITE_FD]);
     close(pipefd_c2s[READ_FD]);
 
-    // Notify server that client is ready to read (server will start first)
-    signal_manager.notify();
-    char *buffer = new char[message_size];
-    for (ull i = 0; i < iterations; i++)
     {
-
-        if (read(pipefd_s2c[READ_FD], buffer, message_size) < 0)
-        {
-            report_and_exit("read() failed");
-        }
-
-        if (write(pipefd_c2s[WRITE_FD], buffer, message_size) < 0)
-        {
-            report_and_exit("write() failed");
-        }
+        // Created after the fork, a ring must not be shared between processes. The server only
+        // sends again after it consumed the echo, so the one gifted echo buffer is never
+        // rewritten early.
+        IoEngine engine(args);
+        PipeTransport transport(engine, mode, pipefd_c2s[WRITE_FD], pipefd_s2c[READ_FD], args.message_size, 1);
+
+        // Wait until the server is up, then notify it that client is ready to read
+        barrier.wait_until_notify();
+        barrier.notify();
+        run_client(args, transport);
     }
 
-    delete[] buffer;
     close(pipefd_s2c[READ_FD]);
     close(pipefd_c2s[WRITE_FD]);
 }
 
-void start_parent(int pipefd_s2c[2], int pipefd_c2s[2], ull message_size, ull iterations)
+void start_parent(int pipefd_s2c[2], int pipefd_c2s[2], const Args &args, ReadyBarrier &barrier)
 {
-    Benchmarks benchmarks(std::string("pipe"), message_size);
-    SignalManager signal_manager(SignalManager::SignalTarget::SERVER);
+    PipeMode mode = parse_pipe_mode(args.pipe_mode);
+    Benchmarks benchmarks(pipelined_name(io_engine_name(pipe_name(args), args), args), args);
+    barrier.assume_role(ReadyBarrier::Role::SERVER);
     // Parent process does not read from s2c, and does not write to c2s
     close(pipefd_s2c[READ_FD]);
     close(pipefd_c2s[WRITE_FD]);
 
-    char *buffer = new char[message_size];
+    {
+        // Gifted pages must not be rewritten until the client consumed them. In pipelined mode
+        // at most `window` messages are unacknowledged, so each one in flight gets its own buffer.
+        size_t num_buffers = mode == PipeMode::VMSPLICE ? args.window : 1;
+        IoEngine engine(args);
+        PipeTransport transport(engine, mode, pipefd_s2c[WRITE_FD], pipefd_c2s[READ_FD], args.message_size,
+                                num_buffers);
+
+        // Let the client start and wait for it to notify that it has joined
+        barrier.notify();
+        barrier.wait_until_notify();
+        run_server(benchmarks, args, transport);
+    }
+
+    close(pipefd_s2c[WRITE_FD]);
+    close(pipefd_c2s[READ_FD]);
+}
+
+// Fan-in client `args.client_id`: writes stamped messages to the shared pipe and reads the
+// replies from its own
+void start_fan_in_child(int pipefd_c2s[2], std::vector<std::array<int, 2>> &pipefds_s2c, const Args &args,
+                        ReadyBarrier &barrier)
+{
+    PipeMode mode = parse_pipe_mode(args.pipe_mode);
+    barrier.assume_role(ReadyBarrier::Role::CLIENT);
+    close(pipefd_c2s[READ_FD]);
+    for (ull client = 0; client < pipefds_s2c.size(); client++)
+    {
+        close(pipefds_s2c[client][WRITE_FD]);
+        if (client != args.client_id)
+        {
+            close(pipefds_s2c[client][READ_FD]);
+        }
+    }
+    int reply_fd = pipefds_s2c[args.client_id][READ_FD];
+
+    {
+        IoEngine engine(args);
+        PipeTransport transport(engine, mode, pipefd_c2s[WRITE_FD], reply_fd, args.message_size, 1);
+        barrier.wait_until_notify();
+        barrier.notify();
+        run_client(args, transport);
+    }
+    close(reply_fd);
+    close(pipefd_c2s[WRITE_FD]);
+}
+
+// Serves the fan-in clients from the shared pipe, answering each on its own pipe
+void start_fan_in_parent(int pipefd_c2s[2], std::vector<std::array<int, 2>> &pipefds_s2c, const Args &args,
+                         ReadyBarrier &barrier)
+{
+    FanInServer server(fan_in_name(pipe_name(args), args), args);
+    barrier.assume_role(ReadyBarrier::Role::SERVER);
+    close(pipefd_c2s[WRITE_FD]);
+    for (std::array<int, 2> &pipefd_s2c : pipefds_s2c)
+    {
+        close(pipefd_s2c[READ_FD]);
+    }
+    std::vector<int> reply_fds;
+    for (std::array<int, 2> &pipefd_s2c : pipefds_s2c)
+    {
+        reply_fds.push_back(pipefd_s2c[WRITE_FD]);
+    }
+    // Each message was written atomically, so reads stay aligned to whole messages, one
+    // packet each in packet mode
+    SharedFdFanIn transport(pipefd_c2s[READ_FD], reply_fds, args.message_size);
+
+    barrier.notify(args.fan_in);
+    barrier.wait_until_notify(args.fan_in);
+    run_fan_in_server(server, args, transport);
+    for (std::array<int, 2> &pipefd_s2c : pipefds_s2c)
+    {
+        close(pipefd_s2c[WRITE_FD]);
+    }
+    close(pipefd_c2s[READ_FD]);
+}
 
-    // Generate a string with `message_size` number of bytes
-    std::string text = std::string(message_size, 'a');
-    if (text.copy(buffer, message_size, 0) != message_size)
+// Forks `args.fan_in` clients which share one client to server pipe, each with its own
+// server to client pipe. Returns 0 if the server and every client succeeded.
+int run_fan_in(const Args &args, PipeMode mode)
+{
+    if (mode == PipeMode::VMSPLICE || args.message_size > PIPE_BUF)
     {
-        report_and_exit("copy() did not copy full message size");
+        // Only writes of at most `PIPE_BUF` bytes are atomic, larger ones of several
+        // clients could interleave
+        std::cerr << "Fan-in clients share one pipe, which needs the copy or packet mode and messages of at most "
+                  << "PIPE_BUF (" << PIPE_BUF << ") bytes" << std::endl;
+        return 1;
+    }
+    int pipefd_c2s[2];
+    create_pipe(pipefd_c2s, mode, args.kernel_buffer_size);
+    std::vector<std::array<int, 2>> pipefds_s2c(args.fan_in);
+    for (std::array<int, 2> &pipefd_s2c : pipefds_s2c)
+    {
+        create_pipe(pipefd_s2c.data(), mode, args.kernel_buffer_size);
     }
 
-    // Wait for client to notify that it has joined
-    signal_manager.wait_until_notify();
-    for (ull i = 0; i < iterations; i++)
+    ReadyBarrier barrier(ReadyBarrier::Role::LAUNCHER);
+    std::vector<pid_t> pids;
+    for (ull client = 0; client < args.fan_in; client++)
     {
-        // Benchmarks server to client write
-        benchmarks.start_iteration();
-        if (write(pipefd_s2c[WRITE_FD], buffer, message_size) < 0)
+        pid_t pid = fork();
+        if (pid < 0)
         {
-            report_and_exit("write() failed");
+            report_and_exit("fork() failed");
         }
-        // A successful read implies the client finished its read and wrote data
-        // "If a process attempts to read from an empty pipe, then read(2)
-        // will block until data is available."
-        // https://man7.org/linux/man-pages/man7/pipe.7.html
-        if (read(pipefd_c2s[READ_FD], buffer, message_size) < 0)
+        if (pid == 0)
         {
-            report_and_exit("read() failed");
+            Args client_args = args;
+            client_args.client_id = client;
+            start_fan_in_child(pipefd_c2s, pipefds_s2c, client_args, barrier);
+            exit(EXIT_SUCCESS);
         }
-        // Each iteration is 1 ping pong message
-        benchmarks.end_iteration(1);
+        pids.push_back(pid);
     }
+    start_fan_in_parent(pipefd_c2s, pipefds_s2c, args, barrier);
 
-    delete[] buffer;
-    close(pipefd_s2c[WRITE_FD]);
-    close(pipefd_c2s[READ_FD]);
+    bool succeeded = true;
+    for (pid_t pid : pids)
+    {
+        int status;
+        if (waitpid(pid, &status, 0) == -1)
+        {
+            report_and_exit("waitpid");
+        }
+        succeeded = succeeded && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    }
+    return succeeded ? 0 : 1;
 }
 
 int main(int argc, char *argv[])
 {
-    Args args = parse_args(argc, argv);
-
-    int pipefd_s2c[2];
-    if (pipe(pipefd_s2c) != 0)
+    // Reads and writes loop over partial transfers, so messages may exceed the pipe capacity
+    Args args = parse_args(argc, argv, MAX_LARGE_MESSAGE_SIZE);
+    PipeMode mode = parse_pipe_mode(args.pipe_mode);
+    if (mode != PipeMode::COPY && args.io_engine != "syscall")
     {
-        report_and_exit("pipe() server to client failed");
+        std::cerr << "The io_uring engines only support the copy pipe mode" << std::endl;
         return 1;
     }
-
-    int pipefd_c2s[2];
-    if (pipe(pipefd_c2s) != 0)
+    if (mode == PipeMode::PACKET && args.message_size > PIPE_BUF)
     {
-        report_and_exit("pipe() client to server failed");
+        // Larger writes are split into several packets, which loses the message boundary
+        std::cerr << "Packet mode messages must be at most PIPE_BUF (" << PIPE_BUF << ") bytes" << std::endl;
         return 1;
     }
 
+    if (is_fan_in(args))
+    {
+        return run_fan_in(args, mode);
+    }
+
+    int pipefd_s2c[2];
+    create_pipe(pipefd_s2c, mode, args.kernel_buffer_size);
+
+    int pipefd_c2s[2];
+    create_pipe(pipefd_c2s, mode, args.kernel_buffer_size);
+
+    // Created before the fork so the parent and child share the channels
+    ReadyBarrier barrier(ReadyBarrier::Role::LAUNCHER);
+
     pid_t pid = fork();
     if (pid < 0)
     {
@@ -115,15 +228,13 @@ int main(int argc, char *argv[])
 
     if (pid == 0)
     {
-        // Allow time for the server to start first
-        std::this_thread::sleep_for(std::chrono::milliseconds(500));
         // Child process
-        start_child(pipefd_s2c, pipefd_c2s, args.message_size, args.iterations);
+        start_child(pipefd_s2c, pipefd_c2s, args, barrier);
     }
     else
     {
         // Parent process
-        start_parent(pipefd_s2c, pipefd_c2s, args.message_size, args.iterations);
+        start_parent(pipefd_s2c, pipefd_c2s, args, barrier);
     }
 
     return 0;
@@ -0,0 +1,315 @@
+#include "pipe_mode.hh"
+#include "payload.hh"
+#include "pipeline.hh"
+#include "utils.hh"
+
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+PipeMode parse_pipe_mode(const std::string &name)
+{
+    if (name == "copy")
+    {
+        return PipeMode::COPY;
+    }
+#ifdef __linux__
+    if (name == "vmsplice")
+    {
+        return PipeMode::VMSPLICE;
+    }
+    if (name == "packet")
+    {
+        return PipeMode::PACKET;
+    }
+#endif
+    std::cerr << "Unsupported pipe mode: " << name << " (vmsplice and packet are Linux only)" << std::endl;
+    exit(EXIT_FAILURE);
+}
+
+std::string pipe_name(const Args &args)
+{
+    if (args.pipe_mode == "copy" && args.kernel_buffer_size == 0)
+    {
+        return "pipe";
+    }
+    std::string name = "pipe (" + args.pipe_mode;
+    if (args.kernel_buffer_size != 0)
+    {
+        // No comma, the name is a field of the results CSV
+        name += " size=" + std::to_string(args.kernel_buffer_size);
+    }
+    return name + ")";
+}
+
+void create_pipe(int fds[2], PipeMode mode, size_t pipe_size)
+{
+#ifdef __linux__
+    // "O_DIRECT: Create a pipe that performs I/O in "packet" mode. Each write(2) to the pipe
+    // is dealt with as a separate packet, and read(2)s from the pipe will read one packet at a time."
+    // https://man7.org/linux/man-pages/man2/pipe.2.html
+    if (pipe2(fds, mode == PipeMode::PACKET ? O_DIRECT : 0) != 0)
+    {
+        report_and_exit("pipe2");
+    }
+    if (pipe_size != 0)
+    {
+        // Unprivileged processes are limited to `/proc/sys/fs/pipe-max-size`
+        if (fcntl(fds[1], F_SETPIPE_SZ, static_cast<int>(pipe_size)) == -1)
+        {
+            report_and_exit("fcntl F_SETPIPE_SZ");
+        }
+        std::cout << "Pipe size: " << fcntl(fds[1], F_GETPIPE_SZ) << std::endl;
+    }
+#else
+    (void)mode;
+    if (pipe(fds) != 0)
+    {
+        report_and_exit("pipe");
+    }
+    if (pipe_size != 0)
+    {
+        std::cerr << "Pipe sizes can only be set on Linux, using the default" << std::endl;
+    }
+#endif
+}
+
+size_t page_aligned_size(size_t size)
+{
+    size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    return (size + page_size - 1) / page_size * page_size;
+}
+
+char *alloc_pages(size_t size, size_t count, char fill)
+{
+    size_t total = page_aligned_size(size) * count;
+    void *pages = mmap(NULL, total, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (pages == MAP_FAILED)
+    {
+        report_and_exit("mmap");
+    }
+    memset(pages, fill, total);
+    return static_cast<char *>(pages);
+}
+
+void free_pages(char *pages, size_t size, size_t count)
+{
+    munmap(pages, page_aligned_size(size) * count);
+}
+
+#ifdef __linux__
+
+void vmsplice_full(int fd, const char *buf, size_t size)
+{
+    // A pipe holds only `F_GETPIPE_SZ` bytes, larger messages are mapped in as the reader drains it
+    while (size > 0)
+    {
+        struct iovec iov = {const_cast<char *>(buf), size};
+        ssize_t spliced = vmsplice(fd, &iov, 1, SPLICE_F_GIFT);
+        if (spliced < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            report_and_exit("vmsplice");
+        }
+        buf += spliced;
+        size -= spliced;
+    }
+}
+
+void splice_full(int from_fd, int to_fd, size_t size)
+{
+    while (size > 0)
+    {
+        ssize_t spliced = splice(from_fd, NULL, to_fd, NULL, size, SPLICE_F_MOVE);
+        if (spliced <= 0)
+        {
+            if (spliced < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            report_and_exit(spliced == 0 ? "splice: unexpected EOF" : "splice");
+        }
+        size -= spliced;
+    }
+}
+
+#else
+
+void vmsplice_full(int, const char *, size_t)
+{
+}
+
+void splice_full(int, int, size_t)
+{
+}
+
+#endif
+
+size_t read_next_packet(int fd, char *buf, size_t max_size)
+{
+    ssize_t bytes_read;
+    do
+    {
+        bytes_read = read(fd, buf, max_size);
+    } while (bytes_read == -1 && errno == EINTR);
+    if (bytes_read == -1)
+    {
+        report_and_exit("read");
+    }
+    return static_cast<size_t>(bytes_read);
+}
+
+void read_packet(int fd, char *buf, size_t size)
+{
+    size_t bytes_read = read_next_packet(fd, buf, size);
+    if (bytes_read != size)
+    {
+        std::cerr << "Read a " << bytes_read << " byte packet, expected " << size << std::endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
+// Opens the destination vmsplice receivers splice messages onward to
+static int open_splice_sink()
+{
+    int fd = open("/dev/null", O_WRONLY);
+    if (fd == -1)
+    {
+        report_and_exit("open /dev/null");
+    }
+    return fd;
+}
+
+PipeTransport::PipeTransport(IoEngine &engine, PipeMode mode, int send_fd, int recv_fd, size_t message_size,
+                             size_t num_send_buffers)
+    : engine(engine), mode(mode), send_fd(send_fd), recv_fd(recv_fd), message_size(message_size),
+      num_send_buffers(num_send_buffers), send_buffers(alloc_pages(message_size, num_send_buffers, 'a')),
+      recv_buf(alloc_pages(message_size, 1, 0)), sink_fd(mode == PipeMode::VMSPLICE ? open_splice_sink() : -1),
+      sent(0)
+{
+    engine.register_files({send_fd, recv_fd});
+    engine.register_buffers({{send_buffers, message_size}, {recv_buf, message_size}});
+}
+
+PipeTransport::~PipeTransport()
+{
+    if (sink_fd != -1)
+    {
+        close(sink_fd);
+    }
+    free_pages(send_buffers, message_size, num_send_buffers);
+    free_pages(recv_buf, message_size, 1);
+}
+
+char *PipeTransport::send_buffer()
+{
+    return send_buffers;
+}
+
+bool PipeTransport::payload_readable() const
+{
+    return mode != PipeMode::VMSPLICE;
+}
+
+void PipeTransport::send(const char *message, size_t size)
+{
+    if (mode == PipeMode::VMSPLICE)
+    {
+        // Every send buffer holds the same payload, a message from elsewhere is copied in
+        size_t stride = page_aligned_size(message_size);
+        char *buffer = send_buffers + (sent++ % num_send_buffers) * stride;
+        if (message < send_buffers || message >= send_buffers + num_send_buffers * stride)
+        {
+            memcpy(buffer, message, size);
+        }
+        vmsplice_full(send_fd, buffer, size);
+    }
+    else if (mode == PipeMode::PACKET)
+    {
+        // Each write of at most `PIPE_BUF` bytes is one packet
+        write_full(send_fd, message, size);
+    }
+    else
+    {
+        engine.write_full(send_fd, message, size);
+    }
+}
+
+const char *PipeTransport::recv(size_t size)
+{
+    if (mode == PipeMode::VMSPLICE)
+    {
+        // Pass the message onward without touching it
+        splice_full(recv_fd, sink_fd, size);
+        return send_buffers;
+    }
+    if (mode == PipeMode::PACKET)
+    {
+        read_packet(recv_fd, recv_buf, size);
+    }
+    else
+    {
+        // "If a process attempts to read from an empty pipe, then read(2)
+        // will block until data is available."
+        // https://man7.org/linux/man-pages/man7/pipe.7.html
+        engine.read_full(recv_fd, recv_buf, size);
+    }
+    return recv_buf;
+}
+
+const char *PipeTransport::recv_framed(size_t max_size)
+{
+    if (mode == PipeMode::PACKET)
+    {
+        size_t received = read_next_packet(recv_fd, recv_buf, max_size);
+        check_whole_frame(recv_buf, received, max_size);
+        return recv_buf;
+    }
+    // The header says how much of the frame is still to come
+    engine.read_full(recv_fd, recv_buf, FRAME_HEADER_SIZE);
+    size_t length = frame_length(recv_buf, max_size);
+    if (length > FRAME_HEADER_SIZE)
+    {
+        engine.read_full(recv_fd, recv_buf + FRAME_HEADER_SIZE, length - FRAME_HEADER_SIZE);
+    }
+    return recv_buf;
+}
+
+void PipeTransport::send_ack()
+{
+    engine.write_full(send_fd, recv_buf, ACK_SIZE);
+}
+
+void PipeTransport::recv_ack()
+{
+    engine.read_full(recv_fd, recv_buf, ACK_SIZE);
+}
+
+const char *PipeTransport::send_then_recv(const char *message, size_t size)
+{
+    if (mode == PipeMode::COPY)
+    {
+        engine.write_then_read(send_fd, message, size, recv_fd, recv_buf, size);
+        return recv_buf;
+    }
+    send(message, size);
+    return recv(size);
+}
+
+void PipeTransport::recv_then_echo(size_t size)
+{
+    if (mode == PipeMode::COPY)
+    {
+        engine.read_then_write(recv_fd, recv_buf, size, send_fd, recv_buf, size);
+        return;
+    }
+    send(recv(size), size);
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "args.hh"
+#include "io_engine.hh"
+
+#include <string>
+
+// How the pipe benchmark moves a message through a pipe, selected with `-k`
+enum class PipeMode
+{
+    // `write` copies the message into the pipe and `read` copies it out
+    COPY,
+    // The sender maps its (page aligned) buffer into the pipe with `vmsplice(SPLICE_F_GIFT)`
+    // and the receiver passes the pages onward with `splice`, so the payload is never copied
+    VMSPLICE,
+    // A packet mode pipe (`pipe2(O_DIRECT)`) where each `write` is read back as one packet,
+    // so messages keep their boundaries. Messages must fit in one packet (`PIPE_BUF`).
+    PACKET,
+};
+
+// Parses the `-k` option, `copy`, `vmsplice` or `packet`. Exits on unknown names, or on
+// vmsplice and packet modes on platforms other than Linux.
+PipeMode parse_pipe_mode(const std::string &name);
+
+// Report name, the mode and pipe size are appended when they are not the defaults
+std::string pipe_name(const Args &args);
+
+// Creates a pipe for `mode` in `fds` and sets its size to `pipe_size` unless 0
+void create_pipe(int fds[2], PipeMode mode, size_t pipe_size);
+
+// Allocates `count` page aligned buffers of `size` bytes each (rounded up to whole pages)
+// filled with `fill`, as `vmsplice(SPLICE_F_GIFT)` requires. Returns the first buffer,
+// the others follow every `page_aligned_size(size)` bytes. Release with `free_pages`.
+char *alloc_pages(size_t size, size_t count, char fill);
+void free_pages(char *pages, size_t size, size_t count);
+size_t page_aligned_size(size_t size);
+
+// Maps all of `buf` into the pipe `fd` with `vmsplice`. The pages are gifted, so `buf`
+// must not be modified until the reader has consumed the message.
+void vmsplice_full(int fd, const char *buf, size_t size);
+
+// Moves `size` bytes from the pipe `from_fd` to `to_fd` with `splice`
+void splice_full(int from_fd, int to_fd, size_t size);
+
+// Reads one packet of at most `max_size` bytes from a packet mode pipe, returns its size
+size_t read_next_packet(int fd, char *buf, size_t max_size);
+
+// Reads one packet of exactly `size` bytes from a packet mode pipe
+void read_packet(int fd, char *buf, size_t size);
+
+// One process's ends of the two pipes as a `Transport`, moving messages as `mode` says.
+// Owns page aligned buffers, which it registers with `engine`: `num_send_buffers` to send
+// from and one to receive into.
+//
+// In vmsplice mode sends gift the send buffers in turn, so one is only rewritten after
+// `num_send_buffers` further sends, and a received message is spliced on to `/dev/null`
+// unread. Its payload is then stood in for by the first send buffer, which is what `recv`
+// returns, so an echo gifts pages without copying either.
+class PipeTransport
+{
+    IoEngine &engine;
+    PipeMode mode;
+    int send_fd;
+    int recv_fd;
+    size_t message_size;
+    size_t num_send_buffers;
+    char *send_buffers;
+    char *recv_buf;
+    // Destination of spliced messages in vmsplice mode, -1 otherwise
+    int sink_fd;
+    ull sent;
+
+public:
+    PipeTransport(IoEngine &engine, PipeMode mode, int send_fd, int recv_fd, size_t message_size,
+                  size_t num_send_buffers);
+    ~PipeTransport();
+
+    PipeTransport(const PipeTransport &) = delete;
+    PipeTransport &operator=(const PipeTransport &) = delete;
+
+    char *send_buffer();
+    // Not in vmsplice mode, which gifts the send buffers and splices received messages away
+    bool payload_readable() const;
+    void send(const char *message, size_t size);
+    const char *recv(size_t size);
+    // Not in vmsplice mode, whose messages are spliced away unread
+    const char *recv_framed(size_t max_size);
+    // Acks are copied in every mode, a byte is not worth gifting a page for
+    void send_ack();
+    void recv_ack();
+    // Linked io_uring submissions in copy mode, a send and a receive otherwise
+    const char *send_then_recv(const char *message, size_t size);
+    void recv_then_echo(size_t size);
+};
@@ -0,0 +1,31 @@
+#include "posix_mq.hh"
+#include "args.hh"
+#include "utils.hh"
+#include "barrier.hh"
+#include "pipeline.hh"
+#include "fan_in.hh"
+#include "driver.hh"
+
+#include <iostream>
+
+int main(int argc, char *argv[])
+{
+    std::cout << "Launching client" << std::endl;
+    Args args = parse_args(argc, argv);
+    ReadyBarrier barrier(ReadyBarrier::Role::CLIENT);
+    // Wait until the server has created the queues
+    barrier.wait_until_notify();
+
+    // A fan-in client shares the client to server queue and is answered on its own queue
+    PosixMqManager mq_server_client(is_fan_in(args) ? posix_mq_reply_queue(args.client_id) : POSIX_MQ_SERVER_CLIENT,
+                                    args);
+    mq_server_client.open_queue(true);
+    PosixMqManager mq_client_server(POSIX_MQ_CLIENT_SERVER, args);
+    mq_client_server.open_queue(false);
+    PosixMqTransport transport(mq_client_server, mq_server_client, args.message_size);
+
+    // Indicate to server client is ready
+    barrier.notify();
+    run_client(args, transport);
+    return 0;
+}
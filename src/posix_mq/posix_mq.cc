@@ -0,0 +1,233 @@
+#include "posix_mq.hh"
+#include "utils.hh"
+
+#include <cerrno>
+#include <csignal>
+#include <ctime>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <poll.h>
+
+// Signal `mq_notify` raises, blocked in NOTIFY receivers and consumed with `sigwait`
+constexpr int POSIX_MQ_NOTIFY_SIGNAL = SIGUSR1;
+
+MqWait parse_mq_wait(const std::string &name)
+{
+    if (name == "block")
+    {
+        return MqWait::BLOCK;
+    }
+    if (name == "timed")
+    {
+        return MqWait::TIMED;
+    }
+#ifdef __linux__
+    // Only Linux implements the queue descriptor as a file descriptor which can be polled
+    if (name == "poll")
+    {
+        return MqWait::POLL;
+    }
+#endif
+    if (name == "notify")
+    {
+        return MqWait::NOTIFY;
+    }
+    std::cerr << "Unsupported POSIX queue wait mode: " << name << " (poll is Linux only)" << std::endl;
+    exit(EXIT_FAILURE);
+}
+
+std::string posix_mq_name(const Args &args)
+{
+    if (args.mq_wait == "block")
+    {
+        return "posix_mq";
+    }
+    return "posix_mq (" + args.mq_wait + ")";
+}
+
+std::string posix_mq_reply_queue(ull client)
+{
+    return POSIX_MQ_SERVER_CLIENT + std::string("_") + std::to_string(client);
+}
+
+// Reads one of the `/proc/sys/fs/mqueue` limits, `fallback` if it is not available
+static long read_mq_limit(const char *path, long fallback)
+{
+    std::ifstream file(path);
+    long limit;
+    if (!(file >> limit))
+    {
+        return fallback;
+    }
+    return limit;
+}
+
+static sigset_t notify_sigset()
+{
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, POSIX_MQ_NOTIFY_SIGNAL);
+    return set;
+}
+
+PosixMqManager::PosixMqManager(const std::string &queue_name, const Args &args)
+    : queue_name(queue_name), message_size(args.message_size), wait(parse_mq_wait(args.mq_wait)),
+      mqd(static_cast<mqd_t>(-1)), created(false), notify_registered(false)
+{
+}
+
+PosixMqManager::~PosixMqManager()
+{
+    if (mqd != static_cast<mqd_t>(-1))
+    {
+        mq_close(mqd);
+    }
+    // The name is removed immediately, the queue itself once the peer closed it too
+    if (created)
+    {
+        mq_unlink(queue_name.c_str());
+    }
+}
+
+void PosixMqManager::open_mqd(int flags, bool receiver, struct mq_attr *attr)
+{
+    flags |= receiver ? O_RDONLY : O_WRONLY;
+    if (receiver && (wait == MqWait::POLL || wait == MqWait::NOTIFY))
+    {
+        flags |= O_NONBLOCK;
+    }
+    if (receiver && wait == MqWait::NOTIFY)
+    {
+        // Blocked so the notification stays pending until `sigwait` consumes it
+        sigset_t set = notify_sigset();
+        sigprocmask(SIG_BLOCK, &set, NULL);
+    }
+    mqd = mq_open(queue_name.c_str(), flags, 0666, attr);
+    if (mqd == static_cast<mqd_t>(-1))
+    {
+        if (errno == EINVAL && attr != NULL)
+        {
+            std::cerr << "mq_open rejected a queue of " << attr->mq_maxmsg << " messages of " << attr->mq_msgsize
+                      << " bytes, the unprivileged limits are in " << POSIX_MQ_MSG_MAX_PATH << " and "
+                      << POSIX_MQ_MSGSIZE_MAX_PATH << std::endl;
+        }
+        report_and_exit("mq_open");
+    }
+}
+
+void PosixMqManager::create_queue(bool receiver)
+{
+    // Remove a queue left behind by an earlier run, its attributes may not match
+    mq_unlink(queue_name.c_str());
+    struct mq_attr attr = {};
+    // The largest queue allowed without privileges, a full queue blocks the sender as
+    // `msgsnd` does, which bounds the window
+    attr.mq_maxmsg = read_mq_limit(POSIX_MQ_MSG_MAX_PATH, 10);
+    attr.mq_msgsize = static_cast<long>(message_size);
+    open_mqd(O_CREAT | O_EXCL, receiver, &attr);
+    created = true;
+}
+
+void PosixMqManager::open_queue(bool receiver)
+{
+    open_mqd(0, receiver, NULL);
+}
+
+void PosixMqManager::send(const char *buf, size_t size)
+{
+    // All messages share priority 0, so the queue is FIFO as the System V queue
+    while (mq_send(mqd, buf, size, 0) == -1)
+    {
+        if (errno != EINTR)
+        {
+            report_and_exit("mq_send");
+        }
+    }
+}
+
+void PosixMqManager::wait_for_message()
+{
+    switch (wait)
+    {
+    case MqWait::POLL:
+    {
+#ifdef __linux__
+        struct pollfd pfd = {mqd, POLLIN, 0};
+        if (poll(&pfd, 1, -1) == -1 && errno != EINTR)
+        {
+            report_and_exit("poll");
+        }
+#endif
+        break;
+    }
+    case MqWait::NOTIFY:
+    {
+        if (!notify_registered)
+        {
+            // A registration only fires when a message arrives in the empty queue, so the
+            // caller retries the receive once more before waiting for the signal
+            struct sigevent sev = {};
+            sev.sigev_notify = SIGEV_SIGNAL;
+            sev.sigev_signo = POSIX_MQ_NOTIFY_SIGNAL;
+            if (mq_notify(mqd, &sev) == -1)
+            {
+                report_and_exit("mq_notify");
+            }
+            notify_registered = true;
+            break;
+        }
+        // The notification removes the registration. A stale signal (from a message which
+        // was received before waiting) only causes one more receive attempt.
+        sigset_t set = notify_sigset();
+        int sig;
+        if (sigwait(&set, &sig) != 0)
+        {
+            report_and_exit("sigwait");
+        }
+        notify_registered = false;
+        break;
+    }
+    case MqWait::BLOCK:
+    case MqWait::TIMED:
+        break;
+    }
+}
+
+size_t PosixMqManager::receive(char *buf)
+{
+    while (true)
+    {
+        ssize_t size;
+        if (wait == MqWait::TIMED)
+        {
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_sec += POSIX_MQ_TIMEOUT_SEC;
+            size = mq_timedreceive(mqd, buf, message_size, NULL, &deadline);
+        }
+        else
+        {
+            size = mq_receive(mqd, buf, message_size, NULL);
+        }
+        if (size >= 0)
+        {
+            return static_cast<size_t>(size);
+        }
+        if (errno == EINTR)
+        {
+            continue;
+        }
+        if (errno == EAGAIN)
+        {
+            wait_for_message();
+            continue;
+        }
+        if (errno == ETIMEDOUT)
+        {
+            std::cerr << "No message within " << POSIX_MQ_TIMEOUT_SEC << " seconds, the peer has stalled" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        report_and_exit("mq_receive");
+    }
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+#include "args.hh"
+#include "fan_in.hh"
+#include "payload.hh"
+
+#include <mqueue.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+// One queue per direction, as the System V benchmark. Names must start with a slash and
+// contain no other slashes, the queues appear under `/dev/mqueue` on Linux.
+// Server -> Client
+constexpr const char *POSIX_MQ_SERVER_CLIENT = "/ipc_bench_mq_server_client";
+// Client -> Server
+constexpr const char *POSIX_MQ_CLIENT_SERVER = "/ipc_bench_mq_client_server";
+
+// Unprivileged limits on the number of messages and the message size of a queue
+constexpr const char *POSIX_MQ_MSG_MAX_PATH = "/proc/sys/fs/mqueue/msg_max";
+constexpr const char *POSIX_MQ_MSGSIZE_MAX_PATH = "/proc/sys/fs/mqueue/msgsize_max";
+
+// A timed receive which does not complete within this many seconds means the peer died
+constexpr long POSIX_MQ_TIMEOUT_SEC = 10;
+
+// How a receiver waits for the next message, selected with `-q`
+enum class MqWait
+{
+    // Blocking `mq_receive`
+    BLOCK,
+    // `mq_timedreceive` with a deadline, as a receiver which must notice a stalled peer would
+    TIMED,
+    // Non-blocking queue, `poll` on the queue descriptor until it is readable
+    POLL,
+    // Non-blocking queue, `mq_notify` delivers a signal when the empty queue receives a message
+    NOTIFY,
+};
+
+// Parses the `-q` option, `block`, `timed`, `poll` or `notify`. Exits on unknown names.
+MqWait parse_mq_wait(const std::string &name);
+
+// Report name, the wait mode is appended unless it is the default `block`
+std::string posix_mq_name(const Args &args);
+
+// Queue of the server's replies to fan-in client `client`
+std::string posix_mq_reply_queue(ull client);
+
+// One end of a POSIX message queue. The server creates both queues and the client opens
+// them, each process only sends or only receives on a given `PosixMqManager`.
+class PosixMqManager
+{
+    const std::string queue_name;
+    const size_t message_size;
+    const MqWait wait;
+    mqd_t mqd;
+    // Whether this end created the queue and unlinks it on destruction
+    bool created;
+    // Whether an `mq_notify` registration is outstanding (NOTIFY receivers only)
+    bool notify_registered;
+
+    // Opens the queue with `flags`, non-blocking for POLL and NOTIFY receivers
+    void open_mqd(int flags, bool receiver, struct mq_attr *attr);
+    // Blocks until the non-blocking queue may hold a message
+    void wait_for_message();
+
+public:
+    PosixMqManager(const std::string &queue_name, const Args &args);
+    ~PosixMqManager();
+
+    PosixMqManager(const PosixMqManager &) = delete;
+    PosixMqManager &operator=(const PosixMqManager &) = delete;
+
+    // Creates the queue (server side), replacing a stale queue of the same name. The queue
+    // holds `msg_max` messages of up to `message_size` bytes, a full queue blocks the sender.
+    void create_queue(bool receiver);
+    // Opens the queue created by the peer (client side)
+    void open_queue(bool receiver);
+
+    void send(const char *buf, size_t size);
+    // Receives the next message into `buf` (at least `message_size` bytes) and returns its size
+    size_t receive(char *buf);
+};
+
+// One side's pair of queues as a `Transport`, messages are sent on `sender` and received
+// from `receiver`
+class PosixMqTransport
+{
+    PosixMqManager &sender;
+    PosixMqManager &receiver;
+    std::vector<char> buffer;
+
+public:
+    PosixMqTransport(PosixMqManager &sender, PosixMqManager &receiver, size_t message_size)
+        : sender(sender), receiver(receiver), buffer(message_size)
+    {
+    }
+
+    void send(const char *message, size_t size)
+    {
+        // Blocks while the queue is full, which bounds the window by the queue capacity
+        sender.send(message, size);
+    }
+
+    const char *recv(size_t)
+    {
+        // A message is received whole, or not at all
+        receiver.receive(buffer.data());
+        return buffer.data();
+    }
+
+    const char *recv_framed(size_t max_size)
+    {
+        size_t received = receiver.receive(buffer.data());
+        check_whole_frame(buffer.data(), received, max_size);
+        return buffer.data();
+    }
+};
+
+// Fan-in server: every client sends to `requests` and is answered on its own queue
+class PosixMqFanIn
+{
+    PosixMqManager &requests;
+    std::vector<std::unique_ptr<PosixMqManager>> &replies;
+    std::vector<char> buffer;
+
+public:
+    PosixMqFanIn(PosixMqManager &requests, std::vector<std::unique_ptr<PosixMqManager>> &replies,
+                 size_t message_size)
+        : requests(requests), replies(replies), buffer(message_size)
+    {
+    }
+
+    const char *recv_any(size_t, size_t &source)
+    {
+        requests.receive(buffer.data());
+        source = fan_in_sender(buffer.data());
+        return buffer.data();
+    }
+
+    void reply(size_t source, const char *message, size_t size)
+    {
+        replies[source]->send(message, size);
+    }
+};
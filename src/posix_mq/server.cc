@@ -0,0 +1,57 @@
+#include "posix_mq.hh"
+#include "args.hh"
+#include "utils.hh"
+#include "barrier.hh"
+#include "bench.hh"
+#include "pipeline.hh"
+#include "fan_in.hh"
+#include "driver.hh"
+
+#include <iostream>
+#include <memory>
+#include <vector>
+
+// Every client sends to the one client to server queue and is answered on its own queue
+static int serve_fan_in(const Args &args, ReadyBarrier &barrier)
+{
+    FanInServer server(fan_in_name(posix_mq_name(args), args), args);
+    PosixMqManager mq_client_server(POSIX_MQ_CLIENT_SERVER, args);
+    mq_client_server.create_queue(true);
+    std::vector<std::unique_ptr<PosixMqManager>> reply_queues;
+    for (ull client = 0; client < args.fan_in; client++)
+    {
+        reply_queues.push_back(std::make_unique<PosixMqManager>(posix_mq_reply_queue(client), args));
+        reply_queues.back()->create_queue(false);
+    }
+    PosixMqFanIn transport(mq_client_server, reply_queues, args.message_size);
+
+    barrier.notify(args.fan_in);
+    barrier.wait_until_notify(args.fan_in);
+    run_fan_in_server(server, args, transport);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    std::cout << "Launching server" << std::endl;
+    Args args = parse_args(argc, argv);
+    ReadyBarrier barrier(ReadyBarrier::Role::SERVER);
+    if (is_fan_in(args))
+    {
+        return serve_fan_in(args, barrier);
+    }
+    Benchmarks benchmarks(pipelined_name(posix_mq_name(args), args), args);
+
+    // The server creates both queues so the client only has to open them
+    PosixMqManager mq_server_client(POSIX_MQ_SERVER_CLIENT, args);
+    mq_server_client.create_queue(false);
+    PosixMqManager mq_client_server(POSIX_MQ_CLIENT_SERVER, args);
+    mq_client_server.create_queue(true);
+    PosixMqTransport transport(mq_server_client, mq_client_server, args.message_size);
+
+    // Queues exist, let the client open them and wait until it has
+    barrier.notify();
+    barrier.wait_until_notify();
+    run_server(benchmarks, args, transport);
+    return 0;
+}
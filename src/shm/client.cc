@@ -1,12 +1,13 @@
 #include "shm.hh"
 #include "args.hh"
-#include "signals.hh"
+#include "barrier.hh"
+#include "bench.hh"
+#include "pipeline.hh"
+#include "fan_in.hh"
+#include "driver.hh"
 
 #include <iostream>
-#include <sys/mman.h>
-#include <sys/stat.h> /* For mode constants */
-#include <fcntl.h>    /* For O_* constants */
-#include <vector>
+#include <string>
 
 int main(int argc, char *argv[])
 {
@@ -14,38 +15,27 @@ int main(int argc, char *argv[])
     try
     {
         Args args = parse_args(argc, argv);
-        ShmManager shm_s2c(args, SHM_NAME_S2C);
-        shm_s2c.init_shm();
-        ShmManager shm_c2s(args, SHM_NAME_C2S);
-        shm_c2s.init_shm();
-
-        SignalManager signal_manager(SignalManager::SignalTarget::CLIENT);
-
-        // Precompute all messages to avoid overhead during the benchmark.
-        std::vector<std::string> messages;
-        messages.reserve(args.iterations);
-        for (ull i = 0; i < args.iterations; i++)
+        if (is_fan_in(args))
         {
-            std::string number = std::to_string(i);
-            // Create a string of the desired size filled with spaces
-            std::string message(args.message_size, '.');
-            std::copy(number.begin(), number.end(), message.begin());
-            messages.push_back(message);
+            check_fan_in_wait_strategy(args);
         }
+        ReadyBarrier barrier(ReadyBarrier::Role::CLIENT);
+        // Wait until the server has created and initialized the segments
+        barrier.wait_until_notify();
+        // Every fan-in client has a ring pair of its own
+        std::string name_s2c =
+            is_fan_in(args) ? fan_in_shm_name(SHM_NAME_S2C, args.client_id) : std::string(SHM_NAME_S2C);
+        std::string name_c2s =
+            is_fan_in(args) ? fan_in_shm_name(SHM_NAME_C2S, args.client_id) : std::string(SHM_NAME_C2S);
+        ShmManager shm_s2c(args, name_s2c);
+        shm_s2c.open_shm();
+        ShmManager shm_c2s(args, name_c2s);
+        shm_c2s.open_shm();
+        ShmTransport transport(shm_c2s, shm_s2c, args.message_size);
 
         // Indicate to server client is ready
-        signal_manager.notify();
-        for (ull i = 0; i < args.iterations; i++)
-        {
-            std::string_view message = messages[i];
-            // std::cout << "Client iteration i: " << i << std::endl;
-            while (!shm_s2c.read_shm_until(message))
-            {
-                // Wait until server has written message
-                // std::cout << "Waiting for server to write message" << std::endl;
-            }
-            shm_c2s.write_shm(message);
-        }
+        barrier.notify();
+        run_client(args, transport);
     }
     catch (const std::exception &e)
     {
@@ -56,4 +46,4 @@ int main(int argc, char *argv[])
     }
 
     return 0;
-}
\ No newline at end of file
+}
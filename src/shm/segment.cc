@@ -0,0 +1,211 @@
+#include "segment.hh"
+
+#include <sys/mman.h>
+#include <sys/stat.h> /* For mode constants */
+#include <sys/vfs.h>
+#include <fcntl.h> /* For O_* constants */
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+ShmSegmentOptions shm_segment_options(const Args &args)
+{
+    // The names are validated by `parse_args`
+    ShmSegmentOptions options;
+    options.backing = args.shm_backing == "hugetlb" ? ShmBacking::HUGETLB
+                      : args.shm_backing == "thp"   ? ShmBacking::THP
+                                                    : ShmBacking::SHM;
+    options.prefault = args.shm_prefault == "populate" ? ShmPrefault::POPULATE
+                       : args.shm_prefault == "touch"  ? ShmPrefault::TOUCH
+                                                       : ShmPrefault::NONE;
+    options.lock = args.shm_lock;
+    return options;
+}
+
+std::string shm_segment_label(const Args &args)
+{
+    std::string label;
+    if (args.shm_backing != "shm")
+    {
+        label += " " + args.shm_backing;
+    }
+    if (args.shm_prefault != "none")
+    {
+        label += " " + args.shm_prefault;
+    }
+    if (args.shm_lock)
+    {
+        label += " mlock";
+    }
+    return label;
+}
+
+// Mount point of hugetlbfs
+static std::string hugetlbfs_mount()
+{
+    const char *path = getenv(HUGETLBFS_PATH_ENV);
+    return path != nullptr && path[0] != '\0' ? path : HUGETLBFS_DEFAULT_PATH;
+}
+
+ShmSegment::ShmSegment(std::string_view name, const ShmSegmentOptions &options)
+    : name(name), options(options), ptr(nullptr), size(0)
+{
+}
+
+// Does not throw exceptions, as `~ShmManager`
+ShmSegment::~ShmSegment()
+{
+    if (ptr != nullptr && munmap(ptr, size) == -1)
+    {
+        std::cerr << "munmap failed" << std::endl;
+    }
+}
+
+std::string ShmSegment::hugetlbfs_path() const
+{
+    // Shared memory names start with a slash
+    return hugetlbfs_mount() + name;
+}
+
+void ShmSegment::map(size_t min_size, bool create)
+{
+    int flags = O_RDWR | (create ? O_CREAT | O_EXCL : 0);
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    int fd;
+    if (options.backing == ShmBacking::HUGETLB)
+    {
+        std::string path = hugetlbfs_path();
+        fd = open(path.c_str(), flags, 0666);
+        if (fd == -1)
+        {
+            perror(path.c_str());
+            throw std::runtime_error("Cannot open " + path + ", is hugetlbfs mounted at " + hugetlbfs_mount() +
+                                     "? Set " + HUGETLBFS_PATH_ENV + " to its mount point");
+        }
+        // Files on hugetlbfs are sized and mapped in whole huge pages
+        struct statfs fs;
+        if (fstatfs(fd, &fs) == -1)
+        {
+            close(fd);
+            perror("fstatfs");
+            throw std::runtime_error("fstatfs failed");
+        }
+        page_size = fs.f_bsize;
+    }
+    else
+    {
+        fd = shm_open(name.c_str(), flags, 0666);
+        if (fd == -1)
+        {
+            perror("shm_open");
+            throw std::runtime_error("shm_open failed");
+        }
+    }
+    size_t expected_size = (min_size + page_size - 1) / page_size * page_size;
+
+    // Only the creator sizes the segment, `ftruncate` of one already sized may fail with EINVAL
+    // https://stackoverflow.com/questions/20320742/ftruncate-failed-at-the-second-time
+    if (create && ftruncate(fd, expected_size) == -1)
+    {
+        close(fd);
+        perror("ftruncate");
+        throw std::runtime_error("ftruncate failed");
+    }
+    struct stat sb;
+    if (fstat(fd, &sb) == -1)
+    {
+        close(fd);
+        perror("fstat");
+        throw std::runtime_error("fstat failed");
+    }
+    if (sb.st_size != static_cast<off_t>(expected_size))
+    {
+        close(fd);
+        throw std::runtime_error("Segment " + name + " is " + std::to_string(sb.st_size) + " bytes instead of " +
+                                 std::to_string(expected_size) +
+                                 ", the peers disagree on the message size or the number of clients");
+    }
+
+    // THP has to be enabled on the mapping before its pages are faulted in, so it is
+    // populated with `madvise` instead of `MAP_POPULATE`
+    bool map_populate = options.prefault == ShmPrefault::POPULATE && options.backing != ShmBacking::THP;
+    void *mapped = mmap(nullptr, expected_size, PROT_READ | PROT_WRITE, MAP_SHARED | (map_populate ? MAP_POPULATE : 0),
+                        fd, 0);
+    // "After the mmap() call has returned, the file descriptor, fd, can
+    // be closed immediately without invalidating the mapping."
+    // https://man7.org/linux/man-pages/man2/mmap.2.html
+    close(fd);
+    if (mapped == MAP_FAILED)
+    {
+        int error = errno;
+        perror("mmap");
+        if (options.backing == ShmBacking::HUGETLB && error == ENOMEM)
+        {
+            throw std::runtime_error("Not enough free huge pages for " + std::to_string(expected_size) +
+                                     " bytes, reserve more in /proc/sys/vm/nr_hugepages");
+        }
+        throw std::runtime_error("mmap failed");
+    }
+    ptr = static_cast<char *>(mapped);
+    size = expected_size;
+
+    if (options.backing == ShmBacking::THP)
+    {
+        // Only takes effect if `/sys/kernel/mm/transparent_hugepage/shmem_enabled` is `advise`
+        // or `always`, otherwise the segment silently stays on base pages
+        if (madvise(ptr, size, MADV_HUGEPAGE) == -1)
+        {
+            perror("madvise(MADV_HUGEPAGE)");
+            throw std::runtime_error("madvise failed");
+        }
+        if (options.prefault == ShmPrefault::POPULATE && madvise(ptr, size, MADV_POPULATE_WRITE) == -1)
+        {
+            perror("madvise(MADV_POPULATE_WRITE)");
+            throw std::runtime_error("madvise failed");
+        }
+    }
+    if (options.prefault == ShmPrefault::TOUCH)
+    {
+        // Writes back the byte already there, as the peer may have initialized the segment.
+        // Both peers map their segments before the barrier releases the timed loop, so
+        // nothing else writes to it yet.
+        volatile char *pages = ptr;
+        for (size_t offset = 0; offset < size; offset += page_size)
+        {
+            pages[offset] = pages[offset];
+        }
+    }
+    if (options.lock && mlock(ptr, size) == -1)
+    {
+        perror("mlock");
+        throw std::runtime_error("mlock of " + std::to_string(size) +
+                                 " bytes failed, raise the locked memory limit (ulimit -l)");
+    }
+}
+
+void ShmSegment::unlink() const
+{
+    // Fails if the peer already unlinked the segment
+    if (options.backing == ShmBacking::HUGETLB)
+    {
+        ::unlink(hugetlbfs_path().c_str());
+    }
+    else
+    {
+        shm_unlink(name.c_str());
+    }
+}
+
+char *ShmSegment::data() const
+{
+    return ptr;
+}
+
+size_t ShmSegment::get_size() const
+{
+    return size;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "args.hh"
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// Default mount point of hugetlbfs, overridden with the `IPC_BENCH_HUGETLBFS` environment
+// variable
+constexpr const char *HUGETLBFS_DEFAULT_PATH = "/dev/hugepages";
+constexpr const char *HUGETLBFS_PATH_ENV = "IPC_BENCH_HUGETLBFS";
+
+// What backs a shared memory segment
+enum class ShmBacking
+{
+    // `shm_open` on tmpfs, base pages
+    SHM,
+    // `shm_open` with `madvise(MADV_HUGEPAGE)`, which uses transparent huge pages if
+    // `/sys/kernel/mm/transparent_hugepage/shmem_enabled` allows it (`advise` or `always`)
+    THP,
+    // A file on hugetlbfs, reserved huge pages which are never split or swapped
+    HUGETLB,
+};
+
+// How a segment is faulted in before the timed loop
+enum class ShmPrefault
+{
+    // Pages are faulted in by the first lap of the ring, inside the timed loop
+    NONE,
+    // `MAP_POPULATE` faults in every page when the segment is mapped
+    POPULATE,
+    // Every page is written once after mapping
+    TOUCH,
+};
+
+// How the segments of a shm benchmark are backed and mapped (`-u`, `-y` and `-l`)
+struct ShmSegmentOptions
+{
+    ShmBacking backing;
+    ShmPrefault prefault;
+    // `mlock` the mapping, which also faults it in
+    bool lock;
+};
+
+ShmSegmentOptions shm_segment_options(const Args &args);
+
+// Words appended to a report name for the non default options, e.g. ` hugetlb populate`
+std::string shm_segment_label(const Args &args);
+
+// A named segment mapped into this process. Both peers map the same `name` with the same
+// options: one of them (the server or writer) unlinks any stale segment and creates it, the
+// other opens it once told the segment exists.
+class ShmSegment
+{
+    const std::string name;
+    const ShmSegmentOptions options;
+    char *ptr;
+    // Mapped size, rounded up to the huge page size for hugetlbfs
+    size_t size;
+
+    // Path of the hugetlbfs file backing `name`
+    std::string hugetlbfs_path() const;
+
+public:
+    ShmSegment(std::string_view name, const ShmSegmentOptions &options);
+    // Unmaps the segment, does not unlink it
+    ~ShmSegment();
+
+    ShmSegment(const ShmSegment &) = delete;
+    ShmSegment &operator=(const ShmSegment &) = delete;
+
+    // Creates the segment if `create` (with `O_EXCL`, so it starts zeroed) and sizes it to at
+    // least `min_size` bytes, otherwise opens the existing one and checks its size. Then maps,
+    // prefaults and locks it as the options ask. Throws `std::runtime_error` on failure.
+    void map(size_t min_size, bool create);
+    // Removes the name, the memory is freed once every peer unmapped it. Never throws.
+    void unlink() const;
+
+    char *data() const;
+    size_t get_size() const;
+};
@@ -1,56 +1,72 @@
 #include "shm.hh"
 #include "args.hh"
-#include "signals.hh"
+#include "barrier.hh"
 #include "bench.hh"
+#include "pipeline.hh"
+#include "fan_in.hh"
+#include "driver.hh"
 
-#include <sys/mman.h>
-#include <sys/stat.h> /* For mode constants */
-#include <fcntl.h>    /* For O_* constants */
+#include <memory>
 #include <vector>
 
+// Polls the ring of every client in turn and answers each on its own ring
+static int serve_fan_in(const Args &args, ReadyBarrier &barrier)
+{
+    check_fan_in_wait_strategy(args);
+    std::vector<std::unique_ptr<ShmManager>> rings_s2c;
+    std::vector<std::unique_ptr<ShmManager>> rings_c2s;
+    std::vector<ShmTransport> endpoints;
+    for (ull client = 0; client < args.fan_in; client++)
+    {
+        rings_s2c.push_back(std::make_unique<ShmManager>(args, fan_in_shm_name(SHM_NAME_S2C, client)));
+        rings_s2c.back()->create_shm();
+        rings_c2s.push_back(std::make_unique<ShmManager>(args, fan_in_shm_name(SHM_NAME_C2S, client)));
+        rings_c2s.back()->create_shm();
+        endpoints.emplace_back(*rings_s2c.back(), *rings_c2s.back(), args.message_size);
+    }
+    WaitStrategy strategy = rings_c2s.front()->get_wait_strategy();
+    FanInServer server(
+        fan_in_name(std::string("shm (") + wait_strategy_name(strategy) + shm_segment_label(args) + ")", args), args);
+    PolledFanIn transport(endpoints, [strategy]
+                          { poll_wait(strategy); });
+
+    barrier.notify(args.fan_in);
+    barrier.wait_until_notify(args.fan_in);
+    run_fan_in_server(server, args, transport);
+    return 0;
+}
+
 int main(int argc, char *argv[])
 {
     try
     {
         Args args = parse_args(argc, argv);
         std::cout << "Launching server" << std::endl;
-        SignalManager signal_manager(SignalManager::SignalTarget::SERVER);
-        Benchmarks benchmarks(std::string("shm"), args.message_size);
-
+        ReadyBarrier barrier(ReadyBarrier::Role::SERVER);
+        if (is_fan_in(args))
+        {
+            return serve_fan_in(args, barrier);
+        }
         ShmManager shm_s2c(args, SHM_NAME_S2C);
-        shm_s2c.init_shm();
+        shm_s2c.create_shm();
+        // Each wait strategy and segment option is reported as its own benchmark
+        Benchmarks benchmarks(pipelined_name(std::string("shm (") + wait_strategy_name(shm_s2c.get_wait_strategy()) +
+                                                 shm_segment_label(args) + ")",
+                                             args),
+                              args);
+        // Report the first pass through the rings, which faults in their pages unless
+        // they were prefaulted, apart from the steady state
+        benchmarks.set_first_lap(SHM_NUM_MSG);
         std::cout << "SHM size: " << shm_s2c.get_shm_size() << std::endl;
         ShmManager shm_c2s(args, SHM_NAME_C2S);
-        shm_c2s.init_shm();
+        shm_c2s.create_shm();
+        // A window larger than `SHM_NUM_MSG` is bounded by the ring, `write_shm` waits for a free slot
+        ShmTransport transport(shm_s2c, shm_c2s, args.message_size);
 
-        // Precompute all messages to avoid overhead during the benchmark.
-        std::vector<std::string> messages;
-        messages.reserve(args.iterations);
-        for (ull i = 0; i < args.iterations; i++)
-        {
-            std::string number = std::to_string(i);
-            // Create a string of the desired size filled with spaces
-            std::string message(args.message_size, '.');
-            std::copy(number.begin(), number.end(), message.begin());
-            messages.push_back(message);
-        }
-
-        // Wait until client notifies that it is ready
-        signal_manager.wait_until_notify();
-        for (ull i = 0; i < args.iterations; i++)
-        {
-            std::string_view message = messages[i];
-            benchmarks.start_iteration();
-            // std::cout << "Server iteration: " << i << std::endl;
-            shm_s2c.write_shm(message);
-            while (!shm_c2s.read_shm_until(message))
-            {
-                // Wait until client has written its message
-                // std::cout << "Waiting for client to write message" << std::endl;
-            }
-            // Print all written shared memory
-            benchmarks.end_iteration(1);
-        }
+        // Segments are initialized, let the client map them and wait until it is ready
+        barrier.notify();
+        barrier.wait_until_notify();
+        run_server(benchmarks, args, transport);
         return 0;
     }
     catch (const std::exception &e)
@@ -61,4 +77,4 @@ int main(int argc, char *argv[])
         return 1;
     }
     return 0;
-}
\ No newline at end of file
+}
@@ -1,18 +1,33 @@
 #include "shm.hh"
 #include "args.hh"
+#include "payload.hh"
 #include "utils.hh"
 
-#include <sys/mman.h>
-#include <sys/stat.h> /* For mode constants */
-#include <fcntl.h>    /* For O_* constants */
+#include <sched.h>
 #include <algorithm>
 #include <string_view>
 #include <cassert>
 #include <stdexcept>
 
+std::string fan_in_shm_name(std::string_view shm_name, ull client)
+{
+    return std::string(shm_name) + "_" + std::to_string(client);
+}
+
+void check_fan_in_wait_strategy(const Args &args)
+{
+    if (wait_strategy_blocks(parse_wait_strategy(args.wait_strategy)))
+    {
+        throw std::invalid_argument("The fan-in server polls every client's ring, use the spin, pause or yield "
+                                    "wait strategy");
+    }
+}
+
 ShmManager::ShmManager(const Args &args, const std::string_view shm_name)
-    : shm_ptr(nullptr), write_offset(0), read_offset(0), shm_size(args.message_size * SHM_NUM_MSG),
-      message_size(args.message_size), shm_name(shm_name)
+    : segment(shm_name, shm_segment_options(args)), shm_ptr(nullptr), header(nullptr), slots(nullptr),
+      cached_tail(0), cached_head(0), shm_size(sizeof(ShmRingHeader) + args.message_size * SHM_NUM_MSG),
+      message_size(args.message_size), wait_strategy_arg(args.wait_strategy),
+      wait_strategy(WaitStrategy::SPIN)
 {
 }
 
@@ -26,129 +41,213 @@ ShmManager::~ShmManager()
     // object contents shall be postponed until all open and map references to the shared memory
     // object have been removed."
     // https://pubs.opengroup.org/onlinepubs/009695399/functions/shm_unlink.html
-    if (shm_unlink(shm_name.data()) == -1)
-    {
-        // `shm_unlink` can fail if the shared memory was already unlinked by the client/server
-        // std::cerr << "shm_unlink failed" << std::endl;
-    }
+    // `segment` unmaps itself after this, so the name is removed first
+    segment.unlink();
+}
+
+// This is not in the constructor so the constructor does not throw exceptions, which would
+// cause object construction to be incomplete and the destructor would not be called.
+void ShmManager::create_shm()
+{
+    wait_strategy = parse_wait_strategy(wait_strategy_arg);
+    // A stale segment of a run which died before unlinking it would hold that run's indices
+    segment.unlink();
+    segment.map(shm_size, true);
+    map_layout();
+}
+
+void ShmManager::open_shm()
+{
+    wait_strategy = parse_wait_strategy(wait_strategy_arg);
+    // Fails if the client disagrees with the server on the message size
+    segment.map(shm_size, false);
+    map_layout();
+}
+
+void ShmManager::map_layout()
+{
+    shm_ptr = segment.data();
+    // The header sits at the start of the page aligned mapping, so its indices are cache line aligned
+    header = reinterpret_cast<ShmRingHeader *>(shm_ptr);
+    slots = shm_ptr + sizeof(ShmRingHeader);
+    cached_tail = header->tail.load(std::memory_order_acquire);
+    cached_head = header->head.load(std::memory_order_acquire);
+}
+
+size_t ShmManager::get_shm_size() const
+{
+    return segment.get_size();
+}
 
-    // Can only unmap if the shared memory was successfully mapped
-    // This should be called after `shm_unlink` because the `mmap` occurs after
-    // the `shm_open` call in `init_shm`.
-    if (shm_ptr != nullptr)
+bool ShmManager::try_write_shm(const std::string_view message)
+{
+    ASSERT(message.size() <= message_size);
+    // Only the producer stores `head`, so a relaxed load of its own index is sufficient
+    ull head = header->head.load(std::memory_order_relaxed);
+    if (head - cached_tail == SHM_NUM_MSG)
     {
-        if (munmap(shm_ptr, shm_size) == -1)
+        // Acquire pairs with the consumer's release so its reads of the slot are complete
+        // before the slot is overwritten
+        cached_tail = header->tail.load(std::memory_order_acquire);
+        if (head - cached_tail == SHM_NUM_MSG)
         {
-            std::cerr << "munmap failed" << std::endl;
+            return false;
         }
     }
+    char *slot = slots + (head & (SHM_NUM_MSG - 1)) * message_size;
+    std::copy(message.begin(), message.end(), slot);
+    // Release publishes the slot contents before the new `head` is visible to the consumer
+    header->head.store(head + 1, std::memory_order_release);
+    return true;
 }
 
-// This is not in the constructor so the constructor does not throw exceptions, which would
-// cause object construction to be incomplete and the destructor would not be called.
-void ShmManager::init_shm()
+void ShmManager::futex_wait_for_space()
 {
-    int fd = shm_open(shm_name.data(), O_CREAT | O_RDWR, 0666);
-    if (fd == -1)
+    header->space_waiters.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    uint32_t seq = header->space_seq.load(std::memory_order_acquire);
+    // Recheck after registering as a waiter, the reader may have freed a slot before it saw us
+    if (header->head.load(std::memory_order_relaxed) - header->tail.load(std::memory_order_acquire) == SHM_NUM_MSG)
     {
-        std::cerr << "errno: " << errno << std::endl;
-        perror("shm_open");
-        throw std::runtime_error("shm_open failed");
+        // Returns immediately if the reader bumped `space_seq` after it was loaded
+        futex_wait(&header->space_seq, seq);
     }
-    if (ftruncate(fd, shm_size) == -1)
+    header->space_waiters.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void ShmManager::write_shm(const std::string_view message)
+{
+    // A writer which got `SHM_NUM_MSG` messages ahead (streaming and bulk mode) waits as the
+    // reader does, rather than spinning against a reader which may be asleep
+    unsigned int spins = 0;
+    while (!try_write_shm(message))
     {
-        // `ftruncate` on an already open file descriptor can fail with EINVAL
-        // https://stackoverflow.com/questions/20320742/ftruncate-failed-at-the-second-time
-        if (errno != EINVAL)
+        switch (wait_strategy)
         {
-            std::cerr << "errno: " << errno << std::endl;
-            std::cout << "fd: " << fd << ", shm_size: " << shm_size << std::endl;
-            perror("ftruncate");
-            throw std::runtime_error("ftruncate failed");
+        case WaitStrategy::SPIN:
+            break;
+        case WaitStrategy::PAUSE:
+            cpu_relax();
+            break;
+        case WaitStrategy::YIELD:
+            sched_yield();
+            break;
+        case WaitStrategy::SPIN_FUTEX:
+            if (spins < SPIN_LIMIT)
+            {
+                ++spins;
+                cpu_relax();
+                break;
+            }
+            futex_wait_for_space();
+            break;
+        case WaitStrategy::FUTEX:
+            futex_wait_for_space();
+            break;
         }
     }
-    struct stat sb;
-    if (fstat(fd, &sb) == -1)
+
+    if (wait_strategy_blocks(wait_strategy))
     {
-        close(fd);
-        std::cerr << "errno: " << errno << std::endl;
-        perror("fstat");
-        throw std::runtime_error("fstat failed");
+        // Orders the `head` store before the `futex_waiters` load. Pairs with the fence
+        // in `futex_wait_for_message` so either the reader sees the new `head` or the
+        // writer sees the waiter and wakes it.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (header->futex_waiters.load(std::memory_order_relaxed) != 0)
+        {
+            header->futex_seq.fetch_add(1, std::memory_order_release);
+            futex_wake(&header->futex_seq);
+        }
     }
+}
 
-    shm_ptr = (char *)mmap(NULL, shm_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
-    if (shm_ptr == MAP_FAILED)
+void ShmManager::wake_writer(ull tail)
+{
+    // Orders the `tail` store before the `space_waiters` load. Pairs with the fence in
+    // `futex_wait_for_space` so either the writer sees the new `tail` or the reader sees
+    // the waiter. A registered writer found the ring full, so `head` stays put and the
+    // reader gets to `SHM_WAKE_WRITER` unread messages before it runs dry.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (header->space_waiters.load(std::memory_order_relaxed) != 0 &&
+        header->head.load(std::memory_order_relaxed) - tail <= SHM_WAKE_WRITER)
     {
-        std::cerr << "errno: " << errno << std::endl;
-        perror("mmap");
-        throw std::runtime_error("mmap failed");
+        header->space_seq.fetch_add(1, std::memory_order_release);
+        futex_wake(&header->space_seq);
     }
-    write_offset = 0;
-    read_offset = 0;
-
-    // "After the mmap() call has returned, the file descriptor, fd, can
-    // be closed immediately without invalidating the mapping."
-    // https://man7.org/linux/man-pages/man2/mmap.2.html
-    close(fd);
 }
 
-size_t ShmManager::get_shm_size() const
+bool ShmManager::try_read_shm(char *dest, bool framed)
 {
-    int fd = shm_open(shm_name.data(), O_CREAT | O_RDWR, 0666);
-    if (fd == -1)
+    // Only the consumer stores `tail`, so a relaxed load of its own index is sufficient
+    ull tail = header->tail.load(std::memory_order_relaxed);
+    if (tail == cached_head)
     {
-        std::cerr << "errno: " << errno << std::endl;
-        perror("shm_open");
-        throw std::runtime_error("shm_open failed");
+        // Acquire pairs with the producer's release so the slot contents are visible
+        cached_head = header->head.load(std::memory_order_acquire);
+        if (tail == cached_head)
+        {
+            return false;
+        }
     }
-
-    struct stat sb;
-    if (fstat(fd, &sb) == -1)
+    const char *slot = slots + (tail & (SHM_NUM_MSG - 1)) * message_size;
+    // Only a frame's own bytes are copied, the rest of its slot is stale
+    size_t length = framed ? frame_length(slot, message_size) : message_size;
+    std::copy(slot, slot + length, dest);
+    // Release orders the copy out of the slot before the producer may reuse it
+    header->tail.store(tail + 1, std::memory_order_release);
+    if (wait_strategy_blocks(wait_strategy))
     {
-        close(fd);
-        std::cerr << "errno: " << errno << std::endl;
-        perror("fstat");
-        throw std::runtime_error("fstat failed");
+        wake_writer(tail + 1);
     }
-
-    close(fd);
-
-    // Sanity check: the fstat size should be the same as the `shm_size`
-    // used in the original `ftrucnate` call
-    ASSERT(sb.st_size == static_cast<long long>(shm_size));
-    return sb.st_size;
+    return true;
 }
 
-void ShmManager::write_shm(const std::string_view message)
+void ShmManager::futex_wait_for_message()
 {
-    ASSERT(message.size() == message_size);
-    std::copy(message.begin(), message.end(), shm_ptr + write_offset);
-    write_offset += message.size();
-    // More performant equivalent to `write_offset %= shm_size`
-    write_offset &= (shm_size - 1);
-    // std::cout << "Write ptr: " << (void *)shm_write_ptr << std::endl;
+    header->futex_waiters.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    uint32_t seq = header->futex_seq.load(std::memory_order_acquire);
+    // Recheck after registering as a waiter, the writer may have published before it saw us
+    if (header->head.load(std::memory_order_acquire) == header->tail.load(std::memory_order_relaxed))
+    {
+        // Returns immediately if the writer bumped `futex_seq` after it was loaded
+        futex_wait(&header->futex_seq, seq);
+    }
+    header->futex_waiters.fetch_sub(1, std::memory_order_relaxed);
 }
 
-bool ShmManager::read_shm_until(std::string_view target)
+void ShmManager::read_shm(char *dest, bool framed)
 {
-    std::string_view message = std::string_view(shm_ptr + read_offset, message_size);
-    // std::cout << "Read ptr: " << (void *)shm_read_ptr << std::endl;
-    if (message == target)
+    unsigned int spins = 0;
+    while (!try_read_shm(dest, framed))
     {
-        read_offset += message_size;
-        // More performant equivalent to `read_offset %= shm_size`
-        read_offset &= (shm_size - 1);
-        return true;
+        switch (wait_strategy)
+        {
+        case WaitStrategy::SPIN:
+            break;
+        case WaitStrategy::PAUSE:
+            cpu_relax();
+            break;
+        case WaitStrategy::YIELD:
+            sched_yield();
+            break;
+        case WaitStrategy::SPIN_FUTEX:
+            if (spins < SPIN_LIMIT)
+            {
+                ++spins;
+                cpu_relax();
+                break;
+            }
+            futex_wait_for_message();
+            break;
+        case WaitStrategy::FUTEX:
+            futex_wait_for_message();
+            break;
+        }
     }
-    return false;
 }
 
-std::string_view ShmManager::read_all_shm()
+WaitStrategy ShmManager::get_wait_strategy() const
 {
-    return std::string_view(shm_ptr, write_offset);
+    return wait_strategy;
 }
-
-size_t ShmManager::get_write_offset() const
-{
-    return write_offset;
-}
\ No newline at end of file
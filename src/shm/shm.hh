@@ -2,42 +2,152 @@
 
 #include "types.hh"
 #include "args.hh"
+#include "wait_strategy.hh"
+#include "segment.hh"
 
+#include <atomic>
 #include <string>
+#include <vector>
 
 // Cannot have additional slashes in the name
-constexpr std::string_view SHM_NAME_S2C = "/koi_shm_bench_s2c_v8";
-constexpr std::string_view SHM_NAME_C2S = "/koi_shm_bench_c2s_v8";
+constexpr std::string_view SHM_NAME_S2C = "/koi_shm_bench_s2c_v9";
+constexpr std::string_view SHM_NAME_C2S = "/koi_shm_bench_c2s_v9";
+
+// Name of fan-in client `client`'s segment in direction `shm_name`, every client has a ring
+// pair of its own so each ring keeps a single producer and a single consumer
+std::string fan_in_shm_name(std::string_view shm_name, ull client);
+
+// Throws `std::invalid_argument` unless the fan-in server can poll with the wait strategy
+void check_fan_in_wait_strategy(const Args &args);
 
 // shm holds at most `SHM_NUM_MSG` messages, 2^12 = 4096
+// Must be a power of two so a slot index can be derived with a mask
 constexpr unsigned int SHM_NUM_MSG = 1 << 12;
+static_assert((SHM_NUM_MSG & (SHM_NUM_MSG - 1)) == 0, "SHM_NUM_MSG must be a power of two");
+// A writer blocked on a full ring is woken once at most this many messages are unread, so it
+// refills half the ring per wake up instead of sleeping again after every slot
+constexpr unsigned int SHM_WAKE_WRITER = SHM_NUM_MSG / 2;
+
+// Control block placed at the start of the shared segment, followed by `SHM_NUM_MSG`
+// message slots. Indices are free running message counts, so `head - tail` is the
+// number of unread messages and the slot is `index & (SHM_NUM_MSG - 1)`.
+// A freshly truncated segment is zero filled, which is a valid empty ring.
+struct ShmRingHeader
+{
+    // Next message index to be written, only stored by the producer
+    alignas(CACHE_LINE_SIZE) std::atomic<ull> head;
+    // Next message index to be read, only stored by the consumer
+    alignas(CACHE_LINE_SIZE) std::atomic<ull> tail;
+    // Futex word bumped by the producer when a blocked consumer needs waking
+    alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> futex_seq;
+    // Number of consumers blocked (or about to block) on `futex_seq`
+    std::atomic<uint32_t> futex_waiters;
+    // Futex word bumped by the consumer when a producer blocked on a full ring needs waking
+    alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> space_seq;
+    // Number of producers blocked (or about to block) on `space_seq`
+    std::atomic<uint32_t> space_waiters;
+};
+static_assert(std::atomic<ull>::is_always_lock_free, "ring indices must be lock free to be shared across processes");
 
+// Single producer, single consumer ring buffer over POSIX shared memory.
+// One process should only write and the other should only read a given `ShmManager`.
 class ShmManager
 {
+    // Backing, prefaulting and locking are taken from `Args`
+    ShmSegment segment;
     char *shm_ptr;
-    off_t write_offset;
-    off_t read_offset;
+    ShmRingHeader *header;
+    char *slots;
+    // Producer's last observed `tail`, avoids reading the consumer's cache line on every write
+    ull cached_tail;
+    // Consumer's last observed `head`, avoids reading the producer's cache line on every read
+    ull cached_head;
     size_t shm_size;
     size_t message_size;
-    const std::string_view shm_name;
+    // Name of the wait strategy from `Args`, parsed by `create_shm` or `open_shm`
+    const std::string wait_strategy_arg;
+    WaitStrategy wait_strategy;
+
+    // Points the header and slots into the mapped segment
+    void map_layout();
+    // Blocks on the header futex until the ring may be non-empty
+    void futex_wait_for_message();
+    // Blocks on the header futex until the ring may have a free slot
+    void futex_wait_for_space();
+    // Wakes a writer blocked on the full ring once the reader drained it to `SHM_WAKE_WRITER`
+    // unread messages, `tail` being the reader's new index
+    void wake_writer(ull tail);
 
 public:
-    // Creates `ShmManager` and preallocates a `read_buffer` of size `message_size`.
+    // Creates `ShmManager`, the shared memory is not mapped until `create_shm` or `open_shm`
+    // is called.
     ShmManager(const Args &args, const std::string_view shm_name);
     ~ShmManager();
-    // This must be called before any other operation to initialize the shared memory.
-    void init_shm();
-    // Get size of the shm, in bytes
+    // One of these must be called before any other operation. The server creates the segment
+    // with an empty ring, replacing any left behind by an earlier run, and the client opens it
+    // once the server notified it.
+    void create_shm();
+    void open_shm();
+    // Get size of the mapped shm, in bytes, rounded up to whole (huge) pages
     size_t get_shm_size() const;
-    // This operation is unchecked. The message will be appended to the
-    // shared memory at the current position. Users should ensure that the
-    // shared memory has enough remaining space to hold the message.
+    // Copies `message` (of at most `message_size` bytes) into the next free slot and publishes
+    // it. Returns false without writing if the ring is full.
+    bool try_write_shm(const std::string_view message);
+    // Waits for a free slot using the configured wait strategy, then writes as `try_write_shm`
+    // and wakes the reader if the wait strategy may block.
     void write_shm(const std::string_view message);
-    // Reads a message of size `message_sz` from the shared memory of size `message_sz`, returns
-    // if the read message is equal to the `target`. If so, it advances the internal read pointer.
-    bool read_shm_until(std::string_view target);
-    // Reads range of all bytes written to shared memory and returns as a string view.
-    std::string_view read_all_shm();
-    // Returns the number of bytes written to the shared memory.
-    size_t get_write_offset() const;
-};
\ No newline at end of file
+    // Copies the oldest unread message into `dest` (at least `message_size` bytes) and frees
+    // its slot, waking a writer blocked on the full ring if the wait strategy may block.
+    // Returns false without reading if the ring is empty. If `framed`, the slot holds a frame
+    // (see `payload.hh`) and only its length is copied.
+    bool try_read_shm(char *dest, bool framed = false);
+    // Waits for a message using the configured wait strategy, then reads it as `try_read_shm`.
+    void read_shm(char *dest, bool framed = false);
+    WaitStrategy get_wait_strategy() const;
+};
+
+// Both rings of one side as a `Transport`, messages are written to `send_ring` and read from
+// `recv_ring`. Slots are fixed size, so every message and ack occupies a full slot. A frame
+// of a variable size workload keeps the slot stride, but only its own bytes are copied in
+// and out.
+class ShmTransport
+{
+    ShmManager *send_ring;
+    ShmManager *recv_ring;
+    size_t message_size;
+    // The received message is copied out of its slot, which frees the slot for the writer
+    std::vector<char> buffer;
+
+public:
+    ShmTransport(ShmManager &send_ring, ShmManager &recv_ring, size_t message_size)
+        : send_ring(&send_ring), recv_ring(&recv_ring), message_size(message_size), buffer(message_size)
+    {
+    }
+
+    void send(const char *message, size_t)
+    {
+        send_ring->write_shm(std::string_view(message, message_size));
+    }
+
+    const char *recv(size_t)
+    {
+        recv_ring->read_shm(buffer.data());
+        return buffer.data();
+    }
+
+    const char *try_recv(size_t)
+    {
+        return recv_ring->try_read_shm(buffer.data()) ? buffer.data() : nullptr;
+    }
+
+    void send_framed(const char *message, size_t size)
+    {
+        send_ring->write_shm(std::string_view(message, size));
+    }
+
+    const char *recv_framed(size_t)
+    {
+        recv_ring->read_shm(buffer.data(), true);
+        return buffer.data();
+    }
+};
@@ -0,0 +1,109 @@
+#include "wait_strategy.hh"
+
+#include <stdexcept>
+#include <climits>
+#include <sched.h>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+WaitStrategy parse_wait_strategy(const std::string &name)
+{
+    WaitStrategy strategy;
+    if (name == "spin")
+    {
+        strategy = WaitStrategy::SPIN;
+    }
+    else if (name == "pause")
+    {
+        strategy = WaitStrategy::PAUSE;
+    }
+    else if (name == "yield")
+    {
+        strategy = WaitStrategy::YIELD;
+    }
+    else if (name == "spin_futex")
+    {
+        strategy = WaitStrategy::SPIN_FUTEX;
+    }
+    else if (name == "futex")
+    {
+        strategy = WaitStrategy::FUTEX;
+    }
+    else
+    {
+        throw std::invalid_argument("Unknown wait strategy: " + name +
+                                    " (expected spin, pause, yield, spin_futex, or futex)");
+    }
+
+#ifndef __linux__
+    if (wait_strategy_blocks(strategy))
+    {
+        throw std::runtime_error("futex wait strategies are only supported on Linux");
+    }
+#endif
+    return strategy;
+}
+
+const char *wait_strategy_name(WaitStrategy strategy)
+{
+    switch (strategy)
+    {
+    case WaitStrategy::SPIN:
+        return "spin";
+    case WaitStrategy::PAUSE:
+        return "pause";
+    case WaitStrategy::YIELD:
+        return "yield";
+    case WaitStrategy::SPIN_FUTEX:
+        return "spin_futex";
+    case WaitStrategy::FUTEX:
+        return "futex";
+    }
+    return "unknown";
+}
+
+bool wait_strategy_blocks(WaitStrategy strategy)
+{
+    return strategy == WaitStrategy::SPIN_FUTEX || strategy == WaitStrategy::FUTEX;
+}
+
+void poll_wait(WaitStrategy strategy)
+{
+    switch (strategy)
+    {
+    case WaitStrategy::SPIN:
+        break;
+    case WaitStrategy::PAUSE:
+        cpu_relax();
+        break;
+    case WaitStrategy::YIELD:
+        sched_yield();
+        break;
+    case WaitStrategy::SPIN_FUTEX:
+    case WaitStrategy::FUTEX:
+        // A futex waits on one ring's word, a message may arrive on any of the others
+        throw std::invalid_argument("futex wait strategies cannot poll several rings, use spin, pause or yield");
+    }
+}
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex word must be a plain 32 bit integer");
+
+// The segment is `MAP_SHARED` between processes, so the non-private futex ops are used
+void futex_wait([[maybe_unused]] std::atomic<uint32_t> *word, [[maybe_unused]] uint32_t expected)
+{
+#ifdef __linux__
+    // `EAGAIN` (value changed) and `EINTR` are both treated as a spurious wake up by the caller
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(word), FUTEX_WAIT, expected, nullptr, nullptr, 0);
+#endif
+}
+
+void futex_wake([[maybe_unused]] std::atomic<uint32_t> *word)
+{
+#ifdef __linux__
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+#endif
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "types.hh"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// How a shm reader waits for the writer to publish a message
+enum class WaitStrategy
+{
+    // Busy loop with an empty body
+    SPIN,
+    // Busy loop with a CPU relax hint (`_mm_pause` on x86) each iteration
+    PAUSE,
+    // `sched_yield` each iteration
+    YIELD,
+    // Spin with a relax hint for `SPIN_LIMIT` iterations, then block on a futex
+    SPIN_FUTEX,
+    // Block on a futex immediately
+    FUTEX,
+};
+
+// Number of relaxed spins `SPIN_FUTEX` performs before blocking
+constexpr unsigned int SPIN_LIMIT = 1 << 10;
+
+// Parses a wait strategy name (`spin`, `pause`, `yield`, `spin_futex`, `futex`).
+// Throws `std::invalid_argument` for unknown names and `std::runtime_error` for
+// futex strategies on platforms without futexes.
+WaitStrategy parse_wait_strategy(const std::string &name);
+
+const char *wait_strategy_name(WaitStrategy strategy);
+
+// Returns true if the strategy may block, in which case writers must wake readers
+bool wait_strategy_blocks(WaitStrategy strategy);
+
+// Hint to the CPU that the caller is in a spin wait loop
+inline void cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+// One idle step of a reader polling several rings, which only the non-blocking strategies
+// can do. Throws `std::invalid_argument` for the futex strategies.
+void poll_wait(WaitStrategy strategy);
+
+// Blocks while `*word == expected`, may return spuriously. `word` may live in shared memory.
+void futex_wait(std::atomic<uint32_t> *word, uint32_t expected);
+
+// Wakes all waiters blocked on `word`
+void futex_wake(std::atomic<uint32_t> *word);
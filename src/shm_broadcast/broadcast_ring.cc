@@ -0,0 +1,211 @@
+#include "broadcast_ring.hh"
+#include "timing.hh"
+#include "pipeline.hh"
+#include "workload.hh"
+
+#include <sched.h>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+static_assert(std::atomic<ull>::is_always_lock_free, "slot sequences must be lock free to be shared across processes");
+static_assert(std::is_trivially_copyable_v<LatencyHistogram>, "reader histograms are copied through the segment as bytes");
+
+// Each slot is its sequence word followed by the message
+constexpr size_t BROADCAST_SEQ_SIZE = sizeof(std::atomic<ull>);
+
+std::string broadcast_name(const Args &args)
+{
+    // No comma, the name is a field of the results CSV
+    return "shm_broadcast (" + args.wait_strategy + " readers=" + std::to_string(args.fan_in) +
+           shm_segment_label(args) + ")";
+}
+
+void check_broadcast_args(const Args &args)
+{
+    if (args.message_size < sizeof(BroadcastStamp))
+    {
+        std::cerr << "Broadcast messages must be at least " << sizeof(BroadcastStamp) << " bytes" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    if (is_streaming(args))
+    {
+        std::cerr << "Broadcast readers never acknowledge, -p and -g are not supported" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    if (is_variable_size(args))
+    {
+        std::cerr << "Broadcast slots are read in place at a fixed size, -W is not supported" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
+BroadcastRing::BroadcastRing(const Args &args, std::string_view shm_name)
+    : segment(shm_name, shm_segment_options(args)), shm_ptr(nullptr), header(nullptr), slots(nullptr),
+      stats(nullptr), shm_size(0),
+      message_size(args.message_size),
+      slot_stride((BROADCAST_SEQ_SIZE + args.message_size + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE),
+      readers(args.fan_in), wait_strategy_arg(args.wait_strategy),
+      wait_strategy(WaitStrategy::SPIN), created(false)
+{
+    shm_size = sizeof(BroadcastHeader) + slot_stride * BROADCAST_NUM_SLOTS + sizeof(BroadcastReaderStats) * readers;
+}
+
+// Does not throw exceptions, as `~ShmManager`. `segment` unmaps itself.
+BroadcastRing::~BroadcastRing()
+{
+    if (created)
+    {
+        segment.unlink();
+    }
+}
+
+void BroadcastRing::map_layout()
+{
+    shm_ptr = segment.data();
+    // The segment is page aligned and every part is a whole number of cache lines
+    header = reinterpret_cast<BroadcastHeader *>(shm_ptr);
+    slots = shm_ptr + sizeof(BroadcastHeader);
+    stats = reinterpret_cast<BroadcastReaderStats *>(slots + slot_stride * BROADCAST_NUM_SLOTS);
+}
+
+void BroadcastRing::create()
+{
+    wait_strategy = parse_wait_strategy(wait_strategy_arg);
+    // A stale segment would hold the sequences of an earlier run
+    segment.unlink();
+    created = true;
+    segment.map(shm_size, true);
+    map_layout();
+}
+
+void BroadcastRing::open()
+{
+    wait_strategy = parse_wait_strategy(wait_strategy_arg);
+    // Fails if the readers disagree with the writer on the message size or the number of readers
+    segment.map(shm_size, false);
+    map_layout();
+}
+
+std::atomic<ull> *BroadcastRing::slot_seq(ull index) const
+{
+    return reinterpret_cast<std::atomic<ull> *>(slots + (index & (BROADCAST_NUM_SLOTS - 1)) * slot_stride);
+}
+
+void BroadcastRing::publish(char *message)
+{
+    BroadcastStamp stamp = {get_time_ns()};
+    memcpy(message, &stamp, sizeof(stamp));
+
+    // Only the writer stores `head`, so a relaxed load of its own index is sufficient
+    ull index = header->head.load(std::memory_order_relaxed);
+    std::atomic<ull> *seq = slot_seq(index);
+    seq->store(2 * index + 1, std::memory_order_relaxed);
+    // Orders the odd sequence before the message stores, so a reader which copied any of the
+    // new bytes sees a changed sequence when it checks again
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(reinterpret_cast<char *>(seq) + BROADCAST_SEQ_SIZE, message, message_size);
+    // Release publishes the message before the even sequence and the new `head`
+    seq->store(2 * (index + 1), std::memory_order_release);
+    header->head.store(index + 1, std::memory_order_release);
+
+    if (wait_strategy_blocks(wait_strategy))
+    {
+        // Pairs with the fence in `futex_wait_for_message`, as in `ShmManager::write_shm`
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (header->futex_waiters.load(std::memory_order_relaxed) != 0)
+        {
+            header->futex_seq.fetch_add(1, std::memory_order_release);
+            futex_wake(&header->futex_seq);
+        }
+    }
+}
+
+void BroadcastRing::futex_wait_for_message(ull index)
+{
+    header->futex_waiters.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    uint32_t seq = header->futex_seq.load(std::memory_order_acquire);
+    // Recheck after registering as a waiter, the writer may have published before it saw us
+    if (header->head.load(std::memory_order_acquire) <= index)
+    {
+        futex_wait(&header->futex_seq, seq);
+    }
+    header->futex_waiters.fetch_sub(1, std::memory_order_relaxed);
+}
+
+ull BroadcastRing::read(ull &next, char *dest)
+{
+    ull lost = 0;
+    unsigned int spins = 0;
+    while (true)
+    {
+        std::atomic<ull> *seq = slot_seq(next);
+        ull published = 2 * (next + 1);
+        ull before = seq->load(std::memory_order_acquire);
+        if (before == published)
+        {
+            // The copy may race with the writer lapping the reader, the second load of the
+            // sequence detects that and the torn copy is discarded
+            memcpy(dest, reinterpret_cast<const char *>(seq) + BROADCAST_SEQ_SIZE, message_size);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (seq->load(std::memory_order_relaxed) == published)
+            {
+                ++next;
+                return lost;
+            }
+        }
+        else if (before < published)
+        {
+            // The slot still holds an older message, or is being written with this one
+            switch (wait_strategy)
+            {
+            case WaitStrategy::SPIN:
+            case WaitStrategy::PAUSE:
+            case WaitStrategy::YIELD:
+                poll_wait(wait_strategy);
+                break;
+            case WaitStrategy::SPIN_FUTEX:
+                if (spins < SPIN_LIMIT)
+                {
+                    ++spins;
+                    cpu_relax();
+                    break;
+                }
+                futex_wait_for_message(next);
+                break;
+            case WaitStrategy::FUTEX:
+                futex_wait_for_message(next);
+                break;
+            }
+            continue;
+        }
+        // The writer lapped the reader. The reader rejoins at the latest published message, as
+        // a subscriber which fell behind skips to the latest data, rather than at the oldest
+        // slot which the writer is about to overwrite again. A lap means the writer is at
+        // least a ring ahead, so `head - 1` is past `next`.
+        ull head = header->head.load(std::memory_order_acquire);
+        lost += head - 1 - next;
+        next = head - 1;
+    }
+}
+
+void BroadcastRing::start()
+{
+    header->start_ns.store(get_time_ns(), std::memory_order_release);
+}
+
+ull BroadcastRing::get_start_ns() const
+{
+    return header->start_ns.load(std::memory_order_acquire);
+}
+
+BroadcastReaderStats *BroadcastRing::reader_stats(ull reader) const
+{
+    return stats + reader;
+}
+
+WaitStrategy BroadcastRing::get_wait_strategy() const
+{
+    return wait_strategy;
+}
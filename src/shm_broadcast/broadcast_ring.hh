@@ -0,0 +1,124 @@
+#pragma once
+
+#include "types.hh"
+#include "args.hh"
+#include "histogram.hh"
+#include "shm.hh"
+#include "segment.hh"
+#include "wait_strategy.hh"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Cannot have additional slashes in the name
+constexpr std::string_view SHM_NAME_BROADCAST = "/koi_shm_bench_broadcast_v1";
+
+// The ring holds the latest `BROADCAST_NUM_SLOTS` messages, 2^12 = 4096.
+// Must be a power of two so a slot index can be derived with a mask
+constexpr unsigned int BROADCAST_NUM_SLOTS = 1 << 12;
+static_assert((BROADCAST_NUM_SLOTS & (BROADCAST_NUM_SLOTS - 1)) == 0, "BROADCAST_NUM_SLOTS must be a power of two");
+
+// Every message starts with the time it was published (`CLOCK_MONOTONIC` ns)
+struct BroadcastStamp
+{
+    uint64_t published_ns;
+};
+
+// Control block at the start of the segment. A freshly truncated segment is zero filled,
+// which is an empty ring.
+struct BroadcastHeader
+{
+    // Number of messages published, only stored by the writer
+    alignas(CACHE_LINE_SIZE) std::atomic<ull> head;
+    // Time the writer started publishing, the start of every reader's rate
+    std::atomic<ull> start_ns;
+    // Futex word bumped by the writer when blocked readers need waking
+    alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> futex_seq;
+    // Number of readers blocked (or about to block) on `futex_seq`
+    std::atomic<uint32_t> futex_waiters;
+};
+
+// What a reader leaves in the segment for the writer's report once it is done
+struct BroadcastReaderStats
+{
+    ull received;
+    // Messages overwritten before the reader got to them
+    ull lost;
+    // Number of times the reader was lapped by the writer
+    ull overruns;
+    ull latency_sum_ns;
+    // Receive time of the reader's last message
+    ull last_ns;
+    // The reader's `LatencyHistogram`, copied in as bytes as the segment is never constructed
+    unsigned char latencies[sizeof(LatencyHistogram)];
+    // Set once the fields above are final
+    alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> done;
+};
+
+// Report name, with the wait strategy and the number of readers
+std::string broadcast_name(const Args &args);
+
+// Exits unless a broadcast run of `args` is possible: the messages must have room for the
+// `BroadcastStamp`, and readers never acknowledge, so there is no window or bulk mode
+void check_broadcast_args(const Args &args);
+
+// One writer, many readers ring over POSIX shared memory. Each slot holds a sequence word
+// followed by the message. The writer never waits for readers: a slot's sequence is odd
+// while the slot is being written and `2 * (n + 1)` once message `n` is in it, as in a
+// seqlock. A reader of message `n` checks the sequence before and after copying the slot,
+// which tells it whether `n` is not published yet, was read intact or was overwritten by
+// the writer lapping the reader (an overrun). Readers follow at their own pace and never
+// write to the ring, so adding readers only adds cache misses to the writer.
+class BroadcastRing
+{
+    // Backing, prefaulting and locking are taken from `Args`
+    ShmSegment segment;
+    char *shm_ptr;
+    BroadcastHeader *header;
+    char *slots;
+    BroadcastReaderStats *stats;
+    size_t shm_size;
+    size_t message_size;
+    // Slots are padded to cache lines so neighbouring slots never share a line
+    size_t slot_stride;
+    ull readers;
+    const std::string wait_strategy_arg;
+    WaitStrategy wait_strategy;
+    bool created;
+
+    // Locates the header, slots and reader stats in the mapped segment
+    void map_layout();
+    // Sequence word of the slot message `index` goes to
+    std::atomic<ull> *slot_seq(ull index) const;
+    // Blocks on the header futex while message `index` is not published
+    void futex_wait_for_message(ull index);
+
+public:
+    // Sized for `args.fan_in` readers, the shared memory is not mapped until `create` or `open`
+    BroadcastRing(const Args &args, std::string_view shm_name);
+    ~BroadcastRing();
+
+    BroadcastRing(const BroadcastRing &) = delete;
+    BroadcastRing &operator=(const BroadcastRing &) = delete;
+
+    // Creates (replacing any stale segment) and maps the ring, writer side
+    void create();
+    // Maps the ring created by the writer, reader side
+    void open();
+
+    // Stamps `message` (of `message_size` bytes) with the current time and publishes it
+    // into the next slot, overwriting the oldest message
+    void publish(char *message);
+    // Copies message `next` into `dest`, waiting with the wait strategy until it is published.
+    // If the writer lapped the reader, the latest published message is read instead. Advances
+    // `next` past the message read and returns the number of messages skipped.
+    ull read(ull &next, char *dest);
+
+    // Marks the start of publishing, before the first message
+    void start();
+    ull get_start_ns() const;
+    BroadcastReaderStats *reader_stats(ull reader) const;
+    WaitStrategy get_wait_strategy() const;
+};
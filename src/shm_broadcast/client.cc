@@ -0,0 +1,81 @@
+#include "broadcast_ring.hh"
+#include "args.hh"
+#include "barrier.hh"
+#include "bench.hh"
+#include "perf_counters.hh"
+#include "timing.hh"
+
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+int main(int argc, char *argv[])
+{
+    std::cout << "Launching client" << std::endl;
+    try
+    {
+        Args args = parse_args(argc, argv);
+        check_broadcast_args(args);
+        ReadyBarrier barrier(ReadyBarrier::Role::CLIENT);
+        // Wait until the writer has created the segment
+        barrier.wait_until_notify();
+        BroadcastRing ring(args, SHM_NAME_BROADCAST);
+        ring.open();
+
+        std::vector<char> buffer(args.message_size);
+        LatencyHistogram latencies;
+        ull received = 0;
+        ull lost = 0;
+        ull overruns = 0;
+        ull latency_sum_ns = 0;
+        ull last_ns = 0;
+
+        PerfCounters perf_counters(args.perf_counters);
+
+        // Indicate to the writer this reader is ready
+        barrier.notify();
+        ResourceUsage usage_start = get_resource_usage();
+        perf_counters.start();
+        ull next = 0;
+        while (next < args.iterations)
+        {
+            ull skipped = ring.read(next, buffer.data());
+            last_ns = get_time_ns();
+            BroadcastStamp stamp;
+            memcpy(&stamp, buffer.data(), sizeof(stamp));
+            ull latency_ns = last_ns > stamp.published_ns ? last_ns - stamp.published_ns : 0;
+            latencies.record(latency_ns);
+            latency_sum_ns += latency_ns;
+            ++received;
+            if (skipped > 0)
+            {
+                lost += skipped;
+                ++overruns;
+            }
+        }
+
+        perf_counters.stop();
+        std::string prefix = "Reader " + std::to_string(args.client_id) + " ";
+        report_resource_usage(prefix, usage_start, get_resource_usage(), received, received);
+        perf_counters.report(prefix, received);
+
+        // The writer reports every reader, once this one's numbers are final
+        BroadcastReaderStats *stats = ring.reader_stats(args.client_id);
+        stats->received = received;
+        stats->lost = lost;
+        stats->overruns = overruns;
+        stats->latency_sum_ns = latency_sum_ns;
+        stats->last_ns = last_ns;
+        memcpy(stats->latencies, static_cast<const void *>(&latencies), sizeof(latencies));
+        stats->done.store(1, std::memory_order_release);
+    }
+    catch (const std::exception &e)
+    {
+        // Catch exceptions to allow for graceful exit and stack unwinding to
+        // run destructors.
+        std::cerr << "Exception: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,116 @@
+#include "broadcast_ring.hh"
+#include "args.hh"
+#include "barrier.hh"
+#include "bench.hh"
+#include "results.hh"
+
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sched.h>
+#include <vector>
+
+// Waits for every reader to finish, then prints each reader's delivery and latency and
+// appends a row per reader and one for all of them to the results file
+void report_readers(const BroadcastRing &ring, const Args &args, const std::string &name)
+{
+    ull start_ns = ring.get_start_ns();
+    std::vector<BenchResult> rows;
+    std::vector<const BroadcastReaderStats *> reader_stats;
+    LatencyHistogram all_latencies;
+    ull all_received = 0;
+    ull all_latency_sum_ns = 0;
+    ull end_ns = start_ns + 1;
+    for (ull reader = 0; reader < args.fan_in; reader++)
+    {
+        const BroadcastReaderStats *stats = ring.reader_stats(reader);
+        // Readers exit soon after the last message, a failed reader makes the launcher stop us
+        while (stats->done.load(std::memory_order_acquire) == 0)
+        {
+            sched_yield();
+        }
+        LatencyHistogram latencies;
+        memcpy(static_cast<void *>(&latencies), stats->latencies, sizeof(latencies));
+        ull duration_ns = std::max<ull>(stats->last_ns > start_ns ? stats->last_ns - start_ns : 0, 1);
+        rows.push_back(histogram_result(name + " reader " + std::to_string(reader), args.message_size,
+                                        stats->received, stats->latency_sum_ns, latencies, duration_ns));
+        reader_stats.push_back(stats);
+        all_latencies.merge(latencies);
+        all_received += stats->received;
+        all_latency_sum_ns += stats->latency_sum_ns;
+        end_ns = std::max(end_ns, stats->last_ns);
+    }
+    rows.push_back(histogram_result(name + " readers", args.message_size, all_received, all_latency_sum_ns,
+                                    all_latencies, end_ns - start_ns));
+
+    std::cout << "========================================" << std::endl;
+    std::cout << "Readers: " << args.fan_in << std::endl;
+    std::cout << "Messages delivered / sec (all readers): " << rows.back().messages_per_sec << std::endl;
+    std::cout << "One-way latency (ns), publish to reader copy:" << std::endl;
+    constexpr int width = 12;
+    std::cout << std::setw(width) << "reader" << std::setw(width) << "received" << std::setw(width) << "lost"
+              << std::setw(width) << "overruns" << std::setw(width) << "msgs/s" << std::setw(width) << "p50"
+              << std::setw(width) << "p99" << std::setw(width) << "p99.9" << std::setw(width) << "max" << std::endl;
+    for (ull i = 0; i < rows.size(); i++)
+    {
+        const BenchResult &row = rows[i];
+        bool is_reader = i < reader_stats.size();
+        std::cout << std::setw(width) << (is_reader ? std::to_string(i) : "all") << std::setw(width) << row.iterations
+                  << std::setw(width) << (is_reader ? std::to_string(reader_stats[i]->lost) : "")
+                  << std::setw(width) << (is_reader ? std::to_string(reader_stats[i]->overruns) : "")
+                  << std::setw(width) << row.messages_per_sec << std::setw(width) << row.p50_ns << std::setw(width)
+                  << row.p99_ns << std::setw(width) << row.p99_9_ns << std::setw(width) << row.max_ns << std::endl;
+    }
+
+    if (!args.results_path.empty())
+    {
+        for (const BenchResult &row : rows)
+        {
+            if (!append_result(args.results_path, row))
+            {
+                std::cerr << "Failed to write results to " << args.results_path << std::endl;
+                break;
+            }
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    try
+    {
+        Args args = parse_args(argc, argv);
+        check_broadcast_args(args);
+        std::cout << "Launching server" << std::endl;
+        ReadyBarrier barrier(ReadyBarrier::Role::SERVER);
+        BroadcastRing ring(args, SHM_NAME_BROADCAST);
+        ring.create();
+        std::vector<char> message(args.message_size, 'b');
+        std::string name = broadcast_name(args);
+
+        // The writer's report (the cost of a publish and its throughput) is written last, so
+        // it is the row the launcher's sweeps read back
+        Benchmarks benchmarks(name, args);
+        benchmarks.set_first_lap(BROADCAST_NUM_SLOTS);
+        // The segment exists, let every reader map it and wait until all have
+        barrier.notify(args.fan_in);
+        barrier.wait_until_notify(args.fan_in);
+        ring.start();
+        for (ull i = 0; i < args.iterations; i++)
+        {
+            benchmarks.start_iteration();
+            // Never waits for readers, a reader which falls a ring behind is overrun
+            ring.publish(message.data());
+            benchmarks.end_iteration(1);
+        }
+        report_readers(ring, args, name);
+        return 0;
+    }
+    catch (const std::exception &e)
+    {
+        // Catch exceptions to allow for graceful exit and stack unwinding to
+        // run destructors.
+        std::cerr << "Exception: " << e.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,98 @@
+#include "spsc_queue.hh"
+#include "payload.hh"
+
+#include <cstring>
+#include <stdexcept>
+
+SpscQueue::SpscQueue(size_t message_size)
+    : message_size(message_size), slots(message_size * SHM_NUM_MSG), head(0), tail(0), cached_tail(0),
+      cached_head(0)
+{
+}
+
+bool SpscQueue::try_push(const char *message, size_t size)
+{
+    // Only the producer stores `head`, so a relaxed load of its own index is sufficient
+    ull next = head.load(std::memory_order_relaxed);
+    if (next - cached_tail == SHM_NUM_MSG)
+    {
+        // Acquire pairs with the consumer's release so its reads of the slot are complete
+        cached_tail = tail.load(std::memory_order_acquire);
+        if (next - cached_tail == SHM_NUM_MSG)
+        {
+            return false;
+        }
+    }
+    memcpy(slots.data() + (next & (SHM_NUM_MSG - 1)) * message_size, message, size);
+    // Release publishes the slot contents before the new index
+    head.store(next + 1, std::memory_order_release);
+    return true;
+}
+
+bool SpscQueue::try_pop(char *dest, bool framed)
+{
+    ull next = tail.load(std::memory_order_relaxed);
+    if (next == cached_head)
+    {
+        cached_head = head.load(std::memory_order_acquire);
+        if (next == cached_head)
+        {
+            return false;
+        }
+    }
+    const char *slot = slots.data() + (next & (SHM_NUM_MSG - 1)) * message_size;
+    memcpy(dest, slot, framed ? frame_length(slot, message_size) : message_size);
+    tail.store(next + 1, std::memory_order_release);
+    return true;
+}
+
+SpscTransport::SpscTransport(SpscQueue &send_queue, SpscQueue &recv_queue, size_t message_size,
+                             WaitStrategy strategy)
+    : send_queue(send_queue), recv_queue(recv_queue), strategy(strategy), buffer(message_size)
+{
+    // A plain `std::atomic` ring has no futex word to block on
+    if (wait_strategy_blocks(strategy))
+    {
+        throw std::invalid_argument("The spsc queue only supports the spin, pause and yield wait strategies");
+    }
+}
+
+void SpscTransport::send(const char *message, size_t)
+{
+    // Slots are fixed size, so an ack occupies a full slot as in `ShmTransport`
+    while (!send_queue.try_push(message, buffer.size()))
+    {
+        poll_wait(strategy);
+    }
+}
+
+const char *SpscTransport::recv(size_t)
+{
+    while (!recv_queue.try_pop(buffer.data()))
+    {
+        poll_wait(strategy);
+    }
+    return buffer.data();
+}
+
+const char *SpscTransport::try_recv(size_t)
+{
+    return recv_queue.try_pop(buffer.data()) ? buffer.data() : nullptr;
+}
+
+void SpscTransport::send_framed(const char *message, size_t size)
+{
+    while (!send_queue.try_push(message, size))
+    {
+        poll_wait(strategy);
+    }
+}
+
+const char *SpscTransport::recv_framed(size_t)
+{
+    while (!recv_queue.try_pop(buffer.data(), true))
+    {
+        poll_wait(strategy);
+    }
+    return buffer.data();
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "types.hh"
+#include "shm.hh"
+#include "wait_strategy.hh"
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Single producer, single consumer ring of `SHM_NUM_MSG` fixed size slots in the memory of one
+// process, the baseline of the threads benchmark. It is the ring of `ShmManager` with nothing
+// but `std::atomic` indices: no shared segment, no futex and no second mapping, so comparing the
+// two separates what the ring costs from what sharing it between address spaces costs.
+class SpscQueue
+{
+    // Read by both sides on every operation and never written after construction, so on a
+    // line of their own which stays shared in both caches
+    alignas(CACHE_LINE_SIZE) size_t message_size;
+    std::vector<char> slots;
+    // Next message index to be written, only stored by the producer
+    alignas(CACHE_LINE_SIZE) std::atomic<ull> head;
+    // Next message index to be read, only stored by the consumer
+    alignas(CACHE_LINE_SIZE) std::atomic<ull> tail;
+    // Producer's last observed `tail`, on the producer's own line
+    alignas(CACHE_LINE_SIZE) ull cached_tail;
+    // Consumer's last observed `head`, on the consumer's own line
+    alignas(CACHE_LINE_SIZE) ull cached_head;
+
+public:
+    explicit SpscQueue(size_t message_size);
+
+    SpscQueue(const SpscQueue &) = delete;
+    SpscQueue &operator=(const SpscQueue &) = delete;
+
+    // Copies the `size` bytes (at most `message_size`) of `message` into the next free slot and
+    // publishes it. Returns false without writing if the ring is full.
+    bool try_push(const char *message, size_t size);
+    // Copies the oldest unread message into `dest` and frees its slot. Returns false without
+    // reading if the ring is empty. If `framed`, only the length of the frame in the slot is
+    // copied, as `ShmManager::try_read_shm`.
+    bool try_pop(char *dest, bool framed = false);
+};
+
+// One thread's pair of queues as a `Transport`, waiting on a full or empty queue with the
+// `-w` strategy. Only the strategies which never block are supported, as `poll_wait`.
+class SpscTransport
+{
+    SpscQueue &send_queue;
+    SpscQueue &recv_queue;
+    WaitStrategy strategy;
+    std::vector<char> buffer;
+
+public:
+    SpscTransport(SpscQueue &send_queue, SpscQueue &recv_queue, size_t message_size, WaitStrategy strategy);
+
+    void send(const char *message, size_t size);
+    const char *recv(size_t size);
+    const char *try_recv(size_t size);
+    void send_framed(const char *message, size_t size);
+    const char *recv_framed(size_t max_size);
+};
@@ -0,0 +1,229 @@
+/*
+ * This benchmark runs the server and client as two threads of one process, over the same
+ * primitives as the process benchmarks or over a plain `std::atomic` queue. Compared with the
+ * process benchmark of the same primitive it shows which costs come from separate address
+ * spaces (page tables, TLB, scheduling two processes) and which are inherent to the primitive.
+ */
+
+#include "args.hh"
+#include "affinity.hh"
+#include "bench.hh"
+#include "driver.hh"
+#include "io_engine.hh"
+#include "pipeline.hh"
+#include "utils.hh"
+#include "transport.hh"
+#include "fan_in.hh"
+#include "spsc_queue.hh"
+#include "shm.hh"
+#include "pipe_mode.hh"
+#include "unix_socket.hh"
+#include "message.hh"
+#include "mq.hh"
+
+#include <climits>
+#include <iostream>
+#include <latch>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// Runs the server loop on the calling thread and the client loop on a second thread, each
+// pinned to its `-S`/`-C` CPU unless -1 (`sched_setaffinity` of pid 0 pins only the calling
+// thread). Both endpoints are set up beforehand, the timed loop starts once both threads are
+// pinned.
+template <Transport S, Transport C>
+void run_threads(const std::string &name, const Args &args, S &server, C &client)
+{
+    Benchmarks benchmarks(pipelined_name("threads " + name, args), args);
+    std::latch pinned(2);
+    std::thread client_thread(
+        [&]
+        {
+            if (args.client_cpu != -1)
+            {
+                pin_to_cpu(args.client_cpu);
+            }
+            pinned.arrive_and_wait();
+            run_client(args, client);
+        });
+    if (args.server_cpu != -1)
+    {
+        pin_to_cpu(args.server_cpu);
+    }
+    pinned.arrive_and_wait();
+    run_server(benchmarks, args, server);
+    client_thread.join();
+}
+
+// Exits unless the message fits in a slot of the fixed size rings
+static void check_ring_message_size(const Args &args)
+{
+    if (args.message_size > MAX_MESSAGE_SIZE)
+    {
+        std::cerr << "Ring messages must be at most " << MAX_MESSAGE_SIZE << " bytes" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
+static void run_spsc(const Args &args)
+{
+    check_ring_message_size(args);
+    WaitStrategy strategy = parse_wait_strategy(args.wait_strategy);
+    SpscQueue queue_s2c(args.message_size);
+    SpscQueue queue_c2s(args.message_size);
+    SpscTransport server(queue_s2c, queue_c2s, args.message_size, strategy);
+    SpscTransport client(queue_c2s, queue_s2c, args.message_size, strategy);
+    run_threads(std::string("spsc (") + wait_strategy_name(strategy) + ")", args, server, client);
+}
+
+// Each thread maps both segments itself, as the two processes would
+static void run_shm(const Args &args)
+{
+    check_ring_message_size(args);
+    ShmManager server_s2c(args, SHM_NAME_S2C);
+    server_s2c.create_shm();
+    ShmManager server_c2s(args, SHM_NAME_C2S);
+    server_c2s.create_shm();
+    ShmManager client_s2c(args, SHM_NAME_S2C);
+    client_s2c.open_shm();
+    ShmManager client_c2s(args, SHM_NAME_C2S);
+    client_c2s.open_shm();
+    ShmTransport server(server_s2c, server_c2s, args.message_size);
+    ShmTransport client(client_c2s, client_s2c, args.message_size);
+    std::string name =
+        std::string("shm (") + wait_strategy_name(server_c2s.get_wait_strategy()) + shm_segment_label(args) + ")";
+    run_threads(name, args, server, client);
+}
+
+static void run_pipe(const Args &args)
+{
+    PipeMode mode = parse_pipe_mode(args.pipe_mode);
+    if (mode != PipeMode::COPY && args.io_engine != "syscall")
+    {
+        std::cerr << "The io_uring engines only support the copy pipe mode" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    if (mode == PipeMode::PACKET && args.message_size > PIPE_BUF)
+    {
+        std::cerr << "Packet mode messages must be at most PIPE_BUF (" << PIPE_BUF << ") bytes" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    int pipefd_s2c[2];
+    create_pipe(pipefd_s2c, mode, args.kernel_buffer_size);
+    int pipefd_c2s[2];
+    create_pipe(pipefd_c2s, mode, args.kernel_buffer_size);
+    {
+        // A ring belongs to the one thread which submits to it
+        IoEngine server_engine(args);
+        IoEngine client_engine(args);
+        // Gifted pages must not be rewritten until the client consumed them, as in `pipe.cc`
+        size_t num_buffers = mode == PipeMode::VMSPLICE ? args.window : 1;
+        PipeTransport server(server_engine, mode, pipefd_s2c[1], pipefd_c2s[0], args.message_size, num_buffers);
+        PipeTransport client(client_engine, mode, pipefd_c2s[1], pipefd_s2c[0], args.message_size, 1);
+        run_threads(io_engine_name(pipe_name(args), args), args, server, client);
+    }
+    for (int fd : {pipefd_s2c[0], pipefd_s2c[1], pipefd_c2s[0], pipefd_c2s[1]})
+    {
+        close(fd);
+    }
+}
+
+// A connected pair from `socketpair`, there is no address to bind or accept on
+static void run_unix_socket(const Args &args)
+{
+    int socket_type = socket_type_from_name(args.socket_type);
+    if (socket_type != SOCK_STREAM && args.io_engine != "syscall")
+    {
+        std::cerr << "The io_uring engines only support stream sockets" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    int fds[2];
+    if (socketpair(AF_UNIX, socket_type, 0, fds) == -1)
+    {
+        report_and_exit("socketpair");
+    }
+    configure_socket_buffers(fds[0], args.kernel_buffer_size);
+    configure_socket_buffers(fds[1], args.kernel_buffer_size);
+    std::string name = io_engine_name(unix_socket_name(args), args);
+    if (socket_type == SOCK_STREAM)
+    {
+        std::vector<char> server_buffer(args.message_size);
+        std::vector<char> client_buffer(args.message_size);
+        IoEngine server_engine(args);
+        server_engine.register_files({fds[0]});
+        server_engine.register_buffers({{server_buffer.data(), server_buffer.size()}});
+        IoEngine client_engine(args);
+        client_engine.register_files({fds[1]});
+        client_engine.register_buffers({{client_buffer.data(), client_buffer.size()}});
+        StreamTransport server(server_engine, fds[0], fds[0], server_buffer.data(), server_buffer.data());
+        StreamTransport client(client_engine, fds[1], fds[1], client_buffer.data(), client_buffer.data());
+        run_threads(name, args, server, client);
+    }
+    else
+    {
+        SocketTransport server(fds[0], args.message_size, args.window);
+        SocketTransport client(fds[1], args.message_size, ack_batch_size(args.window));
+        run_threads(name, args, server, client);
+    }
+    close(fds[0]);
+    close(fds[1]);
+}
+
+static void run_message_queue(const Args &args)
+{
+    if (args.message_size > MAX_MSG_SIZE)
+    {
+        std::cerr << "Message queue messages must be at most " << MAX_MSG_SIZE << " bytes" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    int msq_id_server_client = create_mq(MSG_FILE_SERVER_CLIENT);
+    int msq_id_client_server = create_mq(MSG_FILE_CLIENT_SERVER);
+    MsgQueueTransport server(msq_id_server_client, msq_id_client_server, SERVER_TYPE, 0, args.message_size);
+    MsgQueueTransport client(msq_id_client_server, msq_id_server_client, CLIENT_TYPE, 0, args.message_size);
+    run_threads("message_queue", args, server, client);
+}
+
+int main(int argc, char *argv[])
+{
+    // Each primitive enforces its own cap below
+    Args args = parse_args(argc, argv, MAX_LARGE_MESSAGE_SIZE);
+    if (is_fan_in(args))
+    {
+        std::cerr << "The threads benchmark runs a single closed-loop client, fan-in and open-loop mode need the "
+                  << "process benchmarks" << std::endl;
+        return 1;
+    }
+    try
+    {
+        if (args.thread_transport == "spsc")
+        {
+            run_spsc(args);
+        }
+        else if (args.thread_transport == "shm")
+        {
+            run_shm(args);
+        }
+        else if (args.thread_transport == "pipe")
+        {
+            run_pipe(args);
+        }
+        else if (args.thread_transport == "unix_socket")
+        {
+            run_unix_socket(args);
+        }
+        else
+        {
+            run_message_queue(args);
+        }
+    }
+    catch (const std::exception &e)
+    {
+        // Setting up the rings throws, as in the shm benchmark
+        std::cerr << "Exception: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -1,6 +1,11 @@
 #include "args.hh"
 #include "utils.hh"
-#include "signals.hh"
+#include "barrier.hh"
+#include "pipeline.hh"
+#include "unix_socket.hh"
+#include "io_engine.hh"
+#include "fan_in.hh"
+#include "driver.hh"
 
 #include <sys/socket.h>
 #include <sys/un.h>
@@ -8,55 +13,75 @@
 #include <vector>
 #include <unistd.h>
 
-constexpr const char *SOCKET_PATH = "/tmp/cpp_ipc_benchmarks";
-
 int main(int argc, char *argv[])
 {
     std::cout << "Launching client" << std::endl;
-    Args args = parse_args(argc, argv);
-    SignalManager signal_manager(SignalManager::SignalTarget::CLIENT);
+    Args args = parse_args(argc, argv, MAX_LARGE_MESSAGE_SIZE);
+    ReadyBarrier barrier(ReadyBarrier::Role::CLIENT);
+    int socket_type = socket_type_from_name(args.socket_type);
+    if (socket_type != SOCK_STREAM && args.io_engine != "syscall")
+    {
+        std::cerr << "The io_uring engines only support stream sockets" << std::endl;
+        return 1;
+    }
+    // Wait until the server is listening
+    barrier.wait_until_notify();
 
     int client_fd;
-    struct sockaddr_un addr;
 
     // Create the socket
-    if ((client_fd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1)
+    if ((client_fd = socket(AF_UNIX, socket_type, 0)) == -1)
     {
         report_and_exit("socket");
     }
 
-    // Clear and set up the address structure
-    memset(&addr, 0, sizeof(addr));
-    addr.sun_family = AF_UNIX;
-    strncpy(addr.sun_path, SOCKET_PATH, sizeof(addr.sun_path) - 1);
-
-    // Connect to the server
-    if (connect(client_fd, (struct sockaddr *)&addr, sizeof(addr)) == -1)
+    // Each fan-in datagram client binds its own address, which the server replies to
+    std::string client_path = CLIENT_SOCKET_PATH;
+    if (is_fan_in(args))
     {
-        close(client_fd);
-        report_and_exit("connect");
+        client_path += "_" + std::to_string(args.client_id);
     }
-
-    // Indicate to server client is ready
-    signal_manager.notify();
-    std::vector<char> buffer(args.message_size, 'a');
-    for (int i = 0; i < args.iterations; i++)
+    if (socket_type == SOCK_DGRAM)
     {
-        // Write the message to the server
-        int bytes_sent = write(client_fd, buffer.data(), buffer.size());
-        ASSERT(bytes_sent == buffer.size());
-
-        // Read the response from the server
-        int bytes_received = read(client_fd, buffer.data(), buffer.size());
-        ASSERT(bytes_received == buffer.size());
-
-        // Assert that the buffer is still all 'a's
-        for (int j = 0; j < buffer.size(); j++)
+        // Bind an address for the server to send to
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, client_path.c_str(), sizeof(addr.sun_path) - 1);
+        unlink(client_path.c_str());
+        if (bind(client_fd, (struct sockaddr *)&addr, sizeof(addr)) == -1)
         {
-            ASSERT(buffer[j] == 'a');
+            close(client_fd);
+            report_and_exit("bind");
         }
     }
 
+    // Connect to the server
+    connect_socket(client_fd, SOCKET_PATH);
+    configure_socket_buffers(client_fd, args.kernel_buffer_size);
+
+    std::vector<char> buffer(args.message_size);
+    if (socket_type == SOCK_STREAM)
+    {
+        IoEngine engine(args);
+        engine.register_files({client_fd});
+        engine.register_buffers({{buffer.data(), buffer.size()}});
+        StreamTransport transport(engine, client_fd, client_fd, buffer.data(), buffer.data());
+        // Indicate to server client is ready
+        barrier.notify();
+        run_client(args, transport);
+    }
+    else
+    {
+        SocketTransport transport(client_fd, args.message_size, ack_batch_size(args.window));
+        barrier.notify();
+        run_client(args, transport);
+    }
+
     close(client_fd);
+    if (socket_type == SOCK_DGRAM)
+    {
+        unlink(client_path.c_str());
+    }
     return 0;
 }
@@ -1,7 +1,12 @@
 #include "args.hh"
 #include "utils.hh"
-#include "signals.hh"
+#include "barrier.hh"
 #include "bench.hh"
+#include "pipeline.hh"
+#include "unix_socket.hh"
+#include "io_engine.hh"
+#include "fan_in.hh"
+#include "driver.hh"
 
 #include <sys/socket.h>
 #include <sys/un.h>
@@ -9,20 +14,90 @@
 #include <vector>
 #include <unistd.h>
 
-constexpr const char *SOCKET_PATH = "/tmp/cpp_ipc_benchmarks";
+// Fan-in server: every client has its own connection, or sends datagrams to the one bound
+// socket and is answered at the address it sent from
+static int serve_fan_in(const Args &args, ReadyBarrier &barrier, int socket_type)
+{
+    FanInServer server(fan_in_name(unix_socket_name(args), args), args);
+    int server_fd = socket(AF_UNIX, socket_type, 0);
+    if (server_fd == -1)
+    {
+        report_and_exit("socket");
+    }
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, SOCKET_PATH, sizeof(addr.sun_path) - 1);
+    unlink(SOCKET_PATH);
+    if (bind(server_fd, (struct sockaddr *)&addr, sizeof(addr)) == -1)
+    {
+        close(server_fd);
+        report_and_exit("bind");
+    }
+
+    if (socket_type == SOCK_DGRAM)
+    {
+        configure_socket_buffers(server_fd, args.kernel_buffer_size);
+        barrier.notify(args.fan_in);
+        barrier.wait_until_notify(args.fan_in);
+        DatagramFanIn transport(server_fd, args.message_size);
+        run_fan_in_server(server, args, transport);
+    }
+    else
+    {
+        if (listen(server_fd, static_cast<int>(args.fan_in)) == -1)
+        {
+            close(server_fd);
+            report_and_exit("listen");
+        }
+        barrier.notify(args.fan_in);
+        std::vector<int> client_fds;
+        for (ull i = 0; i < args.fan_in; i++)
+        {
+            int client_fd = accept(server_fd, NULL, NULL);
+            if (client_fd == -1)
+            {
+                report_and_exit("accept");
+            }
+            configure_socket_buffers(client_fd, args.kernel_buffer_size);
+            client_fds.push_back(client_fd);
+        }
+        barrier.wait_until_notify(args.fan_in);
+        SocketFanIn transport(client_fds, socket_type, args.message_size);
+        run_fan_in_server(server, args, transport);
+        for (int client_fd : client_fds)
+        {
+            close(client_fd);
+        }
+    }
+    close(server_fd);
+    unlink(SOCKET_PATH);
+    return 0;
+}
 
 int main(int argc, char *argv[])
 {
-    std::cout << "Launching client" << std::endl;
-    Args args = parse_args(argc, argv);
-    SignalManager signal_manager(SignalManager::SignalTarget::SERVER);
-    Benchmarks benchmarks(std::string("shm"), args.message_size);
+    std::cout << "Launching server" << std::endl;
+    // Messages are read and written with `read_full`/`write_full`, so they may exceed the socket buffer
+    Args args = parse_args(argc, argv, MAX_LARGE_MESSAGE_SIZE);
+    ReadyBarrier barrier(ReadyBarrier::Role::SERVER);
+    int socket_type = socket_type_from_name(args.socket_type);
+    if (socket_type != SOCK_STREAM && args.io_engine != "syscall")
+    {
+        std::cerr << "The io_uring engines only support stream sockets" << std::endl;
+        return 1;
+    }
+    if (is_fan_in(args))
+    {
+        return serve_fan_in(args, barrier, socket_type);
+    }
+    Benchmarks benchmarks(pipelined_name(io_engine_name(unix_socket_name(args), args), args), args);
 
     int server_fd, client_fd;
     struct sockaddr_un addr;
 
     // Create the socket
-    if ((server_fd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1)
+    if ((server_fd = socket(AF_UNIX, socket_type, 0)) == -1)
     {
         report_and_exit("socket");
     }
@@ -42,43 +117,65 @@ int main(int argc, char *argv[])
         report_and_exit("bind");
     }
 
-    // Listen for incoming connections
-    int max_connections = 1;
-    if (listen(server_fd, max_connections) == -1)
+    if (socket_type == SOCK_DGRAM)
     {
-        close(server_fd);
-        report_and_exit("listen");
+        // There is no connection to accept, the client binds its own address and the
+        // server connects to it once the client is ready
+        configure_socket_buffers(server_fd, args.kernel_buffer_size);
+        barrier.notify();
+        barrier.wait_until_notify();
+        connect_socket(server_fd, CLIENT_SOCKET_PATH);
+        client_fd = server_fd;
     }
-
-    std::cout << "Server listening on " << SOCKET_PATH << std::endl;
-
-    // Accept a connection
-    if ((client_fd = accept(server_fd, NULL, NULL)) == -1)
+    else
     {
-        close(server_fd);
-        report_and_exit("accept");
-    }
+        // Listen for incoming connections
+        int max_connections = 1;
+        if (listen(server_fd, max_connections) == -1)
+        {
+            close(server_fd);
+            report_and_exit("listen");
+        }
 
-    // Wait until client notifies that it is ready
-    signal_manager.wait_until_notify();
-    std::vector<char> buffer(args.message_size, 'a');
-    for (int i = 0; i < args.iterations; i++)
-    {
-        benchmarks.start_iteration();
-        int bytes_received = read(client_fd, buffer.data(), buffer.size());
-        ASSERT(bytes_received == buffer.size());
-        // Assert that buffer is all 'a's
-        for (int j = 0; j < buffer.size(); j++)
+        std::cout << "Server listening on " << SOCKET_PATH << std::endl;
+        // The socket is listening, the client can connect
+        barrier.notify();
+
+        // Accept a connection
+        if ((client_fd = accept(server_fd, NULL, NULL)) == -1)
         {
-            ASSERT(buffer[j] == 'a');
+            close(server_fd);
+            report_and_exit("accept");
         }
+        configure_socket_buffers(client_fd, args.kernel_buffer_size);
 
-        write(client_fd, buffer.data(), buffer.size());
-        benchmarks.end_iteration(1);
+        // Wait until client notifies that it is ready
+        barrier.wait_until_notify();
     }
 
-    close(client_fd);
+    std::vector<char> buffer(args.message_size);
+    if (socket_type == SOCK_STREAM)
+    {
+        // A single `read` returns at most what fits in the socket buffer, the engine loops
+        // until the full message arrived
+        IoEngine engine(args);
+        engine.register_files({client_fd});
+        engine.register_buffers({{buffer.data(), buffer.size()}});
+        StreamTransport transport(engine, client_fd, client_fd, buffer.data(), buffer.data());
+        run_server(benchmarks, args, transport);
+    }
+    else
+    {
+        // Each message is its own datagram or record, so a window is sent in `sendmmsg` batches
+        SocketTransport transport(client_fd, args.message_size, args.window);
+        run_server(benchmarks, args, transport);
+    }
+
+    if (client_fd != server_fd)
+    {
+        close(client_fd);
+    }
     close(server_fd);
     unlink(SOCKET_PATH); // Clean up the socket file
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,306 @@
+#include "unix_socket.hh"
+#include "payload.hh"
+#include "utils.hh"
+
+#include <sys/un.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <unistd.h>
+
+int socket_type_from_name(const std::string &name)
+{
+    if (name == "seqpacket")
+    {
+        return SOCK_SEQPACKET;
+    }
+    if (name == "dgram")
+    {
+        return SOCK_DGRAM;
+    }
+    return SOCK_STREAM;
+}
+
+std::string unix_socket_name(const Args &args)
+{
+    if (args.socket_type == "stream" && args.kernel_buffer_size == 0)
+    {
+        return "unix_socket";
+    }
+    std::string name = "unix_socket (" + args.socket_type;
+    if (args.kernel_buffer_size != 0)
+    {
+        // No comma, the name is a field of the results CSV
+        name += " buffers=" + std::to_string(args.kernel_buffer_size);
+    }
+    return name + ")";
+}
+
+void connect_socket(int fd, const char *path)
+{
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1)
+    {
+        close(fd);
+        report_and_exit("connect");
+    }
+}
+
+void configure_socket_buffers(int fd, size_t size)
+{
+    if (size != 0)
+    {
+        // Linux caps the request at `net.core.wmem_max`/`rmem_max` and doubles it for bookkeeping
+        int value = static_cast<int>(size);
+        if (setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &value, sizeof(value)) == -1)
+        {
+            report_and_exit("setsockopt SO_SNDBUF");
+        }
+        if (setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &value, sizeof(value)) == -1)
+        {
+            report_and_exit("setsockopt SO_RCVBUF");
+        }
+    }
+    int sndbuf, rcvbuf;
+    socklen_t len = sizeof(sndbuf);
+    getsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, &len);
+    len = sizeof(rcvbuf);
+    getsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, &len);
+    std::cout << "Socket buffers: SO_SNDBUF=" << sndbuf << ", SO_RCVBUF=" << rcvbuf << std::endl;
+}
+
+void send_message(int fd, const char *buf, size_t size)
+{
+    ssize_t bytes_sent;
+    do
+    {
+        bytes_sent = send(fd, buf, size, 0);
+    } while (bytes_sent == -1 && errno == EINTR);
+    if (bytes_sent == -1 && errno == EMSGSIZE)
+    {
+        std::cerr << "A " << size << " byte message does not fit in the socket buffer, raise it with -z" << std::endl;
+    }
+    if (bytes_sent != static_cast<ssize_t>(size))
+    {
+        report_and_exit("send");
+    }
+}
+
+size_t recv_record(int fd, char *buf, size_t max_size)
+{
+    struct iovec iov = {buf, max_size};
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    ssize_t bytes_received;
+    do
+    {
+        bytes_received = recvmsg(fd, &msg, 0);
+    } while (bytes_received == -1 && errno == EINTR);
+    if (bytes_received == -1)
+    {
+        report_and_exit("recvmsg");
+    }
+    if (msg.msg_flags & MSG_TRUNC)
+    {
+        std::cerr << "Received a message larger than " << max_size << " bytes" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    return static_cast<size_t>(bytes_received);
+}
+
+void recv_message(int fd, char *buf, size_t size)
+{
+    size_t bytes_received = recv_record(fd, buf, size);
+    if (bytes_received != size)
+    {
+        std::cerr << "Received a " << bytes_received << " byte message, expected " << size << std::endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
+SocketBatcher::SocketBatcher(int fd, size_t message_size, size_t max_batch)
+    : fd(fd), message_size(message_size), capacity(std::clamp<size_t>(max_batch, 1, MAX_SOCKET_BATCH)),
+      buffers(capacity * message_size), iovecs(capacity)
+#ifdef __linux__
+      ,
+      headers(capacity)
+#endif
+{
+}
+
+size_t SocketBatcher::send_batch(const char *message, size_t count)
+{
+    count = std::min(count, capacity);
+#ifdef __linux__
+    for (size_t i = 0; i < count; i++)
+    {
+        // Every message of the batch is the same payload
+        iovecs[i] = {const_cast<char *>(message), message_size};
+        memset(&headers[i], 0, sizeof(headers[i]));
+        headers[i].msg_hdr.msg_iov = &iovecs[i];
+        headers[i].msg_hdr.msg_iovlen = 1;
+    }
+    int sent;
+    do
+    {
+        sent = sendmmsg(fd, headers.data(), count, 0);
+    } while (sent == -1 && errno == EINTR);
+    if (sent == -1 && errno == EMSGSIZE)
+    {
+        std::cerr << "A " << message_size << " byte message does not fit in the socket buffer, raise it with -z"
+                  << std::endl;
+    }
+    if (sent <= 0)
+    {
+        report_and_exit("sendmmsg");
+    }
+    return sent;
+#else
+    (void)count;
+    send_message(fd, message, message_size);
+    return 1;
+#endif
+}
+
+size_t SocketBatcher::recv_batch(size_t max)
+{
+    max = std::min(max, capacity);
+#ifdef __linux__
+    for (size_t i = 0; i < max; i++)
+    {
+        iovecs[i] = {buffers.data() + i * message_size, message_size};
+        memset(&headers[i], 0, sizeof(headers[i]));
+        headers[i].msg_hdr.msg_iov = &iovecs[i];
+        headers[i].msg_hdr.msg_iovlen = 1;
+    }
+    int received;
+    do
+    {
+        // Blocks for the first message only, then takes whatever else is already queued
+        received = recvmmsg(fd, headers.data(), max, MSG_WAITFORONE, nullptr);
+    } while (received == -1 && errno == EINTR);
+    if (received <= 0)
+    {
+        report_and_exit("recvmmsg");
+    }
+    for (int i = 0; i < received; i++)
+    {
+        if (headers[i].msg_len != message_size || (headers[i].msg_hdr.msg_flags & MSG_TRUNC))
+        {
+            std::cerr << "Received a " << headers[i].msg_len << " byte message, expected " << message_size << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+    return received;
+#else
+    (void)max;
+    recv_message(fd, buffers.data(), message_size);
+    return 1;
+#endif
+}
+
+SocketTransport::SocketTransport(int fd, size_t message_size, size_t max_batch)
+    : fd(fd), buffer(message_size), batcher(fd, message_size, max_batch)
+{
+}
+
+void SocketTransport::send(const char *message, size_t size)
+{
+    send_message(fd, message, size);
+}
+
+const char *SocketTransport::recv(size_t size)
+{
+    // Message boundaries are preserved, one receive returns the whole message
+    recv_message(fd, buffer.data(), size);
+    return buffer.data();
+}
+
+const char *SocketTransport::recv_framed(size_t max_size)
+{
+    size_t received = recv_record(fd, buffer.data(), max_size);
+    check_whole_frame(buffer.data(), received, max_size);
+    return buffer.data();
+}
+
+size_t SocketTransport::send_batch(const char *message, size_t, size_t count)
+{
+    return batcher.send_batch(message, count);
+}
+
+size_t SocketTransport::recv_batch(size_t, size_t count)
+{
+    return batcher.recv_batch(count);
+}
+
+SocketFanIn::SocketFanIn(const std::vector<int> &client_fds, int socket_type, size_t message_size)
+    : client_fds(client_fds), socket_type(socket_type), poller(client_fds), buffer(message_size)
+{
+}
+
+const char *SocketFanIn::recv_any(size_t size, size_t &source)
+{
+    source = poller.next_ready();
+    // Records are whole, a stream is read until the full message arrived
+    if (socket_type == SOCK_STREAM)
+    {
+        read_full(client_fds[source], buffer.data(), size);
+    }
+    else
+    {
+        recv_message(client_fds[source], buffer.data(), size);
+    }
+    return buffer.data();
+}
+
+void SocketFanIn::reply(size_t source, const char *message, size_t size)
+{
+    write_full(client_fds[source], message, size);
+}
+
+void SocketFanIn::drop(size_t source)
+{
+    poller.remove(source);
+}
+
+DatagramFanIn::DatagramFanIn(int fd, size_t message_size) : fd(fd), buffer(message_size), from_len(0)
+{
+}
+
+const char *DatagramFanIn::recv_any(size_t size, size_t &source)
+{
+    while (true)
+    {
+        from_len = sizeof(from);
+        ssize_t received = recvfrom(fd, buffer.data(), size, 0, (struct sockaddr *)&from, &from_len);
+        if (received == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        if (received == -1)
+        {
+            report_and_exit("recvfrom");
+        }
+        if (static_cast<size_t>(received) != size)
+        {
+            std::cerr << "Received a " << received << " byte message, expected " << size << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        source = fan_in_sender(buffer.data());
+        return buffer.data();
+    }
+}
+
+void DatagramFanIn::reply(size_t, const char *message, size_t size)
+{
+    if (sendto(fd, message, size, 0, (struct sockaddr *)&from, from_len) == -1)
+    {
+        report_and_exit("sendto");
+    }
+}
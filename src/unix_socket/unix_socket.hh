@@ -0,0 +1,116 @@
+#pragma once
+
+#include "args.hh"
+#include "fan_in.hh"
+
+#include <string>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+constexpr const char *SOCKET_PATH = "/tmp/cpp_ipc_benchmarks";
+// Datagram sockets are not connected by `accept`, the client binds this address so the
+// server can connect back to it
+constexpr const char *CLIENT_SOCKET_PATH = "/tmp/cpp_ipc_benchmarks_client";
+
+// Most messages passed to one `sendmmsg`/`recvmmsg` call
+constexpr size_t MAX_SOCKET_BATCH = 64;
+
+// `SOCK_STREAM`, `SOCK_SEQPACKET` or `SOCK_DGRAM` for `Args::socket_type`
+int socket_type_from_name(const std::string &name);
+
+// Report name, the socket type and buffer size are appended when they are not the defaults
+std::string unix_socket_name(const Args &args);
+
+// Connects `fd` to the socket bound at `path`, exits on failure
+void connect_socket(int fd, const char *path);
+
+// Sets `SO_SNDBUF` and `SO_RCVBUF` of `fd` to `size` (unless 0) and prints the sizes in effect
+void configure_socket_buffers(int fd, size_t size);
+
+// Sends `size` bytes as one datagram or record, exits on error
+void send_message(int fd, const char *buf, size_t size);
+
+// Receives one datagram or record of at most `max_size` bytes into `buf` and returns its size,
+// exits if it was truncated
+size_t recv_record(int fd, char *buf, size_t max_size);
+
+// Receives one datagram or record into `buf`, exits unless it is exactly `size` bytes
+void recv_message(int fd, char *buf, size_t size);
+
+// Sends and receives batches of messages with one `sendmmsg`/`recvmmsg` call on
+// message preserving sockets (one message per call where those are unavailable).
+class SocketBatcher
+{
+    int fd;
+    size_t message_size;
+    size_t capacity;
+    // `capacity` receive buffers of `message_size` bytes
+    std::vector<char> buffers;
+    std::vector<struct iovec> iovecs;
+#ifdef __linux__
+    std::vector<struct mmsghdr> headers;
+#endif
+
+public:
+    // Batches are at most `max_batch` (capped at `MAX_SOCKET_BATCH`) messages
+    SocketBatcher(int fd, size_t message_size, size_t max_batch);
+
+    // Sends up to `count` copies of `message`, returns the number sent
+    size_t send_batch(const char *message, size_t count);
+
+    // Blocks for at least one message and receives up to `max`, returns the number received
+    size_t recv_batch(size_t max);
+};
+
+// Endpoint of a connected datagram or seqpacket socket, every message is one datagram or
+// record. Streams of them are sent and received in batches by a `SocketBatcher`.
+class SocketTransport
+{
+    int fd;
+    std::vector<char> buffer;
+    SocketBatcher batcher;
+
+public:
+    // Batches are at most `max_batch` messages
+    SocketTransport(int fd, size_t message_size, size_t max_batch);
+
+    void send(const char *message, size_t size);
+    const char *recv(size_t size);
+    const char *recv_framed(size_t max_size);
+    size_t send_batch(const char *message, size_t size, size_t count);
+    size_t recv_batch(size_t size, size_t count);
+};
+
+// Fan-in server over the connections of every client, a message is a record of a seqpacket
+// socket or read in full from a stream
+class SocketFanIn
+{
+    std::vector<int> client_fds;
+    int socket_type;
+    FdPoller poller;
+    std::vector<char> buffer;
+
+public:
+    SocketFanIn(const std::vector<int> &client_fds, int socket_type, size_t message_size);
+
+    const char *recv_any(size_t size, size_t &source);
+    void reply(size_t source, const char *message, size_t size);
+    void drop(size_t source);
+};
+
+// Fan-in server over the one bound datagram socket every client sends to. Replies go to the
+// address the last message came from, the only message the driver answers.
+class DatagramFanIn
+{
+    int fd;
+    std::vector<char> buffer;
+    struct sockaddr_storage from;
+    socklen_t from_len;
+
+public:
+    DatagramFanIn(int fd, size_t message_size);
+
+    const char *recv_any(size_t size, size_t &source);
+    void reply(size_t source, const char *message, size_t size);
+};